@@ -33,7 +33,8 @@ ChoiceList (DATA_FILE_PRINT_FORMAT,"Output Format",1,SKIP_NONE,
 			/* 9 */ "FASTA sequential","FASTA Sequential Format.",
 			/* 10 */ "FASTA interleaved","FASTA Interleaved Format.",
 			/* 11 */ "PAML compatible", "PAML Compatible PHYLIP-like format",
-			/* 12 */ "STOCKHOLM", "STOCKHOLM format");
+			/* 12 */ "STOCKHOLM", "STOCKHOLM format",
+			/* 13 */ "HyPhy binary", "Binary data set format, which HyPhy reads without parsing or compressing site patterns");
 			
 if (DATA_FILE_PRINT_FORMAT<0)
 {
@@ -0,0 +1,20 @@
+/* Convert a sequence file (FASTA, PHYLIP, NEXUS, etc) into the binary data set
+   format (DATA_FILE_PRINT_FORMAT = 13). ReadDataFile loads binary data set files
+   directly, without parsing sequences or compressing site patterns. */
+
+LoadFunctionLibrary ("libv3/IOFunctions.bf");
+
+KeywordArgument ("alignment", "The sequence file to convert");
+SetDialogPrompt ("Please choose a data file to convert:");
+DataSet convert_binary.data = ReadDataFile (PROMPT_FOR_FILE);
+convert_binary.source_path = LAST_FILE_PATH;
+DataSetFilter convert_binary.filter = CreateFilter (convert_binary.data, 1);
+
+KeywordArgument ("output", "Write the binary data set file to (default is to save to the same path as the alignment file + '.hbd')", convert_binary.source_path + ".hbd");
+convert_binary.output_path = io.PromptUserForFilePath ("Write the binary data set file to");
+
+DATA_FILE_PRINT_FORMAT = 13;
+fprintf (convert_binary.output_path, CLEAR_FILE, convert_binary.filter);
+
+fprintf (stdout, "\nWrote ", convert_binary.data.species, " sequences, ", convert_binary.data.sites, " sites (",
+                 convert_binary.data.unique_sites, " site patterns) to ", convert_binary.output_path, "\n");
@@ -403,6 +403,12 @@ namespace terms{
         Variables           = "Variables";
         Functions           = "Functions";
         DataSetFilters      = "DataSetFilters";
+        JobsPerNode         = "JobsPerNode";
+        JobTimeout          = "JobTimeout";
+        JobRetries          = "JobRetries";
+        SpeculativeJobs     = "SpeculativeJobs";
+        site_sums           = "site sums";
+        class_posteriors    = "class posteriors";
     }
 
 
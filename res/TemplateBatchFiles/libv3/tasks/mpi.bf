@@ -1,4 +1,5 @@
 LoadFunctionLibrary ("../all-terms.bf");
+LoadFunctionLibrary ("../UtilityFunctions.bf");
 LoadFunctionLibrary ("../models/parameters.bf");
 
 /** @module mpi
@@ -11,6 +12,45 @@ LoadFunctionLibrary ("../models/parameters.bf");
 
 namespace mpi {
     job_id = 0;
+    // nodes which timed out on a job (see mpi.QueueComplete); they are not sent any more jobs
+    // until they are put back by mpi.ReinstateNodes
+    retired_nodes = {};
+    // the smallest block of site conditionals (classes x sites) mpi.DistributeSiteBlocks stores on a node;
+    // a reduction takes ~10 ns per element, and a round trip to a node ~100 us, so
+    // smaller blocks are reduced faster on the master
+    site_block_min_size = 1e6;
+
+    lfunction ReinstateNodes (nodes) {
+        /** make nodes which timed out on a job (see "JobTimeout" in mpi.CreateQueue) available
+            to the queues created from now on; existing queues keep excluding them
+         * @name mpi.ReinstateNodes
+         * @param  {Matrix|Dict|None} nodes
+         *      the indices of the nodes to reinstate; None to reinstate all of them
+         * @return {Number} the number of nodes which were reinstated
+         */
+
+        still_retired = {};
+        reinstated    = 0;
+        for (node, retired; in; ^"mpi.retired_nodes") {
+            if (retired) {
+                put_back = None == nodes;
+                if (put_back == FALSE) {
+                    for (candidate; in; nodes) {
+                        if (+candidate == +node) {
+                            put_back = TRUE;
+                        }
+                    }
+                }
+                if (put_back) {
+                    reinstated += 1;
+                } else {
+                    still_retired [node] = TRUE;
+                }
+            }
+        }
+        ^"mpi.retired_nodes" = still_retired;
+        return reinstated;
+    }
 
     function NodeCount () {
         return utility.GetEnvVariable ("MPI_NODE_COUNT");
@@ -75,6 +115,14 @@ namespace mpi {
          *      "Models" ->  matrix of model names to make available to slave nodes
          *      "Filters" ->  matrix of filter names to make available to slave nodes
          *      "LikelihoodFunctions" -> iterable (matrix/dict) of LikelihoodFunction IDs to export to slave nodes
+         *      "JobsPerNode" -> the number of jobs to keep in flight on each node (default 2)
+         *      "JobTimeout" -> if > 0, the number of seconds a node may spend on a job before the node
+         *                      is abandoned and its jobs are sent elsewhere (default 0 : no timeout); the node
+         *                      is not used by later queues either, until it is put back by mpi.ReinstateNodes
+         *      "JobRetries" -> how many times a job which failed (or timed out) is sent to another node
+         *                      before it is run on the master (default 2)
+         *      "SpeculativeJobs" -> if TRUE (default), nodes which run out of jobs at the end of the queue
+         *                      (see mpi.QueueComplete) run copies of the slowest outstanding jobs
          * @return {Dict} an "opaque" queue structure
          */
 
@@ -83,6 +131,7 @@ namespace mpi {
         queue = {};
         send_to_nodes = "";
         if (mpi_node_count > 1) {
+            active_nodes = aux.active_nodes ();
 
             if (None != nodesetup) {
                 if (Abs (nodesetup)) {
@@ -91,15 +140,18 @@ namespace mpi {
                                             'PRESERVE_SLAVE_NODE_STATE = TRUE; MPI_NEXUS_FILE_RETURN = "None";');
 
                     send_to_nodes * 128;
+                    // nodes keep their state between jobs, so that job functions (see QueueJob) and
+                    // the objects set up here are defined once per node
+                    send_to_nodes * "PRESERVE_SLAVE_NODE_STATE = TRUE;\n";
 
 
                     utility.ForEach (nodesetup[utility.getGlobalValue("terms.mpi.LikelihoodFunctions")], "_value_",
                                      '
                                         ExecuteCommands ("Export (create_queue.temp, " + _value_ + ")");
-                                        for (`&k` = 1; `&k` < `mpi_node_count`; `&k` += 1) {
+                                        for (`&k`; in; `&active_nodes`) {
                                            MPISend (`&k`, create_queue.temp);
                                         }
-                                        for (`&k` = 1; `&k` < `mpi_node_count`; `&k` += 1) {
+                                        for (`&k`; in; `&active_nodes`) {
                                             MPIReceive (-1, ignore, ignore);
                                         }
 
@@ -107,12 +159,10 @@ namespace mpi {
 
 
                     if (utility.Has (nodesetup, utility.getGlobalValue("terms.mpi.Headers"), None)) {
-                        send_to_nodes * "PRESERVE_SLAVE_NODE_STATE = TRUE;\n";
                         send_to_nodes * (Join (";\n",utility.Map (nodesetup[utility.getGlobalValue("terms.mpi.Headers")], "_value_", "'LoadFunctionLibrary(\"' + _value_ +'\")'")) + ";");
                     }
 
                     if (utility.Has (nodesetup, utility.getGlobalValue("terms.mpi.Functions"), None)) {
-                        send_to_nodes * "PRESERVE_SLAVE_NODE_STATE = TRUE;\n";
                         utility.ForEach (nodesetup[utility.getGlobalValue("terms.mpi.Functions")], "_value_",
                             '
                                 ExecuteCommands ("Export (_test_id_," + _value_ + ")");
@@ -142,7 +192,6 @@ namespace mpi {
                     model_count = utility.Array1D (nodesetup[utility.getGlobalValue("terms.mpi.Models")]);
 
                     if (model_count) {
-                        send_to_nodes * "PRESERVE_SLAVE_NODE_STATE = TRUE;\n";
 
                         globals_to_export = {};
                         functions_to_export = {};
@@ -180,6 +229,7 @@ namespace mpi {
 
 
                     send_to_nodes * 0;
+                    // node -> the set of job functions already defined on that node
                     queue ["cache"] = {};
 
                 }
@@ -187,17 +237,48 @@ namespace mpi {
 
             if (Abs (send_to_nodes)) {
 
-                for (k = 1; k < mpi_node_count; k += 1) {
+                for (k; in; active_nodes) {
                    MPISend (k, send_to_nodes);
                 }
-                for (k = 1; k < mpi_node_count; k += 1) {
+                for (k; in; active_nodes) {
                    MPIReceive (-1, ignore, ignore);
                 }
             }
 
             //assert (0);
+            // each node has a FIFO of the jobs sent to it: job_id -> {task, time sent}
+            // the time each node last returned a result (a node starts its next job then)
+            queue ["replied"] = {};
             for (k = 1; k < mpi_node_count; k += 1) {
-                queue [k] = {utility.getGlobalValue("terms.mpi.job_id") : None, utility.getGlobalValue("terms.mpi.callback") : None, utility.getGlobalValue("terms.mpi.arguments"): None};
+                queue [k] = {};
+                (queue ["replied"])[k] = 0;
+            }
+
+            // task -> {job, callback, arguments, copies in flight, failures}; a task is removed once its callback has been called
+            queue ["tasks"] = {};
+            // tasks to send (again) once a node is available
+            queue ["waiting"] = {};
+            // nodes which will not be sent any more jobs from this queue
+            queue ["excluded"] = utility.Extend ({}, ^"mpi.retired_nodes");
+
+            // keeping more than one job in flight per node lets a node start its next job without waiting for the master
+            queue [^"terms.mpi.JobsPerNode"] = 2;
+            queue [^"terms.mpi.JobTimeout"] = 0;
+            queue [^"terms.mpi.JobRetries"] = 2;
+            queue [^"terms.mpi.SpeculativeJobs"] = TRUE;
+            if (Type (nodesetup) == "AssociativeList") {
+                if (utility.Has (nodesetup, ^"terms.mpi.JobsPerNode", "Number")) {
+                    queue [^"terms.mpi.JobsPerNode"] = Max (1, nodesetup [^"terms.mpi.JobsPerNode"]);
+                }
+                if (utility.Has (nodesetup, ^"terms.mpi.JobTimeout", "Number")) {
+                    queue [^"terms.mpi.JobTimeout"] = Max (0, nodesetup [^"terms.mpi.JobTimeout"]);
+                }
+                if (utility.Has (nodesetup, ^"terms.mpi.JobRetries", "Number")) {
+                    queue [^"terms.mpi.JobRetries"] = Max (0, nodesetup [^"terms.mpi.JobRetries"]);
+                }
+                if (utility.Has (nodesetup, ^"terms.mpi.SpeculativeJobs", "Number")) {
+                    queue [^"terms.mpi.SpeculativeJobs"] = nodesetup [^"terms.mpi.SpeculativeJobs"];
+                }
             }
             
             // this will store jobs that were previously sent to each node; avoiding redefinition if possible
@@ -214,41 +295,24 @@ namespace mpi {
 
             When the job is finished; call the "result_callback" function
 
+            A job which fails on a node (or times out, see mpi.CreateQueue)
+            is sent to another node; the callback is called once per job.
+
         */
 
         mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
 
         if (mpi_node_count > 1) {
-            for (node = 1; node < mpi_node_count; node += 1) {
-                if (None == (queue [node])[utility.getGlobalValue("terms.mpi.job_id")]) {
-                    break;
-                }
-            }
+            // jobs waiting to be sent again go first
+            aux.dispatch_waiting (queue);
 
-            if (node == mpi_node_count) {
-                node = aux._handle_receieve (queue);
-            }
-
-            complete_function_dump = None;
-            
-            if (utility.Has (queue, "cache" , "AssociativeList")) {
-                if ((queue["cache"])[node] == job) {
-                    complete_function_dump = "";
-                    //console.log ("CACHED MPI preamble"); 
-                } else {
-                    (queue["cache"])[node] = job;
-                }
-            } 
-            
-            if (None == complete_function_dump) {
-                complete_function_dump = aux.queue_export_function (job);
-            }
-            
-            //console.log (complete_function_dump);
-            job_id = get_next_job_id();
-            //fprintf (stdout, "Sending to node ", node, "\n");
-            queue [node] = {utility.getGlobalValue("terms.mpi.job_id") : job_id, utility.getGlobalValue("terms.mpi.callback") : result_callback, utility.getGlobalValue("terms.mpi.arguments") : arguments};
-             MPISend (node, complete_function_dump + "; return " + job + '(' + Join (",",utility.Map (arguments,"_value_", "utility.convertToArgumentString (_value_)")) + ')');
+            task = "" + get_next_job_id();
+            (queue ["tasks"])[task] = {"job" : job,
+                                       utility.getGlobalValue("terms.mpi.callback") : result_callback,
+                                       utility.getGlobalValue("terms.mpi.arguments") : arguments,
+                                       "copies" : 0,
+                                       "failures" : 0};
+            aux.dispatch (queue, task);
 
         } else {
 
@@ -262,21 +326,33 @@ namespace mpi {
 
     lfunction QueueComplete (queue) {
 
+        /**
+            wait for all the jobs in the queue to finish. Nodes which have no
+            more jobs to run are sent copies of the jobs which have been running
+            the longest on other nodes (unless SpeculativeJobs is FALSE), and
+            the first copy to finish supplies the result; the other copies
+            are abandoned.
+        */
+
         mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
 
         if (mpi_node_count > 1) {
-            do {
-
-                for (node = 1; node < mpi_node_count; node += 1) {
-                    if (None != (queue [node])[utility.getGlobalValue("terms.mpi.job_id")]) {
-                        break;
+            while (Abs (queue ["tasks"])) {
+                aux.dispatch_waiting (queue);
+                if (Abs (queue ["tasks"])) {
+                    if (queue [^"terms.mpi.SpeculativeJobs"]) {
+                        aux.speculate (queue);
                     }
+                    aux._handle_receieve (queue);
                 }
+            }
 
-                if (node < mpi_node_count) {
-                    node = aux._handle_receieve (queue);
+            // whatever is still in flight is a copy of a job which has already finished
+            for (node = 1; node < mpi_node_count; node += 1) {
+                if (Abs (queue [node])) {
+                    aux.abandon_node (queue, node);
                 }
-            } while (node < mpi_node_count);
+            }
         }
         
         queue = None
@@ -289,10 +365,270 @@ namespace mpi {
             return complete_function_dump;
         }
 
+        lfunction active_nodes () {
+            // MPI nodes other than the master which have not been retired
+            nodes = {};
+            mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
+            for (k = 1; k < mpi_node_count; k += 1) {
+                if ((^"mpi.retired_nodes")[k] == FALSE) {
+                    nodes + k;
+                }
+            }
+            return nodes;
+        }
+
+        lfunction oldest_job (queue, node) {
+            // a node returns results in the order its jobs were sent, i.e. the oldest job has the smallest id
+            // (the order of dictionary keys is not preserved once keys have been removed)
+            oldest = None;
+            for (job_id, job; in; queue [node]) {
+                if (None == oldest) {
+                    oldest = job_id;
+                } else {
+                    if ((+job_id) < (+oldest)) {
+                        oldest = job_id;
+                    }
+                }
+            }
+            return oldest;
+        }
+
+        lfunction running_since (queue, node) {
+            // a node runs its jobs one at a time: the oldest one started when it was sent,
+            // or when the node returned the result of the previous one
+            return Max (((queue [node])[aux.oldest_job (queue, node)])["sent"], (queue ["replied"])[node]);
+        }
+
+        lfunction pick_node (queue) {
+            // the node with the fewest jobs in flight; 0 if all nodes are full, -1 if no node can be used
+            mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
+            node = -1;
+            for (k = 1; k < mpi_node_count; k += 1) {
+                if ((queue ["excluded"])[k] == FALSE) {
+                    if (node < 0) {
+                        node = k;
+                    } else {
+                        if (Abs (queue [k]) < Abs (queue [node])) {
+                            node = k;
+                        }
+                    }
+                }
+            }
+            if (node > 0) {
+                if (Abs (queue [node]) >= queue [^"terms.mpi.JobsPerNode"]) {
+                    return 0;
+                }
+            }
+            return node;
+        }
+
+        lfunction dispatch (queue, task) {
+            // send 'task' to a node, waiting for results if all nodes are full; a task which
+            // has failed too many times (or which no node can run) is run on the master,
+            // where a persistent error is reported as usual
+            while (utility.Has (queue ["tasks"], task, None)) {
+                node = -1;
+                if (((queue ["tasks"])[task])["failures"] <= queue [^"terms.mpi.JobRetries"]) {
+                    node = aux.pick_node (queue);
+                }
+                if (node > 0) {
+                    aux.send (queue, task, node);
+                    return node;
+                }
+                if (node < 0) {
+                    aux.run_on_master (queue, task);
+                    return 0;
+                }
+                aux._handle_receieve (queue);
+            }
+            return 0;
+        }
+
+        lfunction dispatch_waiting (queue) {
+            while (Abs (queue ["waiting"])) {
+                next_task = None;
+                for (task, ignore; in; queue ["waiting"]) {
+                    if (None == next_task) {
+                        next_task = task;
+                    } else {
+                        if ((+task) < (+next_task)) {
+                            next_task = task;
+                        }
+                    }
+                }
+                queue ["waiting"] - next_task;
+                aux.dispatch (queue, next_task);
+            }
+        }
+
+        lfunction send (queue, task, node) {
+            record = (queue ["tasks"])[task];
+            job    = record ["job"];
+            arguments = record [utility.getGlobalValue("terms.mpi.arguments")];
+
+            complete_function_dump = None;
+            
+            if (utility.Has (queue, "cache" , "AssociativeList")) {
+                if (Type ((queue["cache"])[node]) != "AssociativeList") {
+                    (queue["cache"])[node] = {};
+                }
+                if (((queue["cache"])[node])[job]) {
+                    complete_function_dump = "";
+                } else {
+                    ((queue["cache"])[node])[job] = TRUE;
+                }
+            }
+            
+            if (None == complete_function_dump) {
+                complete_function_dump = aux.queue_export_function (job);
+            }
+            
+            //console.log (complete_function_dump);
+            job_id = mpi.get_next_job_id();
+            //fprintf (stdout, "Sending to node ", node, "\n");
+            (queue [node])["" + job_id] = {"task" : task, "sent" : Time (1)};
+            ((queue ["tasks"])[task])["copies"] += 1;
+
+            // arguments travel in binary form; the node sees them as MPI_JOB_ARGUMENTS.
+            // An argument equal to the one previously sent to the node in the same position
+            // is not sent again (see MPISend), so e.g. a model mapping shared by all jobs is shipped once.
+            job_arguments = {};
+            call_arguments = {};
+            for (_key_, _value_; in; arguments) {
+                argument_key = "" + Abs (job_arguments);
+                job_arguments [argument_key] = _value_;
+                call_arguments + ('MPI_JOB_ARGUMENTS["' + argument_key + '"]');
+            }
+            MPISend (node, {"code" : complete_function_dump + "; return " + job + '(' + Join (",", call_arguments) + ')',
+                            "arguments" : job_arguments});
+        }
+
+        lfunction run_on_master (queue, task) {
+            record = (queue ["tasks"])[task];
+            queue ["tasks"] - task;
+            arguments = record [utility.getGlobalValue("terms.mpi.arguments")];
+            Call (record[utility.getGlobalValue("terms.mpi.callback")], 0, Eval (record["job"] + '(' + Join (",",utility.Map (arguments,"_value_", "utility.convertToArgumentString (_value_)")) + ')'), arguments);
+        }
+
+        lfunction abandon_node (queue, node) {
+            // stop using 'node' for this queue, drop the results of the jobs it is still
+            // running (local workers are restarted), and send the jobs elsewhere
+            SetParameter (MPI_DISCARD_REPLIES, node, TRUE);
+            (queue ["excluded"])[node] = TRUE;
+            if (utility.Has (queue, "cache" , "AssociativeList")) {
+                (queue["cache"])[node] = {};
+            }
+            for (job_id, job; in; queue [node]) {
+                task = job ["task"];
+                if (utility.Has (queue ["tasks"], task, None)) {
+                    ((queue ["tasks"])[task])["copies"] += -1;
+                    if (((queue ["tasks"])[task])["copies"] == 0) {
+                        (queue ["waiting"])[task] = TRUE;
+                    }
+                }
+            }
+            queue [node] = {};
+        }
+
+        lfunction speculate (queue) {
+            // send copies of the jobs which have been running the longest to idle nodes
+            mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
+            for (idle = 1; idle < mpi_node_count; idle += 1) {
+                if ((queue ["excluded"])[idle] == FALSE && Abs (queue [idle]) == 0) {
+                    slowest = None;
+                    started = 1e100;
+                    for (node = 1; node < mpi_node_count; node += 1) {
+                        if (Abs (queue [node])) {
+                            task = ((queue [node])[aux.oldest_job (queue, node)])["task"];
+                            if (((queue ["tasks"])[task])["copies"] == 1) {
+                                since = aux.running_since (queue, node);
+                                if (since < started) {
+                                    slowest = task;
+                                    started = since;
+                                }
+                            }
+                        }
+                    }
+                    if (None == slowest) {
+                        return 0;
+                    }
+                    messages.log ("Sending a copy of MPI job " + slowest + " to idle node " + idle);
+                    aux.send (queue, slowest, idle);
+                }
+            }
+            return 0;
+        }
+
         lfunction _handle_receieve (queue) {
-            MPIReceive (-1,from,result);
-            Call ((queue [from])[utility.getGlobalValue("terms.mpi.callback")], from, Eval(result), (queue [from])[utility.getGlobalValue("terms.mpi.arguments")]);
-            queue [from] = {utility.getGlobalValue("terms.mpi.job_id") : None, utility.getGlobalValue("terms.mpi.callback") : None};
+            // wait for a result; with a job timeout, stop waiting when the first running job is due
+            timeout = queue [^"terms.mpi.JobTimeout"];
+            wait_for = 0;
+            mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
+
+            if (timeout > 0) {
+                deadline = 1e100;
+                for (node = 1; node < mpi_node_count; node += 1) {
+                    if (Abs (queue [node])) {
+                        deadline = Min (deadline, aux.running_since (queue, node) + timeout);
+                    }
+                }
+                wait_for = Max (1, deadline - Time (1));
+            }
+
+            // a job which failed on a node is reported as an execution error
+            utility.SetEnvVariable ("LAST_HBL_EXECUTION_ERROR", "");
+            SetParameter (HBL_EXECUTION_ERROR_HANDLING, 1, 0);
+            if (wait_for > 0) {
+                MPIReceive (-1, from, result, wait_for);
+            } else {
+                MPIReceive (-1, from, result);
+            }
+            SetParameter (HBL_EXECUTION_ERROR_HANDLING, 0, 0);
+
+            failure = ^"LAST_HBL_EXECUTION_ERROR";
+            if (Abs (failure)) {
+                assert (from > 0, failure);
+                messages.log (failure);
+                if (Abs (queue [from])) {
+                    failed_task = ((queue [from])[aux.oldest_job (queue, from)])["task"];
+                    if (utility.Has (queue ["tasks"], failed_task, None)) {
+                        ((queue ["tasks"])[failed_task])["failures"] += 1;
+                    }
+                    aux.abandon_node (queue, from);
+                }
+                return 0;
+            }
+
+            if (from < 0) {
+                now = Time (1);
+                for (node = 1; node < mpi_node_count; node += 1) {
+                    if (Abs (queue [node])) {
+                        if (aux.running_since (queue, node) + timeout <= now) {
+                            messages.log ("MPI node " + node + " did not finish a job in " + timeout + " seconds; it will not be used again");
+                            timed_out_task = ((queue [node])[aux.oldest_job (queue, node)])["task"];
+                            if (utility.Has (queue ["tasks"], timed_out_task, None)) {
+                                ((queue ["tasks"])[timed_out_task])["failures"] += 1;
+                            }
+                            (^"mpi.retired_nodes")[node] = TRUE;
+                            aux.abandon_node (queue, node);
+                        }
+                    }
+                }
+                return 0;
+            }
+
+            (queue ["replied"])[from] = Time (1);
+            finished = aux.oldest_job (queue, from);
+            task = ((queue [from])[finished])["task"];
+            queue [from] - finished;
+
+            // the first copy of a task to finish supplies the result
+            if (utility.Has (queue ["tasks"], task, None)) {
+                record = (queue ["tasks"])[task];
+                queue ["tasks"] - task;
+                // the result of a binary job arrives as a value, not as a string to Eval
+                Call (record[utility.getGlobalValue("terms.mpi.callback")], from, result, record[utility.getGlobalValue("terms.mpi.arguments")]);
+            }
             return from;
         }
     }
@@ -351,6 +687,244 @@ namespace mpi {
 
     //------------------------------------------------------------------------------
 
+    lfunction ParallelMap (job, arguments, nodesetup) {
+
+        /** apply an lfunction to each of a collection of argument lists
+            and collect the results in input order. This is a convenience wrapper
+            over an mpi.CreateQueue job queue: the calls are spread over MPI nodes
+            (or local worker processes in builds without MPI), and run serially
+            on the master if there are none. Calls always run in separate
+            processes; there is no multithreaded execution of HBL
+         * @name mpi.ParallelMap
+         * @param  {String} job
+         *      the name of the lfunction to call; it should depend only on its arguments
+         * @param  {Dict|Matrix} arguments
+         *      Dict: key -> argument list for one call ({"0" : first argument, "1" : second argument, ...})
+         *      Matrix: each element is the only argument of one call (key = element index)
+         * @param  {Dict|None} nodesetup
+         *      passed to mpi.CreateQueue; 'job' and the loaded libv3 modules are always exported
+         * @return {Dict}
+         *      key -> job (argument list), with keys in the order of 'arguments'
+         */
+
+        if (Type (arguments) == "Matrix") {
+            call_count = utility.Array1D (arguments);
+            argument_lists = {};
+            for (i = 0; i < call_count; i += 1) {
+                argument_lists [i] = {"0" : arguments[i]};
+            }
+        } else {
+            argument_lists = arguments;
+        }
+
+        queue_setup = utility.Extend ({}, nodesetup);
+        exported_functions = {};
+        if (utility.Has (queue_setup, ^"terms.mpi.Functions", None)) {
+            utility.ForEach (queue_setup[^"terms.mpi.Functions"], "_value_", '`&exported_functions` + _value_');
+        }
+        exported_functions + job;
+        queue_setup [^"terms.mpi.Functions"] = exported_functions;
+        if (utility.Has (queue_setup, ^"terms.mpi.Headers", None) == FALSE) {
+            queue_setup [^"terms.mpi.Headers"] = utility.GetListOfLoadedModules ("libv3/");
+        }
+
+        results = {};
+        call_keys = utility.Keys (argument_lists);
+        call_count = Abs (argument_lists);
+
+        queue = mpi.CreateQueue (queue_setup);
+        for (i = 0; i < call_count; i += 1) {
+            mpi.QueueJob (queue, "mpi.ParallelMap.Evaluator", {"0" : job,
+                                                              "1" : call_keys[i],
+                                                              "2" : argument_lists[call_keys[i]],
+                                                              "3" : &results}, "mpi.ParallelMap.ResultHandler");
+        }
+        mpi.QueueComplete (queue);
+
+        ordered_results = {};
+        for (i = 0; i < call_count; i += 1) {
+            ordered_results [call_keys[i]] = results [call_keys[i]];
+        }
+        return ordered_results;
+    }
+
+    //------------------------------------------------------------------------------
+
+    lfunction ParallelMap.Evaluator (job, key, arguments, results) {
+        return {"key" : key,
+                "value" : Eval (job + '(' + Join (",",utility.Map (arguments,"_value_", "utility.convertToArgumentString (_value_)")) + ')')};
+    }
+
+    //------------------------------------------------------------------------------
+
+    lfunction ParallelMap.ResultHandler (node, result, arguments) {
+        (^(arguments[3]))[result["key"]] = result["value"];
+    }
+
+    //------------------------------------------------------------------------------
+
+    lfunction DistributeSiteBlocks (conditionals) {
+
+        /** split a (classes x sites) matrix of site conditional likelihoods (e.g. FUBAR
+            grid conditionals) into contiguous blocks of sites, and store one block on each
+            MPI node (the master keeps the first block). Each block is sent once, as a binary
+            matrix; mpi.ReduceSiteBlocks then only sends class weights to the nodes and
+            receives per-site reductions back.
+            Every reduction costs a round trip to each node, so blocks are only distributed
+            in MPI builds, and each block has at least mpi.site_block_min_size
+            (classes x sites) elements; otherwise there is a single block on the master.
+            Local workers (builds without MPI) are not used.
+         * @name mpi.DistributeSiteBlocks
+         * @param  {Matrix} conditionals
+         *      classes x sites
+         * @return {Dict} an "opaque" handle for mpi.ReduceSiteBlocks and mpi.ReleaseSiteBlocks
+         */
+
+        classes = Rows (conditionals);
+        sites   = Columns (conditionals);
+
+        block_count = 1;
+        mpi_node_count = utility.GetEnvVariable ("MPI_NODE_COUNT");
+        if (mpi_node_count > 1) {
+            if (utility.GetEnvVariable ("MPI_NODE_ID") == 0) {
+                GetString (version, HYPHY_VERSION, 1);
+                if ((version $ "\\(MPI\\)")[0] >= 0) {
+                    block_count = Max (1, Min (Min (mpi_node_count, sites), (classes * sites) $ Max (1, ^"mpi.site_block_min_size")));
+                }
+            }
+        }
+
+        // block -> [first site, last site + 1)
+        blocks     = {block_count, 2};
+        slice_size = sites $ block_count;
+        roundoff   = sites - block_count * slice_size;
+        from       = 0;
+
+        for (b = 0; b < block_count; b += 1) {
+            blocks [b][0] = from;
+            from += slice_size + (b < roundoff);
+            blocks [b][1] = from;
+        }
+
+        if (block_count > 1) {
+            // the blocks must survive between jobs; mpi.ReleaseSiteBlocks restores the previous setting
+            setup_code = "mpi.site_block_node_state = PRESERVE_SLAVE_NODE_STATE;\nPRESERVE_SLAVE_NODE_STATE = TRUE;\n" +
+                         "terms.mpi.site_sums = " + parameters.Quote (^"terms.mpi.site_sums") + ";\n" +
+                         "terms.mpi.class_posteriors = " + parameters.Quote (^"terms.mpi.class_posteriors") + ";\n" +
+                         aux.queue_export_function ("mpi.ReduceSiteBlock") +
+                         ";\nmpi.site_block = MPI_JOB_ARGUMENTS['0'];\nreturn 0;";
+
+            for (b = 1; b < block_count; b += 1) {
+                MPISend (b, {"code" : setup_code,
+                             "arguments" : {"0" : aux.site_block (conditionals [{{0, blocks[b][0]}}][{{classes - 1, blocks[b][1] - 1}}])}});
+            }
+            for (b = 1; b < block_count; b += 1) {
+                MPIReceive (-1, ignore, ignore);
+            }
+
+            return {"blocks" : blocks,
+                    "sites"  : sites,
+                    "master" : aux.site_block (conditionals [{{0, 0}}][{{classes - 1, blocks[0][1] - 1}}])};
+        }
+
+        return {"blocks" : blocks,
+                "sites"  : sites,
+                "master" : aux.site_block (conditionals)};
+    }
+
+    //------------------------------------------------------------------------------
+
+    lfunction ReduceSiteBlocks (handle, weights) {
+
+        /** reduce site conditional likelihoods distributed by mpi.DistributeSiteBlocks
+            using class weights; each node reduces its own block of sites
+         * @name mpi.ReduceSiteBlocks
+         * @param  {Dict} handle
+         *      returned by mpi.DistributeSiteBlocks
+         * @param  {Matrix} weights
+         *      classes x 1 : the weight of each class
+         * @return {Dict}
+         *      terms.mpi.site_sums        -> 1 x sites : \sum_i weights_i conditionals_is
+         *      terms.mpi.class_posteriors -> classes x 1 : \sum_s weights_i conditionals_is / site_sums_s
+         */
+
+        blocks      = handle["blocks"];
+        block_count = Rows (blocks);
+
+        for (b = 1; b < block_count; b += 1) {
+            MPISend (b, {"code" : "return mpi.ReduceSiteBlock (MPI_JOB_ARGUMENTS['0'], mpi.site_block)",
+                         "arguments" : {"0" : weights}});
+        }
+
+        // the master reduces its own block while the nodes work on theirs
+        reduction = mpi.ReduceSiteBlock (weights, handle["master"]);
+
+        if (block_count > 1) {
+            site_sums        = {1, handle["sites"]};
+            class_posteriors = reduction [^"terms.mpi.class_posteriors"];
+            block_sums       = reduction [^"terms.mpi.site_sums"];
+            for (s = 0; s < blocks[0][1]; s += 1) {
+                site_sums [s] = block_sums [s];
+            }
+
+            for (b = 1; b < block_count; b += 1) {
+                MPIReceive (-1, from, result);
+                class_posteriors += result [^"terms.mpi.class_posteriors"];
+                block_sums        = result [^"terms.mpi.site_sums"];
+                offset            = blocks[from][0];
+                for (s = offset; s < blocks[from][1]; s += 1) {
+                    site_sums [s] = block_sums [s - offset];
+                }
+            }
+
+            return {^"terms.mpi.site_sums" : site_sums,
+                    ^"terms.mpi.class_posteriors" : class_posteriors};
+        }
+
+        return reduction;
+    }
+
+    //------------------------------------------------------------------------------
+
+    lfunction ReleaseSiteBlocks (handle) {
+
+        /** free the blocks of site conditional likelihoods stored on MPI nodes, and
+            restore the setting of PRESERVE_SLAVE_NODE_STATE the nodes had before
+            mpi.DistributeSiteBlocks
+         * @name mpi.ReleaseSiteBlocks
+         * @param  {Dict} handle
+         *      returned by mpi.DistributeSiteBlocks
+         */
+
+        block_count = Rows (handle["blocks"]);
+        for (b = 1; b < block_count; b += 1) {
+            MPISend (b, {"code" : "mpi.site_block = 0; PRESERVE_SLAVE_NODE_STATE = mpi.site_block_node_state; return 0;"});
+        }
+        for (b = 1; b < block_count; b += 1) {
+            MPIReceive (-1, ignore, ignore);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+
+    lfunction ReduceSiteBlock (weights, block) {
+        joint     = weights $ block["conditionals"];
+        site_sums = block["classes"] * joint;
+        return {^"terms.mpi.site_sums" : site_sums,
+                ^"terms.mpi.class_posteriors" : (joint / site_sums) * block["sites"]};
+    }
+
+    namespace aux {
+        lfunction site_block (conditionals) {
+            // the unit vectors used to sum over classes and sites are kept with the block
+            return {"conditionals" : conditionals,
+                    "classes" : {1, Rows (conditionals)}["1"],
+                    "sites" : {Columns (conditionals), 1}["1"]};
+        }
+    }
+
+    //------------------------------------------------------------------------------
+
     lfunction pass2.evaluator (lf_id, tasks, scores) {
 
         results = {};
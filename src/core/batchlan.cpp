@@ -52,6 +52,7 @@
 #include "global_object_lists.h"
 #include "global_things.h"
 #include "time_difference.h"
+#include "local_workers.h"
 #include "global_things.h"
 #include "hy_string_buffer.h"
 #include "tree_iterator.h"
@@ -255,40 +256,179 @@ void    ReportMPIError      (int code, bool send) {
 }
 
 #define MPI_SEND_CHUNK 0xFFFFFFL
+#define MPI_EAGER_SIZE 0x4000L
+  // messages up to MPI_EAGER_SIZE characters travel together with their length in a single MPI message;
+  // longer ones send the length first, followed by MPI_SEND_CHUNK sized pieces
+
+/* sends are non-blocking: the master can dispatch several jobs to a node which
+   is still busy with an earlier one (and is about to send a long reply) without
+   deadlocking; each pending send owns a copy of the message until it completes */
+
+static _List            mpi_pending_send_buffers;
+static MPI_Request    * mpi_pending_sends         = nil;
+static long             mpi_pending_send_capacity = 0L;
+
+/* every node keeps a receive posted for the length of the next message from each
+   of the other nodes (lazily, when a message from that node is first expected) */
+
+static MPI_Request    * mpi_posted_receives       = nil;
+static char          ** mpi_posted_buffers        = nil;
 
 //____________________________________________________________________________________
 
-void    MPISendString       (_String const& theMessage, long destID, bool isError)
-{
+static void _MPICompletePendingSends (bool wait) {
+    long const pending = mpi_pending_send_buffers.countitems();
+    if (pending == 0L) {
+        return;
+    }
+    if (wait) {
+        ReportMPIError(MPI_Waitall (pending, mpi_pending_sends, MPI_STATUSES_IGNORE), true);
+    } else {
+        int done = 0;
+        ReportMPIError(MPI_Testall (pending, mpi_pending_sends, &done, MPI_STATUSES_IGNORE), true);
+        if (!done) {
+            // only retire a completed prefix, so that pending sends stay in order
+            long completed = 0L;
+            for (; completed < pending; completed++) {
+                int flag = 0;
+                ReportMPIError(MPI_Test (mpi_pending_sends + completed, &flag, MPI_STATUS_IGNORE), true);
+                if (!flag) {
+                    break;
+                }
+            }
+            if (completed) {
+                memmove (mpi_pending_sends, mpi_pending_sends + completed, (pending - completed) * sizeof (MPI_Request));
+                for (long k = 0L; k < completed; k++) {
+                    mpi_pending_send_buffers.Delete (0);
+                }
+            }
+            return;
+        }
+    }
+    mpi_pending_send_buffers.Clear();
+}
 
-    long    messageLength = theMessage.length(),
-            transferCount = 0L;
+//____________________________________________________________________________________
 
-    if (isError) {
-        messageLength = -messageLength;
+static void _MPIStartSend (_String * buffer, long destID, int tag) {
+    // takes ownership of 'buffer'
+    long const pending = mpi_pending_send_buffers.countitems();
+    if (pending == mpi_pending_send_capacity) {
+        mpi_pending_send_capacity = MAX (16L, mpi_pending_send_capacity * 2L);
+        mpi_pending_sends = (MPI_Request*)MemReallocate (mpi_pending_sends, mpi_pending_send_capacity * sizeof (MPI_Request));
     }
+    mpi_pending_send_buffers.AppendNewInstance (buffer);
+    ReportMPIError(MPI_Isend ((void*)buffer->get_str(), buffer->length(), MPI_CHAR, destID, tag, MPI_COMM_WORLD, mpi_pending_sends + pending), true);
+}
 
-    ReportMPIError(MPI_Send(&messageLength, 1, MPI_LONG, destID, HYPHY_MPI_SIZE_TAG, MPI_COMM_WORLD),true);
+//____________________________________________________________________________________
 
-    if (messageLength == 0L) {
-        return;
+static void _MPIPostReceive (long node) {
+    if (!mpi_posted_receives) {
+        mpi_posted_receives = (MPI_Request*)MemAllocate (hy_mpi_node_count * sizeof (MPI_Request));
+        mpi_posted_buffers  = (char**)MemAllocate (hy_mpi_node_count * sizeof (char*), true);
+        for (long k = 0L; k < hy_mpi_node_count; k++) {
+            mpi_posted_receives[k] = MPI_REQUEST_NULL;
+        }
+    }
+    if (node != hy_mpi_node_rank && mpi_posted_receives[node] == MPI_REQUEST_NULL) {
+        if (!mpi_posted_buffers[node]) {
+            mpi_posted_buffers[node] = (char*)MemAllocate (sizeof (long) + MPI_EAGER_SIZE);
+        }
+        ReportMPIError(MPI_Irecv (mpi_posted_buffers[node], sizeof (long) + MPI_EAGER_SIZE, MPI_CHAR, node, HYPHY_MPI_SIZE_TAG, MPI_COMM_WORLD, mpi_posted_receives + node), false);
     }
+}
 
-    if (isError) {
-        messageLength = -messageLength;
+//____________________________________________________________________________________
+
+static long _MPIWaitForPostedReceive (long node, MPI_Status & status, hyFloat timeout) {
+    /* wait for the posted receive from 'node' (or from any node if node < 0) to complete,
+       and return the node the message came from (or -1 if nothing arrived in 'timeout'
+       seconds; timeout <= 0 waits indefinitely)
+
+       the wait is spin-then-sleep: poll MPI_RECEIVE_SPIN_COUNT times, and then sleep
+       between polls for exponentially longer intervals, up to MPI_RECEIVE_MAX_SLEEP
+       microseconds; MPI_RECEIVE_MAX_SLEEP = 0 blocks in MPI_Wait[any] instead, which
+       usually means busy waiting inside the MPI library
+     */
+
+    if (node < 0L) {
+        for (long k = 0L; k < hy_mpi_node_count; k++) {
+            _MPIPostReceive (k);
+        }
+    } else {
+        _MPIPostReceive (node);
     }
 
-    while (messageLength-transferCount>MPI_SEND_CHUNK) {
-        printf("%s",theMessage.get_str());
-        ReportMPIError(MPI_Send((void*)(theMessage.get_str()+transferCount), MPI_SEND_CHUNK, MPI_CHAR, destID, HYPHY_MPI_STRING_TAG, MPI_COMM_WORLD),true);
-        transferCount += MPI_SEND_CHUNK;
+    long const spin_count = hy_env::EnvVariableGetNumber(hy_env::mpi_receive_spin_count, 1000.),
+               max_sleep  = hy_env::EnvVariableGetNumber(hy_env::mpi_receive_max_sleep, 1000.);
+
+    int        index = (int)node;
+
+    if (max_sleep <= 0L && timeout <= 0.) {
+        _MPICompletePendingSends (false);
+        if (node < 0L) {
+            ReportMPIError(MPI_Waitany (hy_mpi_node_count, mpi_posted_receives, &index, &status), false);
+        } else {
+            ReportMPIError(MPI_Wait (mpi_posted_receives + node, &status), false);
+        }
+        return index;
     }
 
-    if (messageLength-transferCount) {
-        ReportMPIError(MPI_Send((void*)(theMessage.get_str()+transferCount), messageLength-transferCount, MPI_CHAR, destID, HYPHY_MPI_STRING_TAG, MPI_COMM_WORLD),true);
+    long       polls = 0L,
+               sleep_for = 1L;
+
+    TimeDifference timer;
+
+    while (true) {
+        int flag = 0;
+        if (node < 0L) {
+            ReportMPIError(MPI_Testany (hy_mpi_node_count, mpi_posted_receives, &index, &flag, &status), false);
+        } else {
+            ReportMPIError(MPI_Test (mpi_posted_receives + node, &flag, &status), false);
+        }
+        if (flag) {
+            return index;
+        }
+        if (polls++ >= spin_count) {
+            if (timeout > 0. && timer.TimeSinceStart() >= timeout) {
+                return -1L;
+            }
+            _MPICompletePendingSends (false);
+            usleep (sleep_for);
+            sleep_for = MIN (sleep_for * 2L, MAX (1L, max_sleep));
+        }
     }
+}
 
-    //ReportMPIError(MPI_Send(&messageLength, 1, MPI_LONG, destID, HYPHY_MPI_DONE_TAG, MPI_COMM_WORLD),true);
+//____________________________________________________________________________________
+
+void    MPISendString       (_String const& theMessage, long destID, bool isError)
+{
+
+    long    messageLength = theMessage.length(),
+            transferCount = 0L;
+
+    _MPICompletePendingSends (false);
+
+    long    const signedLength = isError ? -messageLength : messageLength;
+
+    if (messageLength <= MPI_EAGER_SIZE) {
+        _String * packet = new _String ((unsigned long)(sizeof (long) + messageLength));
+        memcpy ((char*)packet->get_str(), &signedLength, sizeof (long));
+        memcpy ((char*)packet->get_str() + sizeof (long), theMessage.get_str(), messageLength);
+        _MPIStartSend (packet, destID, HYPHY_MPI_SIZE_TAG);
+    } else {
+        _String * header = new _String ((unsigned long)sizeof (long));
+        memcpy ((char*)header->get_str(), &signedLength, sizeof (long));
+        _MPIStartSend (header, destID, HYPHY_MPI_SIZE_TAG);
+
+        while (transferCount < messageLength) {
+            long const chunk = MIN (MPI_SEND_CHUNK, messageLength-transferCount);
+            _MPIStartSend (new _String (theMessage, transferCount, transferCount + chunk - 1L), destID, HYPHY_MPI_STRING_TAG);
+            transferCount += chunk;
+        }
+    }
 
     _FString*    sentVal = new _FString ((_String*)theMessage.makeDynamic());
     _Variable *   mpiMsgVar = CheckReceptacle (&hy_env::mpi_last_sent_message, kEmptyString, false);
@@ -298,84 +438,78 @@ void    MPISendString       (_String const& theMessage, long destID, bool isErro
 }
 
 //____________________________________________________________________________________
-_String*    MPIRecvString       (long senderT, long& senderID) {
-    _String*    theMessage = nil;
+_String*    MPIRecvString       (long senderT, long& senderID, hyFloat timeout) {
     long        messageLength = 0L,
                 transferCount = 0L;
 
     int         actualReceived = 0;
     bool        isError       = false;
 
-    if  (senderT<0) {
-        senderT = MPI_ANY_SOURCE;
-    }
-
     MPI_Status  status;
-  
-    // nonagressive polling mode
-    
-    //ReportWarning ("Step 1");
-  
-    int message_received = 0;
-    while (! message_received) {
-      MPI_Iprobe (senderT, HYPHY_MPI_SIZE_TAG, MPI_COMM_WORLD, &message_received, MPI_STATUS_IGNORE);
-      usleep (100);
+
+    senderT = senderID = _MPIWaitForPostedReceive (senderT, status, timeout);
+
+    if (senderT < 0L) {
+        return nil;
     }
 
-    //ReportWarning ("Step 2");
-    // nonagressive polling mode
-  
-  
-    ReportMPIError(MPI_Recv(&messageLength, 1, MPI_LONG, senderT, HYPHY_MPI_SIZE_TAG, MPI_COMM_WORLD,&status),false);
+    char const * packet = mpi_posted_buffers[senderT];
+    memcpy (&messageLength, packet, sizeof (long));
+    MPI_Get_count (&status,MPI_CHAR,&actualReceived);
 
     if (messageLength < 0) {
         isError = true;
         messageLength = -messageLength;
     }
-    
-    //ReportWarning ("Step 3");
-    //printf ("MPIRecvString size tag %ld (size chunk %ld) \n",messageLength, MPI_SEND_CHUNK);
 
-    if (!isError) {
-        //MPI_Get_count (&status,MPI_CHAR,&actualReceived);
+    _String * theMessage = new _String ((unsigned long)messageLength);
 
-        if (messageLength==0) {
-            return new _String;
+    if (actualReceived > (int)sizeof (long)) { // the message came with its length
+        if (actualReceived != (long)sizeof (long) + messageLength) {
+            HandleApplicationError ("Failed in MPIRecvString - some data was not properly received\n");
         }
-
-        theMessage = new _String ((unsigned long)messageLength);
-
-        senderT = senderID = status.MPI_SOURCE;
-
-        while (messageLength-transferCount>MPI_SEND_CHUNK) {
-            ReportMPIError(MPI_Recv((void*)(theMessage->get_str()+transferCount), MPI_SEND_CHUNK, MPI_CHAR, senderT, HYPHY_MPI_STRING_TAG, MPI_COMM_WORLD,&status),false);
-            MPI_Get_count (&status,MPI_CHAR,&actualReceived);
-            if (actualReceived!=MPI_SEND_CHUNK) {
-                HandleApplicationError ("Failed in MPIRecvString - some data was not properly received\n");
-            }
-            //return    nil;
-            transferCount += MPI_SEND_CHUNK;
-        }
-
-        if (messageLength-transferCount) {
-            //printf ("Clause 2 %d %d\n", messageLength-transferCount, theMessage->length());
-            ReportMPIError(MPI_Recv((void*)(theMessage->get_str()+transferCount), messageLength-transferCount, MPI_CHAR, senderT, HYPHY_MPI_STRING_TAG, MPI_COMM_WORLD,&status),false);
+        memcpy ((char*)theMessage->get_str(), packet + sizeof (long), messageLength);
+    } else {
+        while (transferCount < messageLength) {
+            long const chunk = MIN (MPI_SEND_CHUNK, messageLength-transferCount);
+            ReportMPIError(MPI_Recv((void*)(theMessage->get_str()+transferCount), chunk, MPI_CHAR, senderT, HYPHY_MPI_STRING_TAG, MPI_COMM_WORLD,&status),false);
             MPI_Get_count (&status,MPI_CHAR,&actualReceived);
-            if (actualReceived!=messageLength-transferCount) {
+            if (actualReceived!=chunk) {
                 HandleApplicationError ("Failed in MPIRecvString - some data was not properly received\n");
             }
-            //return    nil;
+            transferCount += chunk;
         }
-        
-        //ReportWarning ("Step 4");
+    }
 
-        //ReportMPIError(MPI_Recv(&messageLength, 1, MPI_LONG, senderT, HYPHY_MPI_DONE_TAG, MPI_COMM_WORLD,&status),false);
+    if (isError) {
+        HandleApplicationError (*theMessage);
+    }
+    return theMessage;
+}
 
-        if (isError) {
-            HandleApplicationError (theMessage);
+//____________________________________________________________________________________
+void    MPIFinishCommunication (void) {
+    _MPICompletePendingSends (true);
+    if (mpi_posted_receives) {
+        for (long k = 0L; k < hy_mpi_node_count; k++) {
+            if (mpi_posted_receives[k] != MPI_REQUEST_NULL) {
+                MPI_Cancel (mpi_posted_receives + k);
+                MPI_Wait   (mpi_posted_receives + k, MPI_STATUS_IGNORE);
+            }
+            if (mpi_posted_buffers[k]) {
+                free (mpi_posted_buffers[k]);
+            }
         }
+        free (mpi_posted_receives);
+        free (mpi_posted_buffers);
+        mpi_posted_receives = nil;
+        mpi_posted_buffers  = nil;
+    }
+    if (mpi_pending_sends) {
+        free (mpi_pending_sends);
+        mpi_pending_sends = nil;
+        mpi_pending_send_capacity = 0L;
     }
-    return theMessage;
 }
 #endif
 
@@ -1376,6 +1510,8 @@ HBLObjectRef       _ExecutionList::Execute     (_ExecutionList* parent, bool ign
             (((_ElementaryCommand**)list_data)[currentCommand])->Execute(*this);
         }
 
+        RaiseDeferredWorkerJobFailure ();
+
         if (terminate_execution) {
             break;
         }
@@ -2656,7 +2792,7 @@ void      _ElementaryCommand::ExecuteCase5 (_ExecutionList& chain) {
             }
             SetStatusLine ("Loading Data");
 
-            df = doFileOpen (fName.get_str(),"rb");
+            df = doDataFileOpen (fName.get_str());
             if (df==nil) {
                 // try reading this file as a string formula
                 fName = GetStringFromFormula ((_String*)parameters(1),chain.nameSpacePrefix);
@@ -2666,7 +2802,7 @@ void      _ElementaryCommand::ExecuteCase5 (_ExecutionList& chain) {
                     return;
                 }
 
-                df = doFileOpen (fName.get_str(),"rb");
+                df = doDataFileOpen (fName.get_str());
                 if (df==nil) {
                      HandleApplicationError ((_String ("Could not find source dataset file ") & ((_String*)parameters(1))->Enquote('"')
                                 & " (resolved to '" & fName & "')\nPath stack:\n\t" & GetPathStack ("\n\t")));
@@ -2678,6 +2814,10 @@ void      _ElementaryCommand::ExecuteCase5 (_ExecutionList& chain) {
         }
     }
 
+    if (!ds) {
+        // ReadDataSetFile has reported the error (execution continues if errors are soft)
+        return;
+    }
 
     // 20110802: need to check that this data set is not empty
 
@@ -4365,6 +4505,7 @@ bool    _ElementaryCommand::ProcessInclude      (_String&source, _ExecutionList&
     if (terminate_execution) {
         return false;
     }
+    parseTimeSideEffects ++;
     PushFilePath  (fileName);
     ReadBatchFile (fileName, target);
     PopFilePath   ();
@@ -4878,6 +5019,8 @@ bool    _ElementaryCommand::ConstructFunction (_String&source, _ExecutionList& c
         
       }
 
+      parseTimeSideEffects ++;
+
       _List       arguments;
       _SimpleList argument_types;
 
@@ -308,10 +308,16 @@ const long cut, const long conditions, const char sep, const bool doTrim, const
                                                                 "Integrate (<receptacle>, <expression>, <variable to integrate over for>,<left bound>,<right bound>)",','));
 
 
+    lengthOptions.Clear();lengthOptions.Populate (2,3,1); // 3, 4
     _HY_HBLCommandHelper.Insert    ((BaseRef)HY_HBL_COMMAND_MPI_RECEIVE,
                                     (long)_hyInitCommandExtras (_HY_ValidHBLExpressions.Insert ("MPIReceive(", HY_HBL_COMMAND_MPI_RECEIVE,false),
-                                                                3,
-                                                                "MPIReceive (<from node; or -1 to receive from any>, <message storage>, <sender index storage>)",','));
+                                                                -1,
+                                                                "MPIReceive (<from node; or -1 to receive from any>, <sender index storage>, <message storage>, [optional timeout in seconds; sender index is set to -1 if nothing arrived in time])",
+                                                                ',',
+                                                                true,
+                                                                false,
+                                                                false,
+                                                                &lengthOptions));
 
     _HY_HBLCommandHelper.Insert    ((BaseRef)HY_HBL_COMMAND_LFCOMPUTE,
                                       (long)_hyInitCommandExtras (_HY_ValidHBLExpressions.Insert ("LFCompute(", HY_HBL_COMMAND_LFCOMPUTE,false),
@@ -45,7 +45,17 @@
 using namespace hy_global;
 
 _Trie   _HY_HBL_Namespaces;
-_List   templateModelList;
+_List   templateModelList,
+        _parsedCodeCacheKeys,
+        _parsedFormulaCacheKeys;
+
+_AVLListXL
+        _parsedCodeCache    (&_parsedCodeCacheKeys),
+        _parsedFormulaCache (&_parsedFormulaCacheKeys);
+
+unsigned long parseTimeSideEffects = 0UL;
+
+static  const unsigned long kParsedCodeCacheCapacity = 512UL;
 
 extern  _List batchLanguageFunctionNames;
 
@@ -221,6 +231,233 @@ void   ExecuteBLString (_String& BLCommand, _VariableContainer* theP)
 
 //____________________________________________________________________________________
 
+static _String const _parsedCodeCacheKey (_String const& source, _String const * name_space) {
+    // ':' can't appear in a namespace ID, so the key is unambiguous
+    return (name_space ? *name_space : kEmptyString) & ':' & source;
+}
+
+//____________________________________________________________________________________
+
+static bool _isAGeneratedNameSpace (_String const * name_space) {
+    // is any part of the namespace ID generated by _HYGenerateANameSpace (e.g. the namespace of an lfunction)?
+    if (name_space) {
+        _List const parts (name_space->Tokenize ("."));
+        for (unsigned long i = 0UL; i < parts.countitems(); i++) {
+            if (_HY_HBL_Namespaces.FindKey (*(_String const*)parts.GetItem (i)) != kNotFound) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//____________________________________________________________________________________
+
+_ExecutionList*   FetchParsedCode (_String const& source, _String const * name_space) {
+    if (_isAGeneratedNameSpace (name_space)) {
+        return nil;
+    }
+    
+    _String const key (_parsedCodeCacheKey (source, name_space));
+    
+    long cache_index = _parsedCodeCache.Find (&key);
+    
+    if (cache_index != kNotFound) {
+        _ExecutionList * code = (_ExecutionList*)_parsedCodeCache.GetXtra (cache_index);
+        // the same list can't be used for a nested invocation, because stdin redirects
+        // and keyword arguments are set on the list itself
+        if (executionStack.FindPointer (code) == kNotFound) {
+            if (currentExecutionList) {
+                code->errorHandlingMode  = currentExecutionList->errorHandlingMode;
+                code->errorState         = currentExecutionList->errorState;
+            }
+            code->AddAReference();
+            return code;
+        }
+    }
+    return nil;
+}
+
+//____________________________________________________________________________________
+
+void   StoreParsedCode (_String const& source, _String const * name_space, _ExecutionList* code) {
+    /* execution lists refer to variables by their full names, so they can't be rebound to another namespace;
+       code run in generated namespaces is not cached: these are made anew whenever an lfunction is
+       (re)defined, and entries keyed on them would never be used again */
+    if (_isAGeneratedNameSpace (name_space)) {
+        return;
+    }
+    if (_parsedCodeCache.countitems() >= kParsedCodeCacheCapacity) {
+        // lists currently in use are reference counted, and will survive this
+        _parsedCodeCache.Clear (true);
+    }
+    _parsedCodeCache.Insert (new _String (_parsedCodeCacheKey (source, name_space)), (long)code, true);
+}
+
+//____________________________________________________________________________________
+
+_ParsedFormula::~_ParsedFormula (void) {
+    delete formula;
+}
+
+//____________________________________________________________________________________
+
+BaseRef   _ParsedFormula::makeDynamic (void) const {
+    _ParsedFormula * copy = new _ParsedFormula (new _Formula);
+    copy->Duplicate (this);
+    return copy;
+}
+
+//____________________________________________________________________________________
+
+void   _ParsedFormula::Duplicate (BaseRefConst source) {
+    _ParsedFormula const * parsed = (_ParsedFormula const*)source;
+    
+    delete formula;
+    formula = (_Formula*)parsed->formula->makeDynamic();
+    // _Formula::Duplicate shares the terms; copy them, so that SetBindings does not change the source
+    for (unsigned long i = 0UL; i < formula->Length(); i++) {
+        formula->GetList().Replace (i, formula->GetIthTerm (i), true);
+    }
+    bound_slots.Duplicate (&parsed->bound_slots);
+    bound_names.Duplicate (&parsed->bound_names);
+    context_name = parsed->context_name;
+}
+
+//____________________________________________________________________________________
+
+bool   _ParsedFormula::Rebind (_VariableContainer const* context, _SimpleList & slots) const {
+    _String const * use_context = context ? context->GetName() : nil;
+    
+    slots.Clear();
+    
+    for (unsigned long i = 0UL; i < bound_names.countitems(); i++) {
+        _String const * bound_name = (_String const*)bound_names.GetItem (i);
+        long            resolved;
+        
+        if (use_context) {
+            /* resolve the identifier (relative to the context the expression was parsed in)
+               again, the way _Operation does when parsing in a context: a global variable
+               with the identifier for a name wins, otherwise the identifier is local to the context. */
+            
+            _String identifier (*bound_name);
+            if (context_name.nonempty() && bound_name->BeginsWith (context_name) && bound_name->char_at (context_name.length()) == '.') {
+                identifier = _String (*bound_name, context_name.length() + 1L, kStringEnd);
+            }
+            
+            resolved = LocateVarByName (identifier);
+            if (_hy_application_globals.Find (&identifier) < 0L) {
+                if (resolved < 0L || !FetchVar (resolved)->IsGlobal()) {
+                    resolved = LocateVarByName (*use_context & '.' & identifier);
+                }
+            }
+        } else {
+            resolved = LocateVarByName (*bound_name);
+        }
+        
+        if (resolved < 0L) {
+            return false;
+        }
+        slots << variableNames.GetXtra (resolved);
+    }
+    return true;
+}
+
+//____________________________________________________________________________________
+
+void   _ParsedFormula::SetBindings (_SimpleList const & slots) {
+    unsigned long binding = 0UL;
+    
+    for (unsigned long i = 0UL; i < formula->Length(); i++) {
+        _Operation * term = formula->GetIthTerm (i);
+        if (term->RetrieveVar()) {
+            long const slot = slots.get (binding++);
+            // keep the way the term refers to the variable (value, reference or value substitution)
+            if (term->IsValueSubstitution()) {
+                term->SetTerms (-slot - 1L);
+            } else if (term->AssignmentVariable()) {
+                term->SetAVariable (-slot - 3L);
+            } else {
+                term->SetAVariable (slot);
+            }
+        }
+    }
+    bound_slots.Duplicate (&slots);
+}
+
+//____________________________________________________________________________________
+
+_ParsedFormula*   FetchParsedFormula (_String const& source, _VariableContainer const* context) {
+    /* expressions parsed in a context are keyed on the source text only (with a marker
+       to keep them apart from those parsed without one), and are rebound to the variables
+       of the context they are used in, so that lfunctions (each with its own namespace) share them */
+    
+    static _String const kInAContext (".");
+    
+    _String const key (_parsedCodeCacheKey (source, context ? &kInAContext : nil));
+    
+    long cache_index = _parsedFormulaCache.Find (&key);
+    
+    if (cache_index != kNotFound) {
+        _ParsedFormula * cached = (_ParsedFormula*)_parsedFormulaCache.GetXtra (cache_index);
+        _SimpleList      slots;
+        if (cached->Rebind (context, slots)) {
+            if (slots.Equal (cached->bound_slots)) {
+                cached->AddAReference();
+                return cached;
+            }
+            _ParsedFormula * rebound = (_ParsedFormula*)cached->makeDynamic();
+            rebound->SetBindings (slots);
+            return rebound;
+        }
+        _parsedFormulaCache.Delete (&key, true);
+    }
+    
+    _ParsedFormula        * parsed = new _ParsedFormula (new _Formula);
+    _FormulaParsingContext  fpc (nil, context);
+    _String                 source_copy (source);
+    
+    if (Parse (parsed->formula, source_copy, fpc, nil) != HY_FORMULA_EXPRESSION) {
+        parsed->formula->Clear();
+        return parsed;
+    }
+    
+    if (fpc.isVolatile() || terminate_execution) {
+        return parsed;
+    }
+    
+    for (unsigned long i = 0UL; i < parsed->formula->Length(); i++) {
+        _Operation * term = parsed->formula->GetIthTerm(i);
+        if (term->IsHBLFunctionCall()) {
+            // function indices are not stable across ClearBFFunctionLists
+            return parsed;
+        }
+        _Variable * bound_variable = term->RetrieveVar();
+        if (bound_variable) {
+            parsed->bound_slots << bound_variable->get_index();
+            parsed->bound_names.AppendNewInstance (new _String (*bound_variable->GetName()));
+        }
+    }
+    if (context) {
+        parsed->context_name = *context->GetName();
+    }
+    
+    if (_parsedFormulaCache.countitems() >= kParsedCodeCacheCapacity) {
+        _parsedFormulaCache.Clear (true);
+    }
+    _parsedFormulaCache.Insert (new _String (key), (long)parsed, true);
+    return parsed;
+}
+
+//____________________________________________________________________________________
+
+void   ClearParsedCodeCache (void) {
+    _parsedCodeCache.Clear (true);
+    _parsedFormulaCache.Clear (true);
+}
+
+//____________________________________________________________________________________
+
 _String const ReturnDialogInput(bool dispPath, _String const * rel_path) {
     bool do_markdown     = hy_env :: EnvVariableTrue(hy_env :: produce_markdown_output);
     NLToConsole ();
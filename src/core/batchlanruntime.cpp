@@ -52,6 +52,9 @@
 #include      "tree_iterator.h"
 
 #include      "function_templates.h"
+#include      "local_workers.h"
+#include      "worker_messages.h"
+#include      "time_difference.h"
 
 
 #ifndef __HYPHY_NO_SQLITE__
@@ -420,7 +423,26 @@ bool      _ElementaryCommand::HandleGetDataInfo (_ExecutionList& current_program
                           kConsensus                                      ("CONSENSUS"),
                           kParameters                                     ("PARAMETERS"),
                           kPattern                                        ("PATTERN"),
-                          kSite                                           ("SITE");
+                          kSite                                           ("SITE"),
+                          kPairwiseDistances                              ("PAIRWISE_DISTANCES"),
+                          kPairwiseDistancesMetric                        ("metric"),
+                          kPairwiseDistancesAmbiguities                   ("ambigs"),
+                          kPairwiseDistancesFrequencies                   ("frequencies"),
+                          kPairwiseDistancesTN93                          ("TN93"),
+                          kPairwiseDistancesProportion                    ("P_DISTANCE");
+
+    auto ambiguity_resolution = [] (_String const& flag) -> _hy_dataset_filter_ambiguity_resolution {
+        if (kPairwiseCountAmbiguitiesAverage == flag) {
+            return kAmbiguityHandlingAverageFrequencyAware;
+        }
+        if (kPairwiseCountAmbiguitiesResolve == flag) {
+            return kAmbiguityHandlingResolve;
+        }
+        if (kPairwiseCountAmbiguitiesSkip == flag) {
+            return kAmbiguityHandlingSkip;
+        }
+        return kAmbiguityHandlingResolveFrequencyAware;
+    };
 
 
     _Variable * receptacle = nil;
@@ -536,7 +558,32 @@ bool      _ElementaryCommand::HandleGetDataInfo (_ExecutionList& current_program
 
             case 4UL : {
                 if (filter_source) {
-                    long seq  = _ProcessNumericArgumentWithExceptions (*GetIthParameter(2),current_program.nameSpacePrefix),
+                    _List           dynamic_variable_cleanup;
+                    HBLObjectRef    first_argument = _ProcessAnArgumentByType (*GetIthParameter(2), NUMBER|STRING, current_program, &dynamic_variable_cleanup);
+
+                    if (first_argument->ObjectClass() == STRING && ((_FString*)first_argument)->get_str() == kPairwiseDistances) {
+                        // distances between all pairs of sequences
+                        _AssociativeList * options   = (_AssociativeList*)_ProcessAnArgumentByType (*GetIthParameter(3), ASSOCIATIVE_LIST, current_program, &dynamic_variable_cleanup);
+                        _FString         * metric    = (_FString*)options->GetByKey (kPairwiseDistancesMetric, STRING),
+                                         * ambigs    = (_FString*)options->GetByKey (kPairwiseDistancesAmbiguities, STRING);
+                        _Matrix          * freqs     = (_Matrix*) options->GetByKey (kPairwiseDistancesFrequencies, MATRIX);
+
+                        _hy_dataset_filter_distance_metric distance_metric = kDistanceMetricTN93;
+                        if (metric && metric->get_str() == kPairwiseDistancesProportion) {
+                            distance_metric = kDistanceMetricProportion;
+                        } else if (metric && metric->get_str() != kPairwiseDistancesTN93) {
+                            throw (metric->get_str().Enquote() & " is not a supported distance metric; use " & kPairwiseDistancesTN93.Enquote() & " or " & kPairwiseDistancesProportion.Enquote());
+                        }
+
+                        if (freqs) {
+                            freqs = (_Matrix*)freqs->ComputeNumeric();
+                        }
+
+                        receptacle->SetValue (filter_source->ComputePairwiseDistances (distance_metric, ambiguity_resolution (ambigs ? ambigs->get_str() : kPairwiseCountAmbiguitiesResolve), freqs),false,true, NULL);
+                        break;
+                    }
+
+                    long seq  = first_argument->ObjectClass() == NUMBER ? first_argument->Value() : ((_FString*)first_argument)->get_str().to_float(),
                          site = _ProcessNumericArgumentWithExceptions (*GetIthParameter(3),current_program.nameSpacePrefix);
 
                     if (site >=0 && site<filter_source->GetPatternCount()) {
@@ -590,20 +637,7 @@ bool      _ElementaryCommand::HandleGetDataInfo (_ExecutionList& current_program
                          seq2  = _ProcessNumericArgumentWithExceptions (*GetIthParameter(3),current_program.nameSpacePrefix);
 
                     if ( seq1>=0 && seq2 >=0 && seq1< filter_source->NumberSpecies() && seq2 <filter_source->NumberSpecies()) {
-                        _String const *  res_flag = GetIthParameter(4);
-                        _Matrix * res;
-                        
-                        if (kPairwiseCountAmbiguitiesAverage == *res_flag) {
-                            res = filter_source->ComputePairwiseDifferences (seq1,seq2,kAmbiguityHandlingAverageFrequencyAware);
-                        } else if (kPairwiseCountAmbiguitiesResolve == *res_flag) {
-                            res = filter_source->ComputePairwiseDifferences (seq1,seq2,kAmbiguityHandlingResolve);
-                        } else if (kPairwiseCountAmbiguitiesSkip == *res_flag) {
-                            res = filter_source->ComputePairwiseDifferences (seq1,seq2,kAmbiguityHandlingSkip);
-                        } else {
-                            res = filter_source->ComputePairwiseDifferences (seq1,seq2,kAmbiguityHandlingResolveFrequencyAware);
-                        }
-
-                        receptacle->SetValue (res,false,true, NULL);
+                        receptacle->SetValue (filter_source->ComputePairwiseDifferences (seq1,seq2,ambiguity_resolution (*GetIthParameter(4))),false,true, NULL);
                     } else {
                         throw (_String (seq1).Enquote() & "," & _String (seq2).Enquote() & " is an invalid sequence pair specification.");
                     }
@@ -2283,16 +2317,57 @@ bool      _ElementaryCommand::HandleMolecularClock(_ExecutionList& current_progr
 
   //____________________________________________________________________________________
 
+static _SimpleList mpi_replies_expected,  // per node: jobs sent by MPISend which have not been replied to
+                   mpi_replies_to_discard; // per node: replies to drop on arrival (see MPI_DISCARD_REPLIES)
+
+static void _MPIReplyCounts (long node_count) {
+  if (mpi_replies_expected.countitems() < (unsigned long)node_count) {
+    mpi_replies_expected.Populate   (node_count, 0L, 0L);
+    mpi_replies_to_discard.Populate (node_count, 0L, 0L);
+  }
+}
+
+#ifdef __HYPHYMPI__
+
+  //____________________________________________________________________________________
+
+void      MPIDiscardOutstandingReplies (void) {
+  /* a node can not complete sending a long reply (and so can not shut down) until the
+     master has received it; this includes the replies which MPIReceive would have dropped
+     (e.g. those to abandoned copies of speculative jobs) */
+  for (unsigned long node = 1UL; node < mpi_replies_expected.countitems(); node++) {
+    long outstanding = mpi_replies_expected.get (node) + mpi_replies_to_discard.get (node);
+    if (outstanding > 0L) {
+      ReportWarning (_String ("Discarding ") & outstanding & " outstanding replies from node " & (long)node);
+    }
+    for (; outstanding > 0L; outstanding--) {
+      long received_from;
+      DeleteObject (MPIRecvString (node, received_from));
+    }
+    mpi_replies_expected.list_data[node] = mpi_replies_to_discard.list_data[node] = 0L;
+  }
+}
+
+#endif
+
+  //____________________________________________________________________________________
+
 bool      _ElementaryCommand::HandleMPIReceive (_ExecutionList& current_program){
   current_program.advance();
-  _Variable * receptacle = nil;
+  _Variable * receptacle = nil,
+            * node_index_storage = nil;
+  long        received_from = -1L;
 
   try {
 
-#ifdef __HYPHYMPI__
+#ifndef __HYPHYMPI__
+    if (LocalWorkerCount() == 0L) {
+      throw _String("Command not supported for non-MPI versions of HyPhy. HBL scripts need to check for MPI before calling MPI features");
+    }
+#endif
 
     receptacle = _ValidateStorageVariable (current_program, 2UL);
-    _Variable* node_index_storage = _ValidateStorageVariable (current_program, 1UL);
+    node_index_storage = _ValidateStorageVariable (current_program, 1UL);
 
     long target_node = _ProcessNumericArgumentWithExceptions(*GetIthParameter(0UL), current_program.nameSpacePrefix),
     node_count  = hy_env::EnvVariableGetNumber(hy_env::mpi_node_count);
@@ -2301,15 +2376,65 @@ bool      _ElementaryCommand::HandleMPIReceive (_ExecutionList& current_program)
       throw (GetIthParameter(1UL)->Enquote () & " (=" & node_count & ") must be a valid MPI node index (or -1 to accept from any node");
     }
 
-    long received_from;
-    receptacle->SetValue(new _FString (MPIRecvString (target_node,received_from)), false, true,NULL);
-    node_index_storage->SetValue (new _Constant (received_from), false, true, NULL);
+    // with a timeout, from = -1 and an empty result mean that nothing arrived in time
+    hyFloat const timeout = parameter_count() > 3UL ? _ProcessNumericArgumentWithExceptions(*GetIthParameter(3UL), current_program.nameSpacePrefix) : 0.;
+
+    _MPIReplyCounts (node_count);
+
+    TimeDifference timer;
+    _String * message = nil;
 
+    while (true) {
+      hyFloat const time_left = timeout > 0. ? MAX (timeout - timer.TimeSinceStart(), 1.e-3) : 0.;
+      try {
+#ifdef __HYPHYMPI__
+        message = MPIRecvString (target_node,received_from,time_left);
 #else
-    throw _String("Command not supported for non-MPI versions of HyPhy. HBL scripts need to check for MPI before calling MPI features");
+        message = LocalWorkerReceive (target_node,received_from,time_left);
 #endif
+      } catch (const _String&) {
+        if (received_from > 0L) { // the worker terminated; its jobs will not be replied to
+          mpi_replies_expected.list_data[received_from] = mpi_replies_to_discard.list_data[received_from] = 0L;
+        }
+        throw;
+      }
+      if (!message) {
+        receptacle->SetValue (new _MathObject, false, true, NULL);
+        node_index_storage->SetValue (new _Constant (-1.), false, true, NULL);
+        return true;
+      }
+      if (mpi_replies_to_discard.get (received_from) > 0L) {
+        mpi_replies_to_discard.list_data[received_from] --;
+        DeleteObject (message);
+        continue;
+      }
+      if (mpi_replies_expected.get (received_from) > 0L) {
+        mpi_replies_expected.list_data[received_from] --;
+      }
+      break;
+    }
+
+    if (IsWorkerFailureMessage (*message)) { // the job failed on the worker (see ExecuteWorkerJob)
+      _String error = _String ("MPI node ") & received_from & " failed to complete a job: " & DecodeWorkerFailure (*message);
+      DeleteObject (message);
+      throw error;
+    }
+
+    if (IsWorkerValueMessage (*message)) { // the result of a binary job
+      _List message_manager;
+      message_manager.AppendNewInstance (message);
+      receptacle->SetValue(DecodeWorkerValue (*message), false, true,NULL);
+    } else {
+      receptacle->SetValue(new _FString (message), false, true,NULL);
+    }
+    node_index_storage->SetValue (new _Constant (received_from), false, true, NULL);
 
   } catch (const _String& error) {
+    // the sender of a failure (or a local worker which terminated) is reported,
+    // so that a script handling the error can tell which node to recover from
+    if (node_index_storage) {
+      node_index_storage->SetValue (new _Constant (received_from), false, true, NULL);
+    }
     return  _DefaultExceptionHandler (receptacle, error, current_program);
   }
 
@@ -2319,14 +2444,21 @@ bool      _ElementaryCommand::HandleMPIReceive (_ExecutionList& current_program)
   //____________________________________________________________________________________
 
 bool      _ElementaryCommand::HandleMPISend (_ExecutionList& current_program){
+  static const _String kMPIJobCode ("code");
+
   current_program.advance();
   
   _List dynamic_variable_manager;
   
   try {
 
-#ifdef __HYPHYMPI__
-   long target_node = _ProcessNumericArgumentWithExceptions(*GetIthParameter(0UL), current_program.nameSpacePrefix),
+#ifndef __HYPHYMPI__
+    if (LocalWorkerCount() == 0L) {
+      throw _String("Command not supported for non-MPI versions of HyPhy. HBL scripts need to check for MPI before calling MPI features");
+    }
+#endif
+
+    long target_node = _ProcessNumericArgumentWithExceptions(*GetIthParameter(0UL), current_program.nameSpacePrefix),
          node_count  = hy_env::EnvVariableGetNumber(hy_env::mpi_node_count);
 
     if (target_node < 0L || target_node >= node_count) {
@@ -2349,19 +2481,30 @@ bool      _ElementaryCommand::HandleMPISend (_ExecutionList& current_program){
         try {
           ((_LikelihoodFunction*) _GetHBLObjectByTypeMutable(AppendContainerName (*GetIthParameter(1), current_program.nameSpacePrefix), type))->SerializeLF(message_to_send, _hyphyLFSerializeModeOptimize);
         } catch (const _String &) {
-            // catch literal cases here
-            message_to_send = _ProcessALiteralArgument(*GetIthParameter(1UL), current_program);
+            // catch literal cases here; a dictionary is sent as a binary job (see ExecuteWorkerJob)
+            HBLObjectRef job = _ProcessAnArgumentByType(*GetIthParameter(1UL), STRING|ASSOCIATIVE_LIST, current_program, &dynamic_variable_manager);
+            if (job->ObjectClass() == ASSOCIATIVE_LIST) {
+              if (!((_AssociativeList*)job)->GetByKey (kMPIJobCode, STRING)) {
+                throw (GetIthParameter(1UL)->Enquote() & " must have a string-valued " & kMPIJobCode.Enquote() & " key to be sent as a binary MPI job");
+              }
+              message_to_send.AppendNewInstance(EncodeWorkerJob ((_AssociativeList*)job, target_node));
+            } else {
+              message_to_send << ((_FString*)job)->get_str();
+            }
         }
     }
 
     if (message_to_send.nonempty()) {
+#ifdef __HYPHYMPI__
       MPISendString(message_to_send, target_node);
+#else
+      LocalWorkerSend(target_node, message_to_send);
+#endif
+      _MPIReplyCounts (node_count);
+      mpi_replies_expected.list_data[target_node] ++;
     } else {
       throw (_String ("An invalid (empty) MPI message"));
     }
-#else
-    throw _String("Command not supported for non-MPI versions of HyPhy. HBL scripts need to check for MPI before calling MPI features");
-#endif
 
   } catch (const _String& error) {
     return  _DefaultExceptionHandler (nil, error, current_program);
@@ -2380,7 +2523,8 @@ bool      _ElementaryCommand::HandleSetParameter (_ExecutionList& current_progra
                        kBGMGraph     ("BGM_GRAPH_MATRIX"),
                        kBGMScores    ("BGM_SCORE_CACHE"),
                        kBGMConstraintMx ("BGM_CONSTRAINT_MATRIX"),
-                       kBGMParameters   ("BGM_NETWORK_PARAMETERS");
+                       kBGMParameters   ("BGM_NETWORK_PARAMETERS"),
+                       kDataFilterSites ("SITES");
 
   current_program.advance();
   
@@ -2412,6 +2556,23 @@ bool      _ElementaryCommand::HandleSetParameter (_ExecutionList& current_progra
       return true;
     }
 
+    if (object_to_change == hy_env::mpi_discard_replies) {
+      long const node       = _ProcessNumericArgumentWithExceptions (*GetIthParameter(1),current_program.nameSpacePrefix),
+                 node_count = hy_env::EnvVariableGetNumber(hy_env::mpi_node_count);
+      if (node < 1L || node >= node_count) {
+        throw (GetIthParameter(1UL)->Enquote () & " (=" & node & ") must be a valid MPI worker node index");
+      }
+      _MPIReplyCounts (node_count);
+      if (_ProcessNumericArgumentWithExceptions (*GetIthParameter(2),current_program.nameSpacePrefix) != 0. && LocalWorkerCount ()) {
+        LocalWorkerTerminate (node);
+        mpi_replies_to_discard.list_data[node] = 0L;
+      } else {
+        mpi_replies_to_discard.list_data[node] += mpi_replies_expected.get (node);
+      }
+      mpi_replies_expected.list_data[node] = 0L;
+      return true;
+    }
+
     if (object_to_change == hy_env::status_bar_update_string) {
       SetStatusLineUser (_ProcessALiteralArgument (*GetIthParameter(1), current_program));
       return true;
@@ -2555,6 +2716,44 @@ bool      _ElementaryCommand::HandleSetParameter (_ExecutionList& current_progra
 
         if (object_type == HY_BL_DATASET_FILTER) {
           ReleaseDataFilterLock (object_index);
+          
+          if (set_this_attribute == kDataFilterSites) {
+            /*
+               SetParameter (filter, SITES, "site partition") replaces the sites of the filter
+               (given in the coordinates of the underlying data set) in place; this keeps the rows of
+               the patterns shared by the old and the new sites, so that the likelihood functions using
+               the filter only need to update the changed rows (e.g. for sliding window scans)
+            */
+            _DataSetFilter * dsf = (_DataSetFilter*)source_object;
+            if (!dsf->IsNormalFilter()) {
+              throw (source_name.Enquote() & " is not a character data filter");
+            }
+            
+            _SimpleList  sites,
+                         changed_patterns;
+            
+            dsf->GetData()->ProcessPartition (*GetIthParameter(2UL), sites, true, dsf->GetUnitLength(), nil, nil, current_program.GetNameSpace());
+            
+            if (sites.empty()) {
+              throw (GetIthParameter(2UL)->Enquote() & " did not select any sites");
+            }
+            
+            if (dsf->UpdateSites (sites, changed_patterns)) {
+              NotifyDataFilterSitesChanged (object_index, &changed_patterns);
+            } else {
+              _String     * exclusions = dsf->GetExclusions();
+              _SimpleList   species (dsf->theNodeMap);
+              
+              dsf->SetFilter      (dsf->GetData(), dsf->GetUnitLength(), species, sites);
+              dsf->SetExclusions  (*exclusions);
+              dsf->SetDimensions  ();
+              dsf->SetupConversion();
+              DeleteObject (exclusions);
+              
+              NotifyDataFilterSitesChanged (object_index, nil);
+            }
+            break;
+          }
         }
 
         long sequence_index  = _ProcessNumericArgumentWithExceptions (*GetIthParameter(1),current_program.nameSpacePrefix);
@@ -2922,85 +3121,102 @@ bool      _ElementaryCommand::HandleExecuteCommandsCases(_ExecutionList& current
         if (source_code->BeginsWith ("#NEXUS")) {
             ReadDataSetFile (nil,1,source_code,nil,use_this_namespace);
         } else {
-            bool result = false;
+            // compiled (simple) execution lists are modified in place, so they are not cached
+            bool const use_cache = simpleParameters.empty();
             
-            _ExecutionList code (*source_code, use_this_namespace, false, &result);
+            _ExecutionList * code = use_cache ? FetchParsedCode (*source_code, use_this_namespace) : nil;
             
-            if (!result) {
-                throw (_String("Encountered an error while parsing HBL"));
-            } else {
+            if (!code) {
+                bool                result = false;
+                unsigned long const side_effects = parseTimeSideEffects;
                 
+                dynamic_reference_manager < (code = new _ExecutionList (*source_code, use_this_namespace, false, &result));
                 
-                _AVLListXL * stash1 = nil;
-                _List      * stash2 = nil,
-                * stash_kw_tags = nil;
-                
-                _AssociativeList * stash_kw = nil;
-                
-                bool update_kw = false;
-                
-                if (has_redirected_input) {
-                    code.stdinRedirectAux = &_aux_argument_list;
-                    code.stdinRedirect = &argument_list;
-                } else {
-                    if (current_program.has_stdin_redirect()) {
-                        stash1 = current_program.stdinRedirect;
-                        stash2 = current_program.stdinRedirectAux;
-                        current_program.stdinRedirect->AddAReference();
-                        current_program.stdinRedirectAux->AddAReference();
-                    }
-                    code.stdinRedirect = current_program.stdinRedirect;
-                    code.stdinRedirectAux = current_program.stdinRedirectAux;
+                if (!result) {
+                    throw (_String("Encountered an error while parsing HBL"));
                 }
                 
-                
-                bool ignore_ces_args = false;
-                
-                if (has_user_kwargs) {
-                    code.SetKWArgs(user_kwargs);
-                    ignore_ces_args = true;
-                } else {
-                    if (current_program.has_keyword_arguments()) {
-                        code.kwarg_tags = stash_kw_tags = current_program.kwarg_tags;
-                        code.kwargs = stash_kw = current_program.kwargs;
-                        if (stash_kw_tags) current_program.kwarg_tags->AddAReference();
-                        if (stash_kw) current_program.kwargs->AddAReference();
-                        code.currentKwarg = current_program.currentKwarg;
-                        update_kw = true;
-                    }
+                // do not cache code whose parsing had global side effects (function definitions, #include)
+                if (use_cache && side_effects == parseTimeSideEffects && !terminate_execution && !(currentExecutionList && currentExecutionList->IsErrorState())) {
+                    StoreParsedCode (*source_code, use_this_namespace, code);
                 }
-                
-                
-                
-                if (!simpleParameters.empty() && code.TryToMakeSimple(true)) {
-                    ReportWarning (_String ("Successfully compiled an execution list (possibly partially).\n") & _String ((_String*)code.toStr()) );
-                    code.ExecuteSimple ();
-                } else {
-                    code.Execute(nil, ignore_ces_args);
-                }
-                
-                if (stash1) {
-                    stash1->RemoveAReference();
-                    stash2->RemoveAReference();
-                }
-                
-                if (stash_kw_tags) stash_kw_tags->RemoveAReference();
-                if (stash_kw) stash_kw->RemoveAReference();
-                
-                code.stdinRedirectAux = nil;
-                code.stdinRedirect    = nil;
-                if (update_kw) {
-                    code.kwarg_tags       = nil;
-                    code.kwargs           = nil;
-                    current_program.currentKwarg = code.currentKwarg;
+            } else {
+                dynamic_reference_manager < code;
+            }
+            
+            _AVLListXL * stash1 = nil;
+            _List      * stash2 = nil,
+            * stash_kw_tags = nil;
+            
+            _AssociativeList * stash_kw = nil;
+            
+            bool update_kw = false;
+            
+            if (has_redirected_input) {
+                code->stdinRedirectAux = &_aux_argument_list;
+                code->stdinRedirect = &argument_list;
+            } else {
+                if (current_program.has_stdin_redirect()) {
+                    stash1 = current_program.stdinRedirect;
+                    stash2 = current_program.stdinRedirectAux;
+                    current_program.stdinRedirect->AddAReference();
+                    current_program.stdinRedirectAux->AddAReference();
                 }
-                
-                if (code.result) {
-                    DeleteObject (current_program.result);
-                    current_program.result = code.result;
-                    code.result = nil;
+                code->stdinRedirect = current_program.stdinRedirect;
+                code->stdinRedirectAux = current_program.stdinRedirectAux;
+            }
+            
+            
+            bool ignore_ces_args = false;
+            
+            if (has_user_kwargs) {
+                code->SetKWArgs(user_kwargs);
+                ignore_ces_args = true;
+            } else {
+                if (current_program.has_keyword_arguments()) {
+                    code->kwarg_tags = stash_kw_tags = current_program.kwarg_tags;
+                    code->kwargs = stash_kw = current_program.kwargs;
+                    if (stash_kw_tags) current_program.kwarg_tags->AddAReference();
+                    if (stash_kw) current_program.kwargs->AddAReference();
+                    code->currentKwarg = current_program.currentKwarg;
+                    update_kw = true;
                 }
             }
+            
+            
+            
+            if (!simpleParameters.empty() && code->TryToMakeSimple(true)) {
+                ReportWarning (_String ("Successfully compiled an execution list (possibly partially).\n") & _String ((_String*)code->toStr()) );
+                code->ExecuteSimple ();
+            } else {
+                code->Execute(nil, ignore_ces_args);
+            }
+            
+            if (ignore_ces_args) {
+                DeleteAndZeroObject (code->kwargs);
+            }
+            
+            if (stash1) {
+                stash1->RemoveAReference();
+                stash2->RemoveAReference();
+            }
+            
+            if (stash_kw_tags) stash_kw_tags->RemoveAReference();
+            if (stash_kw) stash_kw->RemoveAReference();
+            
+            code->stdinRedirectAux = nil;
+            code->stdinRedirect    = nil;
+            if (update_kw) {
+                code->kwarg_tags       = nil;
+                code->kwargs           = nil;
+                current_program.currentKwarg = code->currentKwarg;
+            }
+            
+            if (code->result) {
+                DeleteObject (current_program.result);
+                current_program.result = code->result;
+                code->result = nil;
+            }
         }
     } catch (const _String& error) {
         cleanup ();
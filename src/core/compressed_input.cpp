@@ -0,0 +1,335 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "compressed_input.h"
+#include "classes.h"
+#include "global_things.h"
+
+#if defined __HYPHYZLIB__ && (defined __GLIBC__ || defined __APPLE__ || defined __FreeBSD__)
+  #define __HYPHY_COMPRESSED_INPUT__
+#endif
+
+#ifdef __HYPHY_COMPRESSED_INPUT__
+
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/** the number and the size of decompressed buffers kept ahead of the reader */
+static const unsigned long kCompressedInputSlots       = 8UL,
+                           kCompressedInputSlotSize    = 1UL << 20,
+                           kCompressedInputStdioBuffer = 1UL << 16;
+
+//____________________________________________________________________________________
+
+class _CompressedInputStream {
+
+public:
+
+  _CompressedInputStream (gzFile source) : source (source) {
+    for (unsigned long slot = 0UL; slot < kCompressedInputSlots; slot++) {
+      buffers[slot] = new char [kCompressedInputSlotSize];
+    }
+    position   = 0L;
+    total_size = -1L;
+    Start ();
+  }
+
+  ~_CompressedInputStream (void) {
+    Stop ();
+    gzclose (source);
+    for (unsigned long slot = 0UL; slot < kCompressedInputSlots; slot++) {
+      delete [] buffers[slot];
+    }
+  }
+
+  /** copy up to 'size' decompressed bytes into 'destination'; returns the
+      number of bytes copied (0 at the end of the file), or -1 on errors */
+  long Read (char * destination, unsigned long size) {
+    unsigned long copied = 0UL;
+
+    while (copied < size) {
+      std::unique_lock <std::mutex> guard (lock);
+      slot_filled.wait (guard, [this] () -> bool {return head < tail || finished;});
+
+      if (head == tail) {  // nothing left to read
+        if (error) {
+          return -1L;
+        }
+        break;
+      }
+
+      unsigned long const slot    = head % kCompressedInputSlots,
+                          to_copy = MIN (size - copied, lengths[slot] - read_offset);
+
+      guard.unlock ();
+      // the decompression thread does not write to slots that are yet to be consumed
+      memcpy (destination + copied, buffers[slot] + read_offset, to_copy);
+      copied      += to_copy;
+      read_offset += to_copy;
+      guard.lock ();
+
+      if (read_offset == lengths[slot]) {
+        head ++;
+        read_offset = 0UL;
+        slot_consumed.notify_one ();
+      }
+    }
+
+    position += copied;
+    return copied;
+  }
+
+  /** seek to an uncompressed offset (whence as in fseek); returns the new offset or -1 */
+  long Seek (long offset, int whence) {
+    long target;
+
+    switch (whence) {
+      case SEEK_SET:
+        target = offset;
+        break;
+      case SEEK_CUR:
+        target = position + offset;
+        break;
+      case SEEK_END:
+        if (total_size < 0L) {
+          if (Skip (-1L) < 0L) {
+            return -1L;
+          }
+          total_size = position;
+        }
+        target = total_size + offset;
+        break;
+      default:
+        return -1L;
+    }
+
+    if (target < 0L) {
+      return -1L;
+    }
+
+    if (target < position) {
+      Stop ();
+      if (gzrewind (source) != 0) {
+        finished = error = true;
+        return -1L;
+      }
+      position = 0L;
+      Start ();
+    }
+
+    if (Skip (target - position) < 0L) {
+      return -1L;
+    }
+    return position;
+  }
+
+private:
+
+  /** skip 'count' bytes (or to the end of the file if count < 0) */
+  long Skip (long count) {
+    char discard [kCompressedInputStdioBuffer];
+    while (count != 0L) {
+      unsigned long const chunk = count < 0L ? kCompressedInputStdioBuffer : MIN ((unsigned long)count, kCompressedInputStdioBuffer);
+      long const read_this_time = Read (discard, chunk);
+      if (read_this_time < 0L) {
+        return -1L;
+      }
+      if (read_this_time == 0L) {
+        break;
+      }
+      if (count > 0L) {
+        count -= read_this_time;
+      }
+    }
+    return position;
+  }
+
+  void Start (void) {
+    head = tail = read_offset = 0UL;
+    finished = error = stop = false;
+    worker = std::thread (&_CompressedInputStream::Decompress, this);
+  }
+
+  void Stop (void) {
+    {
+      std::lock_guard <std::mutex> guard (lock);
+      stop = true;
+    }
+    slot_consumed.notify_one ();
+    if (worker.joinable()) {
+      worker.join ();
+    }
+  }
+
+  void Decompress (void) {
+    while (true) {
+      unsigned long slot;
+      {
+        std::unique_lock <std::mutex> guard (lock);
+        slot_consumed.wait (guard, [this] () -> bool {return tail - head < kCompressedInputSlots || stop;});
+        if (stop) {
+          return;
+        }
+        slot = tail % kCompressedInputSlots;
+      }
+
+      int const inflated = gzread (source, buffers[slot], kCompressedInputSlotSize);
+
+      std::lock_guard <std::mutex> guard (lock);
+      if (inflated <= 0) {
+        finished = true;
+        error    = inflated < 0;
+        slot_filled.notify_one ();
+        return;
+      }
+      lengths[slot] = inflated;
+      tail ++;
+      slot_filled.notify_one ();
+    }
+  }
+
+  gzFile                    source;
+  std::thread               worker;
+  std::mutex                lock;
+  std::condition_variable   slot_filled,
+                            slot_consumed;
+
+  char *                    buffers [kCompressedInputSlots];
+  unsigned long             lengths [kCompressedInputSlots],
+                            head,         // slots consumed by the reader
+                            tail,         // slots filled by the decompression thread
+                            read_offset;  // the next byte to read in the head slot
+  bool                      finished,
+                            error,
+                            stop;
+
+  long                      position,     // the uncompressed offset of the next byte to read
+                            total_size;   // the uncompressed size of the file, if known
+};
+
+//____________________________________________________________________________________
+
+#ifdef __GLIBC__
+
+static ssize_t _CompressedInputRead (void * cookie, char * buffer, size_t size) {
+  return ((_CompressedInputStream*)cookie)->Read (buffer, size);
+}
+
+static int _CompressedInputSeek (void * cookie, off64_t * offset, int whence) {
+  long const new_position = ((_CompressedInputStream*)cookie)->Seek (*offset, whence);
+  if (new_position < 0L) {
+    return -1;
+  }
+  *offset = new_position;
+  return 0;
+}
+
+static int _CompressedInputClose (void * cookie) {
+  delete (_CompressedInputStream*)cookie;
+  return 0;
+}
+
+#else
+
+static int _CompressedInputRead (void * cookie, char * buffer, int size) {
+  return ((_CompressedInputStream*)cookie)->Read (buffer, size);
+}
+
+static fpos_t _CompressedInputSeek (void * cookie, fpos_t offset, int whence) {
+  return ((_CompressedInputStream*)cookie)->Seek (offset, whence);
+}
+
+static int _CompressedInputClose (void * cookie) {
+  delete (_CompressedInputStream*)cookie;
+  return 0;
+}
+
+#endif
+
+#endif
+
+namespace hy_global {
+
+  //____________________________________________________________________________________
+
+  FILE*   OpenCompressedInput (const char * file_path) {
+#ifdef __HYPHY_COMPRESSED_INPUT__
+    FILE * probe = fopen (file_path, "rb");
+    if (!probe) {
+      return nil;
+    }
+    unsigned char magic [2];
+    bool const is_gzip = fread (magic, 1, 2, probe) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    fclose (probe);
+
+    if (!is_gzip) {
+      return nil;
+    }
+
+    gzFile source = gzopen (file_path, "rb");
+    if (!source) {
+      return nil;
+    }
+    gzbuffer (source, kCompressedInputSlotSize);
+
+    _CompressedInputStream * stream = new _CompressedInputStream (source);
+
+#ifdef __GLIBC__
+    cookie_io_functions_t functions = {_CompressedInputRead, nil, _CompressedInputSeek, _CompressedInputClose};
+    FILE * result = fopencookie (stream, "rb", functions);
+#else
+    FILE * result = funopen (stream, _CompressedInputRead, nil, _CompressedInputSeek, _CompressedInputClose);
+#endif
+
+    if (!result) {
+      delete stream;
+      return nil;
+    }
+    setvbuf (result, nil, _IOFBF, kCompressedInputStdioBuffer);
+    return result;
+#else
+    return nil;
+#endif
+  }
+}
@@ -38,6 +38,18 @@
  */
 
 #include <ctype.h>
+#include <string.h>
+#include <mutex>
+#include <utility>
+
+#if defined __UNIX__ && !defined __MINGW32__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
 
 #include "dataset.h"
 #include "translation_table.h"
@@ -45,6 +57,10 @@
 #include "site.h"
 #include "global_object_lists.h"
 
+#ifdef _OPENMP
+#include "omp.h"
+#endif
+
 using namespace hyphy_global_objects;
 
 
@@ -93,9 +109,11 @@ _DataSet::~_DataSet(void) {
 
 void _DataSet::Clear(bool) {
   _List::Clear();
+  patternClassCache.Clear();
   theMap.Clear();
   theFrequencies.Clear();
   theNames.Clear();
+  treeString = kEmptyString;
   if (theTT != &hy_default_translation_table) {
     DeleteObject(theTT);
     theTT = &hy_default_translation_table;
@@ -119,6 +137,7 @@ BaseRef _DataSet::makeDynamic(void) const {
     r->theTT->AddAReference();
   }
   r->theNames.Duplicate(&theNames);
+  r->treeString = treeString;
   r->streamThrough = streamThrough;
   // 20170507: SLKP TODO why do we need an additional reference here?
   // nInstances++;
@@ -406,8 +425,81 @@ void _DataSet::SetTranslationTable(_TranslationTable *newTT) {
   }
   theTT = (_TranslationTable *)newTT->makeDynamic();
 }
+//_______________________________________________________________________
+/*
+    Unique alignment columns are found by hashing every column first (this is
+    done in parallel over blocks of columns when OpenMP is available), and then
+    probing an open addressing table of column indices; column contents are
+    only compared when the hashes agree.
+*/
+
+static const unsigned long kDataSetHashSeed  = 0xcbf29ce484222325UL,
+                           kDataSetHashPrime = 0x100000001b3UL;
+
+static const long          kDataSetHashColumnBlock = 4096L,
+                           kDataSetHarvestBlock    = 1L << 16,
+                           kDataSetPatternClassCacheSize = 8L;
+
+//_______________________________________________________________________
+
+static inline unsigned long _DataSetMixHash (unsigned long h) {
+  // final avalanche, so that the low bits used to index the table are well mixed
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdUL;
+  h ^= h >> 33;
+  return h;
+}
+
+//_______________________________________________________________________
+
+static long _DataSetHashTableSize (long items) {
+  long size = 16L;
+  while (size < (items << 1)) {
+    size <<= 1;
+  }
+  return size;
+}
+
+//_______________________________________________________________________
+
+template <typename EQUAL>
+static void _DataSetFindUniqueColumns (unsigned long const * hashes, long count,
+                                       _SimpleList &representative,
+                                       EQUAL &&same_column) {
+  /*
+   for each column 'i' in [0,count), set representative[i] to the smallest
+   index of a column identical to it (which may be 'i' itself)
+   */
+
+  long const table_size = _DataSetHashTableSize(count), mask = table_size - 1L;
+
+  _SimpleList table(table_size, -1L, 0L);
+  representative.Clear();
+  representative.RequestSpace(count);
+
+  for (long column = 0L; column < count; column++) {
+    unsigned long const h = hashes[column];
+    long slot = h & mask, found = column;
+
+    while (table.list_data[slot] >= 0L) {
+      long const candidate = table.list_data[slot];
+      if (hashes[candidate] == h && same_column(candidate, column)) {
+        found = candidate;
+        break;
+      }
+      slot = (slot + 1L) & mask;
+    }
+
+    if (found == column) {
+      table.list_data[slot] = column;
+    }
+    representative << found;
+  }
+}
+
 //_______________________________________________________________________
 void _DataSet::Finalize(void) {
+  patternClassCache.Clear();
   if (streamThrough) {
     fclose(streamThrough);
     streamThrough = nil;
@@ -428,34 +520,80 @@ void _DataSet::Finalize(void) {
         return;
       }
 
-      _List dups;
       _List uniquePats;
-      _AVLListX dupsAVL(&dups);
 
-      long siteCounter = ((_String *)list_data[0])->length();
+      long const siteCounter = ((_String *)list_data[0])->length(),
+                 seqCounter  = lLength;
 
-      for (long i1 = 0L; i1 < siteCounter; i1++) {
-        _Site *tC = new _Site();
+      unsigned long *column_hashes = new unsigned long[siteCounter];
+      char const ** rows = new char const *[seqCounter];
+
+      for (long i2 = 0L; i2 < seqCounter; i2++) {
+        rows[i2] = ((_String *)list_data[i2])->get_str();
+      }
+
+      // hash blocks of columns row by row, to keep the memory access sequential
+
+      long const block_count = (siteCounter + kDataSetHashColumnBlock - 1L) / kDataSetHashColumnBlock;
+
+#ifdef _OPENMP
+      long const nt = MIN(omp_get_max_threads(), block_count);
+#pragma omp parallel for default(shared) schedule(static) if (nt > 1) num_threads(nt)
+#endif
+      for (long block = 0L; block < block_count; block++) {
+        long const from = block * kDataSetHashColumnBlock,
+                   upto = MIN(from + kDataSetHashColumnBlock, siteCounter);
 
-        for (long i2 = 0L; i2 < lLength; i2++) {
-          (*tC) << ((_String *)list_data[i2])->get_char(i1);
+        for (long i1 = from; i1 < upto; i1++) {
+          column_hashes[i1] = kDataSetHashSeed;
         }
+        for (long i2 = 0L; i2 < seqCounter; i2++) {
+          unsigned char const *row = (unsigned char const *)rows[i2];
+          for (long i1 = from; i1 < upto; i1++) {
+            column_hashes[i1] = (column_hashes[i1] ^ row[i1]) * kDataSetHashPrime;
+          }
+        }
+        for (long i1 = from; i1 < upto; i1++) {
+          column_hashes[i1] = _DataSetMixHash(column_hashes[i1]);
+        }
+      }
+
+      _SimpleList representative;
+
+      _DataSetFindUniqueColumns(column_hashes, siteCounter, representative,
+                                [rows, seqCounter](long c1, long c2) -> bool {
+        for (long i2 = 0L; i2 < seqCounter; i2++) {
+          if (rows[i2][c1] != rows[i2][c2]) {
+            return false;
+          }
+        }
+        return true;
+      });
+
+      delete[] column_hashes;
 
-        long ff = dupsAVL.Find(tC);
-        if (ff < 0) {
-          uniquePats << tC;
-          dupsAVL.Insert(tC, theFrequencies.lLength);
+      _SimpleList pattern_index((unsigned long)siteCounter);
+
+      for (long i1 = 0L; i1 < siteCounter; i1++) {
+        long const rep = representative.list_data[i1];
+        if (rep == i1) {
+          _Site *tC = new _Site();
+          for (long i2 = 0L; i2 < seqCounter; i2++) {
+            (*tC) << rows[i2][i1];
+          }
+          uniquePats < tC;
+          pattern_index << theFrequencies.lLength;
           theMap << theFrequencies.lLength;
           theFrequencies << 1;
         } else {
-          ff = dupsAVL.GetXtra(ff);
+          long const ff = pattern_index.list_data[rep];
+          pattern_index << ff;
           theMap << ff;
           theFrequencies.list_data[ff]++;
         }
-
-        DeleteObject(tC);
       }
-      dupsAVL.Clear(false);
+
+      delete[] rows;
       _List::Clear();
       _List::Duplicate(&uniquePats);
     } else {
@@ -463,22 +601,40 @@ void _DataSet::Finalize(void) {
 
       _Site *tC;
       {
-        _List dups;
-        _AVLListX dupsAVL(&dups);
-
-        for (long i1 = 0; i1 < lLength; i1++) {
-          tC = (_Site *)list_data[i1];
-          long ff = dupsAVL.Find(tC);
-          if (ff < 0) {
-            dupsAVL.Insert(tC, i1);
-          } else {
-            ff = dupsAVL.GetXtra(ff);
+        long const site_count = lLength;
+        unsigned long *site_hashes = new unsigned long[site_count];
+
+#ifdef _OPENMP
+        long const nt = MIN(omp_get_max_threads(), site_count / kDataSetHashColumnBlock + 1L);
+#pragma omp parallel for default(shared) schedule(static) if (nt > 1) num_threads(nt)
+#endif
+        for (long i1 = 0L; i1 < site_count; i1++) {
+          _Site const *site = (_Site const *)list_data[i1];
+          unsigned char const *chars = (unsigned char const *)site->get_str();
+          unsigned long h = kDataSetHashSeed;
+          for (long i2 = 0L; i2 < site->length(); i2++) {
+            h = (h ^ chars[i2]) * kDataSetHashPrime;
+          }
+          site_hashes[i1] = _DataSetMixHash(h ^ site->length());
+        }
+
+        _SimpleList representative;
+        _DataSetFindUniqueColumns(site_hashes, site_count, representative,
+                                  [this](long c1, long c2) -> bool {
+          return ((_Site *)list_data[c1])->Equal(*(_Site *)list_data[c2]);
+        });
+
+        delete[] site_hashes;
+
+        for (long i1 = 0; i1 < site_count; i1++) {
+          long const ff = representative.list_data[i1];
+          if (ff != i1) {
+            tC = (_Site *)list_data[i1];
             tC->Clear();
             tC->SetRefNo(ff);
             theFrequencies.list_data[ff]++;
           }
         }
-        dupsAVL.Clear(false);
       }
 
       _SimpleList refs(lLength), toDelete(lLength);
@@ -756,6 +912,78 @@ _TranslationTable *_DataSet::CheckCompatibility(_SimpleList const &ref,
   return theEnd;
 }
 
+//_______________________________________________________________________
+
+// filters may be built concurrently (e.g. from OpenMP regions); this guards the class caches of all data sets
+static std::mutex _DataSetPatternClassCacheLock;
+
+_SimpleList _DataSet::PatternClasses (_SimpleList const & species) const {
+    
+    _SimpleList * key = new _SimpleList (species);
+    key->Sort();
+    
+    {
+        std::lock_guard <std::mutex> guard (_DataSetPatternClassCacheLock);
+        for (long entry = patternClassCache.lLength - 2L; entry >= 0L; entry -= 2L) {
+            if (key->Equal (*(_SimpleList*)patternClassCache.GetItem (entry))) {
+                DeleteObject (key);
+                if (entry + 2L < patternClassCache.lLength) {
+                    // move to the end (most recently used)
+                    patternClassCache << patternClassCache.GetItem (entry);
+                    patternClassCache << patternClassCache.GetItem (entry + 1L);
+                    patternClassCache.Delete (entry + 1L);
+                    patternClassCache.Delete (entry);
+                }
+                // a copy: another thread may evict the cached list while the caller uses it
+                return *(_SimpleList*)patternClassCache.GetItem (patternClassCache.lLength - 1L);
+            }
+        }
+    }
+    
+    long   const   pattern_count = lLength,
+                   species_count = key->lLength;
+    long   const * species_list  = key->list_data;
+    unsigned long* pattern_hashes = new unsigned long [pattern_count];
+    
+#ifdef _OPENMP
+    long const nt = MIN(omp_get_max_threads(), pattern_count / kDataSetHashColumnBlock + 1L);
+#pragma omp parallel for default(shared) schedule(static) if (nt > 1) num_threads(nt)
+#endif
+    for (long pattern = 0L; pattern < pattern_count; pattern++) {
+        unsigned char const * chars = (unsigned char const *)((_Site const *)list_data[pattern])->get_str();
+        unsigned long h = kDataSetHashSeed;
+        for (long s = 0L; s < species_count; s++) {
+            h = (h ^ chars[species_list[s]]) * kDataSetHashPrime;
+        }
+        pattern_hashes[pattern] = _DataSetMixHash (h);
+    }
+    
+    _SimpleList * classes = new _SimpleList;
+    _DataSetFindUniqueColumns (pattern_hashes, pattern_count, *classes,
+                               [this, species_list, species_count] (long p1, long p2) -> bool {
+        char const * chars1 = ((_Site const *)list_data[p1])->get_str(),
+                   * chars2 = ((_Site const *)list_data[p2])->get_str();
+        for (long s = 0L; s < species_count; s++) {
+            if (chars1[species_list[s]] != chars2[species_list[s]]) {
+                return false;
+            }
+        }
+        return true;
+    });
+    delete [] pattern_hashes;
+    
+    _SimpleList result (*classes);
+    
+    std::lock_guard <std::mutex> guard (_DataSetPatternClassCacheLock);
+    if (patternClassCache.lLength >= 2L * kDataSetPatternClassCacheSize) {
+        patternClassCache.Delete (1L);
+        patternClassCache.Delete (0L);
+    }
+    patternClassCache < key;
+    patternClassCache < classes;
+    return result;
+}
+
 //_________________________________________________________
 
 _Matrix * _DataSet::HarvestFrequencies (unsigned char unit, unsigned char atom, bool posSpec, _SimpleList& hSegmentation, _SimpleList& vSegmentation, bool countGaps) const {
@@ -780,48 +1008,159 @@ _Matrix * _DataSet::HarvestFrequencies (unsigned char unit, unsigned char atom,
                                     false,
                                     true);
     
-    long     positions  =   unit/atom,
-    static_store [HYPHY_SITE_DEFAULT_BUFFER_SIZE];
+    /*
+       Atoms which read the same data set patterns (at the same position in the unit,
+       if counts are position-specific) contribute the same counts, so each distinct
+       atom is counted once and weighted by the number of its occurrences. Character
+       resolutions are tabulated once, and distinct atoms are split between threads,
+       each accumulating its own counts.
+    */
+    
+    long     const positions    = unit/atom,
+                   alphabet     = theTT->LengthOfAlphabet(),
+                   out_size     = out->GetHDim() * out->GetVDim(),
+                   key_stride   = atom + 1L,
+                   atom_count   = (vSegmentation.lLength / unit) * positions,
+                   stride       = alphabet + 1L;
+    
+    _SimpleList    atom_keys ((unsigned long)(atom_count * key_stride));
+    unsigned long* atom_hashes = new unsigned long [atom_count];
+    
+    for (unsigned long site_pattern = 0UL, atom_index = 0UL; site_pattern + unit <= vSegmentation.lLength;  site_pattern +=unit) { // loop over the set of segments
+        for (long index_in_pattern = 0L; index_in_pattern < positions; index_in_pattern++, atom_index++) {
+            long          const position = posSpec ? index_in_pattern : 0L;
+            unsigned long       h        = (kDataSetHashSeed ^ position) * kDataSetHashPrime;
+            atom_keys << position;
+            for (unsigned long m = 0UL; m<atom; m++ ) {
+                long const pattern = theMap.list_data[vSegmentation.list_data[site_pattern + index_in_pattern*atom + m]];
+                atom_keys << pattern;
+                h = (h ^ pattern) * kDataSetHashPrime;
+            }
+            atom_hashes[atom_index] = _DataSetMixHash (h);
+        }
+    }
+    
+    _SimpleList   representative,
+                  unique_atoms,
+                  atom_weights,
+                  unique_index (atom_count, 0L, 0L);
+    
+    _DataSetFindUniqueColumns(atom_hashes, atom_count, representative,
+                              [&] (long a1, long a2) -> bool {
+                                  long const * k1 = atom_keys.list_data + a1 * key_stride,
+                                             * k2 = atom_keys.list_data + a2 * key_stride;
+                                  for (long k = 0L; k < key_stride; k++) {
+                                      if (k1[k] != k2[k]) {
+                                          return false;
+                                      }
+                                  }
+                                  return true;
+                              });
+    delete [] atom_hashes;
+    
+    for (long atom_index = 0L; atom_index < atom_count; atom_index++) {
+        long const first = representative.list_data[atom_index];
+        if (first == atom_index) {
+            unique_index.list_data[atom_index] = unique_atoms.lLength;
+            unique_atoms << atom_index;
+            atom_weights << 1L;
+        } else {
+            atom_weights.list_data[unique_index.list_data[first]] ++;
+        }
+    }
+    
+    // resolutions of individual characters: [count, resolution 1, ..., resolution count]
+    // multi-character atoms resolve to all combinations of character resolutions (see MultiTokenResolutions)
     
-    _String unit_for_counting ((unsigned long)atom);
+    long * character_resolutions = new long [256L * stride];
+    for (long c = 0L; c < 256L; c++) {
+        long * resolutions = character_resolutions + c * stride;
+        resolutions[0] = theTT->TokenResolutions ((char)c, resolutions + 1, countGaps);
+        if (atom > 1 && countGaps && resolutions[0] == 0L) {
+            resolutions[0] = alphabet;
+            for (long k = 0L; k < alphabet; k++) {
+                resolutions[k+1] = k;
+            }
+        }
+        if (resolutions[0] < 0L) {
+            resolutions[0] = 0L;
+        }
+    }
+    
+    long const unique_count = unique_atoms.lLength;
     
-    for (unsigned long site_pattern = 0UL; site_pattern + unit <= vSegmentation.lLength;  site_pattern +=unit) { // loop over the set of segments
-        // make sure the partition is kosher
+#ifdef _OPENMP
+    long const nt = MIN(omp_get_max_threads(), unique_count * hSegmentation.lLength / kDataSetHarvestBlock + 1L);
+#else
+    long const nt = 1L;
+#endif
+    
+    hyFloat * thread_counts = new hyFloat [nt * out_size];
+    InitializeArray (thread_counts, nt * out_size, 0.);
+    
+#ifdef _OPENMP
+#pragma omp parallel for default(shared) schedule(dynamic, 64) if (nt > 1) num_threads(nt)
+#endif
+    for (long u = 0L; u < unique_count; u++) {
+#ifdef _OPENMP
+        hyFloat     * counts = thread_counts + omp_get_thread_num() * out_size;
+#else
+        hyFloat     * counts = thread_counts;
+#endif
+        long  const * key    = atom_keys.list_data + unique_atoms.list_data[u] * key_stride;
+        hyFloat const weight = atom_weights.list_data[u];
         
-        /*
-         if (site_pattern + unit > vSegmentation.lLength) {
-            break;
+        long          digits  [HYPHY_SITE_DEFAULT_BUFFER_SIZE];
+        long  const * resolutions [HYPHY_SITE_DEFAULT_BUFFER_SIZE];
+        const char  * columns [HYPHY_SITE_DEFAULT_BUFFER_SIZE];
+        
+        for (unsigned long m = 0UL; m<atom; m++ ) {
+            columns[m] = ((_Site const *)list_data[key[m+1]])->get_str();
         }
-        */
         
-        for (unsigned long primary_site = site_pattern; primary_site < site_pattern+unit; primary_site += atom) {
+        for (unsigned long sequence_index = 0; sequence_index <hSegmentation.lLength; sequence_index ++) {
+            // loop down each column
+            unsigned long mapped_sequence_index = hSegmentation.list_data[sequence_index];
             
-            long   index_in_pattern = (primary_site-site_pattern)/atom;
+            long resolution_count = 1L;
+            for (unsigned long m = 0UL; m<atom; m++ ) {
+                resolutions[m]    = character_resolutions + (unsigned char)columns[m][mapped_sequence_index] * stride;
+                resolution_count *= resolutions[m][0];
+                digits[m]         = 0L;
+            }
             
-            for (unsigned long sequence_index = 0; sequence_index <hSegmentation.lLength; sequence_index ++) {
-                // loop down each column
+            if (resolution_count > 0L) {
+                hyFloat const normalized = weight / resolution_count;
                 
-                unsigned long mapped_sequence_index = hSegmentation.list_data[sequence_index];
-                // build atomic probabilities
-                
-                for (unsigned long m = 0UL; m<atom; m++ ) {
-                    unit_for_counting.set_char (m, (*this)(vSegmentation.list_data[primary_site+m],mapped_sequence_index,atom));
-                }
-                
-                long resolution_count = theTT->MultiTokenResolutions(unit_for_counting, static_store, countGaps);
-                
-                if (resolution_count > 0UL) {
-                    
-                    hyFloat    normalized = 1./resolution_count;
+                for (long resolution_index = 0L; resolution_index < resolution_count; resolution_index ++) {
+                    // the next combination of character resolutions; the last character varies fastest
+                    long code = 0L;
+                    for (unsigned long m = 0UL; m<atom; m++ ) {
+                        code = code * alphabet + resolutions[m][digits[m]+1];
+                    }
+                    counts[posSpec? code*positions+key[0]: code] += normalized;
                     
-                    for (long resolution_index = 0UL; resolution_index < resolution_count; resolution_index ++) {
-                        out->theData[posSpec? static_store[resolution_index]*positions+index_in_pattern: static_store[resolution_index]] += normalized;
+                    for (long m = atom - 1L; m >= 0L; m--) {
+                        if (++digits[m] < resolutions[m][0]) {
+                            break;
+                        }
+                        digits[m] = 0L;
                     }
                 }
             }
         }
     }
     
+    for (long t = 0L; t < nt; t++) {
+        hyFloat const * counts = thread_counts + t * out_size;
+        for (long k = 0L; k < out_size; k++) {
+            out->theData[k] += counts[k];
+        }
+    }
+    
+    delete [] thread_counts;
+    delete [] character_resolutions;
+    
     //scale the matrix now
     
     unsigned long row_count    = out->GetHDim(),
@@ -1660,7 +1999,7 @@ void    FilterRawString (_String& s, FileState* fs, _DataSet & ds) {
 
 //_________________________________________________________________________________________________
 
-void    ProcessTree (FileState *fState, FILE* f, _String& CurrentLine) {
+void    ProcessTree (FileState *fState, FILE* f, _String& CurrentLine, _DataSet& result) {
     
     // TODO SLKP 20180921 this does extra work to read in the tree string multiple times;
     // the solution is to have a proper buffer wrapper, and to
@@ -1714,6 +2053,7 @@ void    ProcessTree (FileState *fState, FILE* f, _String& CurrentLine) {
         *tree_string << CurrentLine.Cut (start_index, end_index);
         tree_string->TrimSpace();
         CurrentLine.Trim (end_index + 1, kStringEnd);
+        result.SetTreeString (*tree_string);
         hy_env::EnvVariableSetNamespace(hy_env::data_file_tree, new HY_CONSTANT_TRUE, fState->theNamespace, false);
         hy_env::EnvVariableSetNamespace(hy_env::data_file_tree_string, new _FString (tree_string), nil, false);
     }
@@ -1878,11 +2218,18 @@ void ReadNextLine (FILE* fp, _String *s, FileState* fs, bool, bool upCase) {
                 
                 lastc = getc_unlocked(fp);
             }
-        else
-            while (lastc && lastc!=10 && lastc!=13 ) {
-                tempBuffer << lastc;
-                lastc = fs->theSource->char_at(fs->pInSrc++);
+        else if (lastc) {
+            // find the end of the line (\n, \r or the terminating \0) in in-memory sources
+            // with a single scan, and copy the whole line at once
+            unsigned long const line_start  = fs->pInSrc - 1UL,
+                                line_length = strcspn (fs->theSource->get_str() + line_start, "\n\r");
+            
+            if (line_length) {
+                tempBuffer.AppendSubstring (*fs->theSource, line_start, line_start + line_length - 1UL);
             }
+            // like reading character by character, step over the terminator (or one past the end of the source)
+            fs->pInSrc = line_start + line_length + 1UL;
+        }
         
     } else {
         if (upCase) {
@@ -1935,7 +2282,7 @@ void ReadNextLine (FILE* fp, _String *s, FileState* fs, bool, bool upCase) {
             return;
         }
     }
-    *s = tempBuffer;
+    *s = std::move (tempBuffer);
     
     if (SkipLine (*s, fs)) {
         ReadNextLine(fp,s,fs,false,upCase);
@@ -1964,13 +2311,99 @@ void    TrimPhylipLine (_String& CurrentLine, _DataSet& ds) {
 
 
 //_________________________________________________________
-_DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName, _String* namespaceID, _TranslationTable* dT, _ExecutionList* ex) {
+static void _ExecuteNexusHBLBlock (_DataSet * result, char execBF, _String* bfName, _String* namespaceID, _ExecutionList* ex) {
+    // run (or discard) the HYPHY block of a NEXUS file which has just been read into 'result'
+    if (nexusBFBody.nonempty()) {
+        if (execBF == 1) {
+            lastNexusDataMatrix = result;
+            
+            long            bfl = GetBFFunctionCount ();
+            
+            _ExecutionList * nexusBF = ex ? ex :  new _ExecutionList;
+            if (namespaceID) {
+                nexusBF->SetNameSpace(*namespaceID);
+            }
+            nexusBF->BuildList(nexusBFBody, nil, false, true);
+            //_ExecutionList nexusBF (nexusBFBody,namespaceID);
+            if (bfName) {
+                nexusBF->sourceFile = *bfName;
+            }
+
+            nexusBF->ExecuteAndClean(bfl);
+
+            if (nexusBF != ex) {
+                DeleteObject (nexusBF);
+            } else {
+                ex->ClearExecutionList();
+                ex->Clear();
+            }
+            nexusBFBody         = kEmptyString;
+        } else if (execBF == 0) {
+            nexusBFBody         = kEmptyString;
+        }
+    }
+}
+
+//_________________________________________________________
+class _MappedFileSource : public _String {
+    /* the contents of a regular file mapped into memory (copy on write), so that the sequence
+       file readers can scan it like a string source, a line at a time; like the buffer of any
+       _String, the mapping is followed by a terminating \0. Empty if the file could not be mapped
+       (e.g. a pipe or a decompressing stream), in which case it is read through stdio. */
+    
+public:
+    _MappedFileSource (FILE * file) : mapped_length (0UL) {
+#if defined __UNIX__ && !defined __MINGW32__
+        struct stat file_status;
+        int const   descriptor = file ? fileno (file) : -1;
+        
+        if (descriptor >= 0 && fstat (descriptor, &file_status) == 0 && S_ISREG (file_status.st_mode) && file_status.st_size > 0) {
+            unsigned long const page_size = sysconf (_SC_PAGESIZE),
+                                file_size = file_status.st_size;
+            
+            // reserve at least one zero filled byte past the end of the file, then map the file over the start
+            unsigned long const reserved = (file_size / page_size + 1UL) * page_size;
+            void * region = mmap (nil, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (region != MAP_FAILED) {
+                if (mmap (region, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, descriptor, 0) != MAP_FAILED) {
+                    madvise (region, file_size, MADV_SEQUENTIAL);
+                    s_data        = (char*)region;
+                    s_length      = file_size;
+                    mapped_length = reserved;
+                } else {
+                    munmap (region, reserved);
+                }
+            }
+        }
+#endif
+    }
+    
+    virtual ~_MappedFileSource (void) {
+#if defined __UNIX__ && !defined __MINGW32__
+        if (mapped_length) {
+            munmap (s_data, mapped_length);
+        }
+#endif
+        // keep ~_String from freeing the mapping
+        s_data   = nil;
+        s_length = 0UL;
+    }
+    
+private:
+    unsigned long mapped_length;
+};
+
+//_________________________________________________________
+
+_DataSet* ReadDataSetFile (FILE*file, char execBF, _String* theS, _String* bfName, _String* namespaceID, _TranslationTable* dT, _ExecutionList* ex) {
     
     static const _String kNEXUS ("#NEXUS"),
                          kDefSeqNamePrefix ("Species");
     
     bool     doAlphaConsistencyCheck = true;
     _DataSet* result = new _DataSet;
+    _SharedDataSetClaim shared_claim;
+    FILE*     f = file; // set to nil if the file is read from memory
     
     try {
     
@@ -2022,23 +2455,38 @@ _DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName,
         }
         // done initializing
         
-        long     fileLength = 0;
+        // the file length used to be computed here (but not used);
+        // seeking to the end is expensive for compressed input streams
         
     #ifdef __HYPHYMPI__
         if (hy_mpi_node_rank == 0L) {
     #endif
             if       (f) {
-                fseek    (f,0,SEEK_END);
-                fileLength = ftell(f);
                 rewind  (f);
-            } else {
-                fileLength = theS->length();
             }
             
     #ifdef __HYPHYMPI__
         }
     #endif
         
+        if (f && ReadBinaryDataSet (f, *result, namespaceID, dT)) {
+            funlockfile (f);
+            return result;
+        }
+        
+        if (!f && shared_claim.Attach (*theS, namespaceID, dT, *result)) {
+            // another MPI rank on this host has already read the same data
+            _ExecuteNexusHBLBlock (result, execBF, bfName, namespaceID, ex);
+            return result;
+        }
+        
+        // regular files are mapped into memory, and read like string sources, a line at a time
+        _MappedFileSource mapped_file (f);
+        if (mapped_file.nonempty()) {
+            fState.theSource = &mapped_file;
+            f = nil;
+        }
+        
         _String     CurrentLine;
         
         //if (f==NULL) return (_DataSet*)result.makeDynamic();
@@ -2123,7 +2571,7 @@ _DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName,
                                         ReadNextLine (f,&CurrentLine,&fState);
                                         if (CurrentLine.nonempty()) {
                                             if (CurrentLine.FirstNonSpace()=='(') { // could be a tree string
-                                                ProcessTree (&fState,f, CurrentLine);
+                                                ProcessTree (&fState,f, CurrentLine, *result);
                                             }
                                         }
                                         break;
@@ -2180,7 +2628,7 @@ _DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName,
                                             ReadNextLine (f,&CurrentLine,&fState);
                                             if (CurrentLine.nonempty()) {
                                                 if (CurrentLine.FirstNonSpace()=='(') { // could be a tree string
-                                                    ProcessTree (&fState,f, CurrentLine);
+                                                    ProcessTree (&fState,f, CurrentLine, *result);
                                                 }
                                             }
                                             break;
@@ -2231,7 +2679,7 @@ _DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName,
                         }
                         // check to see if the string defines a tree
                         if (c=='(') {
-                            ProcessTree (&fState,f, CurrentLine);
+                            ProcessTree (&fState,f, CurrentLine, *result);
                             ReadNextLine (f,&CurrentLine,&fState);
                         }
                         
@@ -2287,8 +2735,8 @@ _DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName,
             {
                 _TranslationTable *trialTable = new _TranslationTable (hy_default_translation_table);
                 trialTable->baseLength = 2;
-                if (f) funlockfile (f);
-                _DataSet * res2 = ReadDataSetFile (f, execBF, theS, bfName, namespaceID, trialTable);
+                if (file) funlockfile (file);
+                _DataSet * res2 = ReadDataSetFile (file, execBF, theS, bfName, namespaceID, trialTable);
                 if (res2->GetNoTypes()) {
                     DeleteObject (result);
                     return res2;
@@ -2313,42 +2761,15 @@ _DataSet* ReadDataSetFile (FILE*f, char execBF, _String* theS, _String* bfName,
                 }
             
         }
-        if (nexusBFBody.nonempty()) {
-            if (execBF == 1) {
-                lastNexusDataMatrix = result;
-                
-                long            bfl = GetBFFunctionCount ();
-                
-                _ExecutionList * nexusBF = ex ? ex :  new _ExecutionList;
-                if (namespaceID) {
-                    nexusBF->SetNameSpace(*namespaceID);
-                }
-                nexusBF->BuildList(nexusBFBody, nil, false, true);
-                //_ExecutionList nexusBF (nexusBFBody,namespaceID);
-                if (bfName) {
-                    nexusBF->sourceFile = *bfName;
-                }
-
-                nexusBF->ExecuteAndClean(bfl);
-
-                if (nexusBF != ex) {
-                    DeleteObject (nexusBF);
-                } else {
-                    ex->ClearExecutionList();
-                    ex->Clear();
-                }
-                nexusBFBody         = kEmptyString;
-            } else if (execBF == 0) {
-                nexusBFBody         = kEmptyString;
-            }
-        }
+        shared_claim.Publish (*result);
+        _ExecuteNexusHBLBlock (result, execBF, bfName, namespaceID, ex);
     } catch (const _String& err) {
         DeleteObject (result);
-        if (f) funlockfile (f);
+        if (file) funlockfile (file);
         HandleApplicationError(err);
         result = nil;
     }
-    if (f) funlockfile (f);
+    if (file) funlockfile (file);
     return result;
 }
 
@@ -0,0 +1,310 @@
+/*
+
+HyPhy - Hypothesis Testing Using Phylogenies.
+
+Copyright (C) 1997-now
+Core Developers:
+   Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+   Art FY Poon    (apoon42@uwo.ca)
+   Steven Weaver (sweaver@temple.edu)
+
+Module Developers:
+        Lance Hepler (nlhepler@gmail.com)
+        Martin Smith (martin.audacis@gmail.com)
+
+Significant contributions from:
+  Spencer V Muse (muse@stat.ncsu.edu)
+  Simon DW Frost (sdf22@cam.ac.uk)
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dataset.h"
+#include "dataset_filter.h"
+#include "avllistx.h"
+#include "batchlan.h"
+#include "hbl_env.h"
+#include "global_things.h"
+
+using namespace hy_global;
+
+/*
+   A binary container for data sets, which stores the data already reduced to
+   unique site patterns, so that it can be loaded without parsing or pattern
+   compression. All integers are 64-bit, in the byte order of the machine that
+   wrote the file (readers check the byte order mark). Layout (version 1):
+
+     magic (8 bytes: HYPHYBDS), version (uint32), byte order mark (uint32)
+     species, sites, unique patterns
+     translation table: base length, base set, added tokens, added translations
+     species names
+     tree string (empty if none)
+     site -> pattern map (sites values)
+     pattern frequencies (unique patterns values)
+     pattern characters (species bytes per pattern, in the pattern order)
+
+   Strings are stored as a length followed by the characters.
+*/
+
+static const char     kBinaryDataSetMagic [8]  = {'H','Y','P','H','Y','B','D','S'};
+static const uint32_t kBinaryDataSetVersion    = 1U,
+                      kBinaryDataSetByteOrder  = 0x01020304U;
+
+//_________________________________________________________
+
+static void _BinaryDataSetWriteInteger (FILE * file, int64_t value) {
+  fwrite (&value, sizeof (int64_t), 1, file);
+}
+
+//_________________________________________________________
+
+static void _BinaryDataSetWriteString (FILE * file, _String const& value) {
+  _BinaryDataSetWriteInteger (file, value.length());
+  if (value.nonempty()) {
+    fwrite (value.get_str(), 1, value.length(), file);
+  }
+}
+
+//_________________________________________________________
+
+static int64_t _BinaryDataSetReadInteger (FILE * file) {
+  int64_t value;
+  if (fread (&value, sizeof (int64_t), 1, file) != 1) {
+    throw _String ("Unexpected end of file in a binary data set file");
+  }
+  return value;
+}
+
+//_________________________________________________________
+
+static int64_t _BinaryDataSetReadCount (FILE * file, int64_t upper_bound) {
+  int64_t value = _BinaryDataSetReadInteger (file);
+  if (value < 0 || value > upper_bound) {
+    throw _String ("Invalid count or index (") & _String ((long)value) & ") in a binary data set file";
+  }
+  return value;
+}
+
+//_________________________________________________________
+
+static void _BinaryDataSetCheckRemaining (FILE * file, int64_t file_end, int64_t required) {
+  // make sure that the file has at least 'required' more bytes before allocating space for them
+  if (required > file_end - (int64_t)ftell (file)) {
+    throw _String ("Unexpected end of file in a binary data set file");
+  }
+}
+
+//_________________________________________________________
+
+static const _String _BinaryDataSetReadString (FILE * file, int64_t file_end) {
+  long const length = _BinaryDataSetReadCount (file, 0x7FFFFFFFL);
+  _BinaryDataSetCheckRemaining (file, file_end, length);
+  _String value (file, length);
+  if (value.length() != length) {
+    throw _String ("Unexpected end of file in a binary data set file");
+  }
+  return value;
+}
+
+//_________________________________________________________
+
+void _DataSetFilter::WriteBinary (FILE * file) const {
+
+  unsigned long const species_count = NumberSpecies(),
+                      site_count    = GetSiteCount();
+
+  // restricting data set patterns to a subset of species may make some of them
+  // identical; find the unique columns (in the order of first occurrence)
+
+  _List           column_keys,
+                  unique_columns;
+  _AVLListX       column_index (&column_keys);
+  _SimpleList     site_to_pattern ((unsigned long)site_count),
+                  pattern_counts,
+                  data_set_pattern_map ((unsigned long)theData->lLength);
+
+  data_set_pattern_map.Populate (theData->lLength, -1L, 0L);
+
+  for (unsigned long site = 0UL; site < site_count; site++) {
+    long const data_set_pattern = theData->theMap.get (theOriginalOrder.get (site));
+    long       pattern          = data_set_pattern_map.get (data_set_pattern);
+
+    if (pattern < 0L) {
+      _Site const * source = (_Site const *) theData->GetItem (data_set_pattern);
+      _String     * column = new _String ((unsigned long)species_count);
+      for (unsigned long species = 0UL; species < species_count; species++) {
+        column->set_char (species, source->char_at (theNodeMap.get (species)));
+      }
+      pattern = column_index.FindAndGetXtra (column);
+      if (pattern == kNotFound) {
+        pattern = unique_columns.lLength;
+        unique_columns << column;
+        pattern_counts << 0L;
+        column_index.Insert (column, pattern, false);
+      } else {
+        DeleteObject (column);
+      }
+      data_set_pattern_map[data_set_pattern] = pattern;
+    }
+
+    site_to_pattern << pattern;
+    pattern_counts.list_data[pattern] ++;
+  }
+
+  fwrite (kBinaryDataSetMagic, 1, sizeof (kBinaryDataSetMagic), file);
+  fwrite (&kBinaryDataSetVersion, sizeof (uint32_t), 1, file);
+  fwrite (&kBinaryDataSetByteOrder, sizeof (uint32_t), 1, file);
+
+  _BinaryDataSetWriteInteger (file, species_count);
+  _BinaryDataSetWriteInteger (file, site_count);
+  _BinaryDataSetWriteInteger (file, unique_columns.lLength);
+
+  _TranslationTable const * table = theData->theTT;
+  _BinaryDataSetWriteInteger (file, table->baseLength);
+  _BinaryDataSetWriteString  (file, table->baseSet);
+  _BinaryDataSetWriteString  (file, table->tokensAdded);
+  _BinaryDataSetWriteInteger (file, table->translationsAdded.lLength);
+  table->translationsAdded.Each ([file] (long value, unsigned long) -> void {
+    _BinaryDataSetWriteInteger (file, value);
+  });
+
+  for (unsigned long species = 0UL; species < species_count; species++) {
+    _BinaryDataSetWriteString (file, *GetSequenceName (species));
+  }
+
+  _BinaryDataSetWriteString (file, theData->GetTreeString());
+
+  site_to_pattern.Each ([file] (long value, unsigned long) -> void {
+    _BinaryDataSetWriteInteger (file, value);
+  });
+  pattern_counts.Each ([file] (long value, unsigned long) -> void {
+    _BinaryDataSetWriteInteger (file, value);
+  });
+  unique_columns.ForEach ([file, species_count] (BaseRef column, unsigned long) -> void {
+    fwrite (((_String*)column)->get_str(), 1, species_count, file);
+  });
+}
+
+//_________________________________________________________
+
+bool ReadBinaryDataSet (FILE * file, _DataSet & result, _String * namespace_id, _TranslationTable const * table_in_use) {
+
+  char     magic [sizeof (kBinaryDataSetMagic)];
+  uint32_t version,
+           byte_order;
+
+  if (fread (magic, 1, sizeof (kBinaryDataSetMagic), file) != sizeof (kBinaryDataSetMagic) || memcmp (magic, kBinaryDataSetMagic, sizeof (kBinaryDataSetMagic))) {
+    rewind (file);
+    return false;
+  }
+
+  if (fread (&version, sizeof (uint32_t), 1, file) != 1 || fread (&byte_order, sizeof (uint32_t), 1, file) != 1) {
+    throw _String ("Unexpected end of file in a binary data set file");
+  }
+  if (byte_order != kBinaryDataSetByteOrder) {
+    throw _String ("The binary data set file was written on a machine with a different byte order");
+  }
+  if (version != kBinaryDataSetVersion) {
+    throw _String ("Unsupported binary data set file version ") & _String ((long)version);
+  }
+
+  long const header_end = ftell (file);
+  fseek (file, 0L, SEEK_END);
+  int64_t const file_end = ftell (file);
+  fseek (file, header_end, SEEK_SET);
+
+  long const species_count = _BinaryDataSetReadCount (file, 0x7FFFFFFFL),
+             site_count    = _BinaryDataSetReadCount (file, 0x7FFFFFFFL),
+             pattern_count = _BinaryDataSetReadCount (file, site_count);
+
+  // species names, the site map, pattern frequencies and pattern characters must all fit in the rest of the file
+  _BinaryDataSetCheckRemaining (file, file_end, (int64_t)species_count * (sizeof (int64_t) + pattern_count) + (int64_t)(site_count + pattern_count) * sizeof (int64_t));
+
+  _TranslationTable * table = new _TranslationTable;
+  try {
+    table->baseLength  = _BinaryDataSetReadCount (file, 255L);
+    table->baseSet     = _BinaryDataSetReadString (file, file_end);
+    table->tokensAdded = _BinaryDataSetReadString (file, file_end);
+    for (long translations = _BinaryDataSetReadCount (file, 0x7FFFFFFFL); translations > 0L; translations--) {
+      table->translationsAdded << _BinaryDataSetReadInteger (file);
+    }
+  } catch (_String const&) {
+    DeleteObject (table);
+    throw;
+  }
+
+  if (table_in_use && table_in_use != &hy_default_translation_table && !(*table_in_use == *table)) {
+    DeleteObject (table);
+    throw _String ("The binary data set file was written with a different translation table than the one requested");
+  }
+
+  if (table->IsStandardNucleotide() && table->tokensAdded.empty() && table->translationsAdded.empty()) {
+    DeleteObject (table);
+    result.theTT = &hy_default_translation_table;
+  } else {
+    result.theTT = table;
+  }
+
+  for (long species = 0L; species < species_count; species++) {
+    result.AddName (_BinaryDataSetReadString (file, file_end));
+  }
+
+  _String const tree_string = _BinaryDataSetReadString (file, file_end);
+  if (tree_string.nonempty()) {
+    result.treeString = tree_string;
+    hy_env::EnvVariableSetNamespace (hy_env::data_file_tree, new HY_CONSTANT_TRUE, namespace_id, false);
+    hy_env::EnvVariableSetNamespace (hy_env::data_file_tree_string, new _FString (tree_string, false), nil, false);
+  }
+
+  result.theMap.RequestSpace (site_count);
+  for (long site = 0L; site < site_count; site++) {
+    result.theMap << _BinaryDataSetReadCount (file, pattern_count - 1L);
+  }
+
+  long total_frequency = 0L;
+  result.theFrequencies.RequestSpace (pattern_count);
+  for (long pattern = 0L; pattern < pattern_count; pattern++) {
+    long const frequency = _BinaryDataSetReadCount (file, site_count);
+    result.theFrequencies << frequency;
+    total_frequency += frequency;
+  }
+  if (total_frequency != site_count) {
+    throw _String ("Pattern frequencies do not add up to the number of sites in a binary data set file");
+  }
+
+  _String const characters (file, species_count * pattern_count);
+  if (characters.length() != species_count * pattern_count) {
+    throw _String ("Unexpected end of file in a binary data set file");
+  }
+
+  result.RequestSpace (pattern_count);
+  for (long pattern = 0L; pattern < pattern_count; pattern++) {
+    _Site * site = new _Site;
+    site->AppendSubstring (characters, pattern * species_count, (pattern + 1L) * species_count - 1L);
+    result < site;
+  }
+
+  result.noOfSpecies = species_count;
+  return true;
+}
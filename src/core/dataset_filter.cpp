@@ -38,12 +38,17 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include <ctype.h>
+#include <stdint.h>
 
 #include "global_object_lists.h"
 #include "avllistxl_iterator.h"
 #include "dataset_filter.h"
 #include "batchlan.h"
 
+#ifdef _OPENMP
+  #include "omp.h"
+#endif
+
 //_________________________________________________________
 // Data Set Filter/Numeric
 //_________________________________________________________
@@ -439,83 +444,89 @@ void    _DataSetFilter::SetFilter (_DataSet const * ds, unsigned char unit, _Sim
     
     // done with security checks
     
-    _SimpleList indices;        // numeric indices intended to facilitate the reindexing
-    _AVLListXL  siteIndices     (&indices);
-    
+    /*
+       sites which map to the same pattern class of the data set (see _DataSet::PatternClasses)
+       are identical in the filtered species, so blocks of sites can be compared by their classes
+       instead of their characters; the classes are cached by the data set, so that filters over
+       the same sequences (e.g. partitions of an alignment) do not need to read the characters
+    */
     
-    // sweep through the columns left to right
+    _SimpleList const & pattern_classes = ds->PatternClasses (theNodeMap);
+    long        const * site_to_pattern = ds->theMap.list_data;
     
     duplicateMap.RequestSpace (verticalList.lLength/unit+1);
     
-    _String      siteHolder   (unit*theNodeMap.lLength);
-    
-    //bool       startD = false;
-    
-    for (i=0; i<verticalList.lLength; i+=unit) {
-        long colIndex = 0;
+    if (unit == 1) {
+        _SimpleList  class_to_filter_pattern (pattern_classes.lLength, -1L, 0L);
         
-        for (j=0; j<unit; j++) // sweep within one block
-            for (long k=0; k<theNodeMap.lLength; k++) // sweep down the columns
-                                                      //colIndex+=
-                                                      //(((_String**)ds->list_data)[ds->theMap.list_data[verticalList.list_data[i+j]]])->sData[theNodeMap.list_data[k]];
-            {
-                siteHolder[colIndex++] = (((_String**)ds->list_data)[ds->theMap.list_data[verticalList.list_data[i+j]]])->char_at(theNodeMap.list_data[k]);
+        for (i=0; i<verticalList.lLength; i++) {
+            long const site_class = pattern_classes.list_data [site_to_pattern[verticalList.list_data[i]]];
+            long       f          = class_to_filter_pattern.list_data[site_class];
+            
+            if (f < 0L) {
+                f = class_to_filter_pattern.list_data[site_class] = theFrequencies.lLength;
+                theFrequencies << 0L;
+                theMap << verticalList.list_data[i];
             }
+            theFrequencies.list_data[f] ++;
+            duplicateMap << f;
+        }
+    } else {
+        _SimpleList indices;        // numeric indices intended to facilitate the reindexing
+        _AVLListXL  siteIndices     (&indices);
         
-        colIndex = siteHolder.Adler32();
-        /*StringToConsole(siteHolder);
-        BufferToConsole("=");
-        StringToConsole(_String (colIndex));
-        NLToConsole();*/
-        
-        long        f = siteIndices.FindLong(colIndex);
-        _SimpleList * sameScore = nil;
+        // sweep through the columns left to right
         
-        if (f>=0) {
-            sameScore = (_SimpleList*)siteIndices.GetXtra (f);
-            for (long k = 0; k<sameScore->lLength; k++) {
-                bool fit = true;
-                f = sameScore->list_data[k];
-                for (long j=0; fit&&(j<unit); j++) { // sweep within one block
-                    _Site * site1 = ds->GetSite(verticalList.list_data[i+j]),
-                    * site2 = ds->GetSite(theMap.list_data[unit*f+j]);
+        for (i=0; i<verticalList.lLength; i+=unit) {
+            unsigned long block_hash = 0UL;
+            
+            for (j=0; j<unit; j++) { // sweep within one block
+                block_hash = block_hash * 0x01000193UL + pattern_classes.list_data [site_to_pattern[verticalList.list_data[i+j]]];
+            }
+            
+            long const colIndex = (long)block_hash;
+            
+            long        f = siteIndices.FindLong(colIndex);
+            _SimpleList * sameScore = nil;
+            
+            if (f>=0) {
+                sameScore = (_SimpleList*)siteIndices.GetXtra (f);
+                for (long k = 0; k<sameScore->lLength; k++) {
+                    bool fit = true;
+                    f = sameScore->list_data[k];
+                    for (long j=0; fit&&(j<unit); j++) { // sweep within one block
+                        fit = pattern_classes.list_data [site_to_pattern[verticalList.list_data[i+j]]] ==
+                              pattern_classes.list_data [site_to_pattern[theMap.list_data[unit*f+j]]];
+                    }
                     
-                    for (long k=0L; k<theNodeMap.lLength; k++) { // sweep down the columns
-                        long mapped_index = theNodeMap.list_data[k];
-                        if (site1->char_at (mapped_index) != site2->char_at (mapped_index)) {
-                            fit = false;
-                            break;
-                        }
+                    if (fit) {
+                        theFrequencies[f]++;
+                        duplicateMap<<f;
+                        f = 0;
+                        break;
+                    } else {
+                        f = -1;
                     }
                 }
+            }
+            if (f==-1) { // fit failed or unique site
+                if (!sameScore) {
+                    sameScore = new _SimpleList;
+                    siteIndices.Insert ((BaseRef)colIndex,(long)sameScore,false);
+                }
                 
-                if (fit) {
-                    theFrequencies[f]++;
-                    duplicateMap<<f;
-                    f = 0;
-                    break;
-                } else {
-                    f = -1;
+                (*sameScore) << theFrequencies.lLength;
+                duplicateMap<<theFrequencies.lLength;
+                theFrequencies<<1;
+                for (j=0; j<unit; j++) {
+                    theMap<<verticalList.list_data[i+j];
                 }
             }
         }
-        if (f==-1) { // fit failed or unique site
-            if (!sameScore) {
-                sameScore = new _SimpleList;
-                siteIndices.Insert ((BaseRef)colIndex,(long)sameScore,false);
-            }
-            
-            (*sameScore) << theFrequencies.lLength;
-            duplicateMap<<theFrequencies.lLength;
-            theFrequencies<<1;
-            for (j=0; j<unit; j++) {
-                theMap<<verticalList.list_data[i+j];
-            }
-        }
+        
+        siteIndices.Clear();
     }
     
-    siteIndices.Clear();
-    
     duplicateMap.TrimMemory();
     theOriginalOrder.TrimMemory();
     
@@ -527,6 +538,148 @@ void    _DataSetFilter::SetFilter (_DataSet const * ds, unsigned char unit, _Sim
     FilterDeletions();
     
 }
+
+//_______________________________________________________________________
+
+bool    _DataSetFilter::UpdateSites (_SimpleList const& sites, _SimpleList& changed_patterns) {
+    
+    changed_patterns.Clear();
+    
+    if (!IsNormalFilter() || theExclusions.nonempty() || theFrequencies.empty() || sites.empty() || sites.lLength % unitLength || hy_env::EnvVariableTrue(hy_env::skip_omissions)) {
+        return false;
+    }
+    
+    long const site_count = theData->GetNoTypes();
+    if (sites.Any ([site_count] (long site, unsigned long) -> bool {return site < 0L || site >= site_count;})) {
+        return false; // SetFilter will report and drop invalid sites
+    }
+    
+    /*
+       blocks of sites are matched to patterns by their pattern classes (see SetFilter);
+       the current patterns are indexed first, so that blocks which match them keep their rows,
+       and the blocks which introduce new patterns are given provisional rows past the end
+    */
+    
+    long        const unit            = unitLength,
+                      old_patterns    = theFrequencies.lLength,
+                      block_count     = sites.lLength / unit;
+    
+    _SimpleList const & pattern_classes = theData->PatternClasses (theNodeMap);
+    long        const * site_to_pattern = theData->theMap.list_data;
+    
+    _SimpleList   first_block,  // for provisional rows, the first block of 'sites' with this pattern
+                  counts        (old_patterns, 0L, 0L),
+                  block_rows,
+                  indices;
+    
+    _AVLListXL    row_index     (&indices); // block hash -> rows with this hash
+    
+    auto block_class = [&] (long const * block, long j) -> long {
+        return pattern_classes.list_data [site_to_pattern[block[j]]];
+    };
+    
+    auto row_sites = [&] (long row) -> long const * {
+        return row < old_patterns ? theMap.list_data + unit * row : sites.list_data + unit * first_block.list_data [row - old_patterns];
+    };
+    
+    auto find_or_add_row = [&] (long const * block, long new_row) -> long {
+        unsigned long block_hash = 0UL;
+        for (long j = 0L; j < unit; j++) {
+            block_hash = block_hash * 0x01000193UL + block_class (block, j);
+        }
+        
+        _SimpleList * same_hash = nil;
+        long          f         = row_index.FindLong ((long)block_hash);
+        
+        if (f >= 0L) {
+            same_hash = (_SimpleList*)row_index.GetXtra (f);
+            for (unsigned long k = 0UL; k < same_hash->lLength; k++) {
+                long const * candidate = row_sites (same_hash->list_data[k]);
+                long         j         = 0L;
+                while (j < unit && block_class (candidate, j) == block_class (block, j)) {
+                    j++;
+                }
+                if (j == unit) {
+                    return same_hash->list_data[k];
+                }
+            }
+        } else {
+            same_hash = new _SimpleList;
+            row_index.Insert ((BaseRef)(long)block_hash, (long)same_hash, false);
+        }
+        (*same_hash) << new_row;
+        return new_row;
+    };
+    
+    for (long row = 0L; row < old_patterns; row++) {
+        find_or_add_row (row_sites (row), row);
+    }
+    
+    block_rows.RequestSpace (block_count);
+    
+    for (long b = 0L; b < block_count; b++) {
+        long const provisional_row = counts.lLength,
+                   row             = find_or_add_row (sites.list_data + unit * b, provisional_row);
+        
+        if (row == provisional_row) {
+            first_block << b;
+            counts      << 0L;
+        }
+        counts.list_data[row] ++;
+        block_rows << row;
+    }
+    
+    row_index.Clear();
+    
+    // rows of patterns which are no longer present are reused: the patterns past the end of
+    // the new pattern range are moved into them, in order
+    
+    _SimpleList unused_rows    = counts.FilterIndex ([] (long count, unsigned long) -> bool {return count == 0L;}),
+                final_row      (counts.lLength, 0L, 1L);
+    
+    long  const pattern_count  = counts.lLength - unused_rows.lLength;
+    long        next_unused    = 0L;
+    
+    for (long row = pattern_count; row < counts.lLength; row++) {
+        if (counts.list_data[row]) {
+            final_row.list_data[row] = unused_rows.list_data[next_unused++];
+        }
+    }
+    
+    _SimpleList new_map         (pattern_count * unit, 0L, 0L),
+                new_frequencies (pattern_count, 0L, 0L);
+    
+    for (long row = 0L; row < counts.lLength; row++) {
+        if (counts.list_data[row]) {
+            long const   target       = final_row.list_data[row];
+            long const * source_sites = row_sites (row);
+            
+            for (long j = 0L; j < unit; j++) {
+                new_map.list_data[unit * target + j] = source_sites[j];
+            }
+            new_frequencies.list_data[target] = counts.list_data[row];
+            
+            if (row >= old_patterns || target != row) {
+                changed_patterns << target;
+            }
+        }
+    }
+    
+    changed_patterns.Sort();
+    
+    duplicateMap.Clear();
+    duplicateMap.RequestSpace (block_count);
+    block_rows.Each ([&] (long row, unsigned long) -> void {
+        duplicateMap << final_row.list_data[row];
+    });
+    
+    theMap           = new_map;
+    theFrequencies   = new_frequencies;
+    theOriginalOrder = sites;
+    
+    SetDimensions();
+    return true;
+}
 //_______________________________________________________________________
 long    _DataSetFilter::FindSpeciesName (_List& s, _SimpleList& r) const {
   
@@ -1413,6 +1566,335 @@ _Matrix* _DataSetFilter::ComputePairwiseDifferences (long i, long j, _hy_dataset
 
 //_________________________________________________________
 
+/*
+   All-pairs distances for nucleotide data are computed on bit-sliced sequences:
+   each sequence is stored as bit planes over sites (one plane for each of the four
+   resolved characters, one for all resolved characters and one for ambiguous
+   characters), so that counts over 64 sites at a time reduce to popcounts.
+   Sites where one of the characters is ambiguous are rare in practice; their
+   (fractional) contributions are looked up in a table indexed by character pairs.
+   Pairs are processed in tiles of sequences to keep the planes of both tiles in cache.
+*/
+
+static const unsigned long kPairwiseDistanceTile     = 32UL,
+                           kPairwiseDistancePlanes   = 6UL,
+                           kPairwiseDistanceResolved = 4UL,
+                           kPairwiseDistanceAmbiguous= 5UL;
+
+//_________________________________________________________
+
+inline unsigned long _PairwiseDistancePopCount (uint64_t word) {
+#if defined __GNUC__ || defined __clang__
+  return __builtin_popcountll (word);
+#else
+  unsigned long count = 0UL;
+  for (; word; word &= word - 1ULL) {
+    count ++;
+  }
+  return count;
+#endif
+}
+
+//_________________________________________________________
+
+inline unsigned long _PairwiseDistanceLowestBit (uint64_t word) {
+#if defined __GNUC__ || defined __clang__
+  return __builtin_ctzll (word);
+#else
+  unsigned long bit = 0UL;
+  for (; !(word & 1ULL); word >>= 1) {
+    bit ++;
+  }
+  return bit;
+#endif
+}
+
+//_________________________________________________________
+
+_Matrix* _DataSetFilter::ComputePairwiseDistances (_hy_dataset_filter_distance_metric metric, _hy_dataset_filter_ambiguity_resolution resolution_option, _Matrix const * frequencies) const {
+  
+  try {
+    unsigned long const species_count = NumberSpecies ();
+    long          const dimension     = GetDimension (true);
+    
+    // pair statistics: compared sites, identical sites, A<->G and C<->T differences
+    
+    hyFloat tn93_K [3] = {0., 0., 0.},
+            fR = 0.,
+            fY = 0.;
+    bool    use_k2p = true;
+    
+    if (metric == kDistanceMetricTN93) {
+      if (unitLength != 1UL || dimension != 4L) {
+        throw _String ("TN93 distances are only defined for nucleotide data filters");
+      }
+      _Matrix * empirical = frequencies ? nil : HarvestFrequencies (1, 1, true, false);
+      _Matrix const * nucleotide_frequencies = frequencies ? frequencies : empirical;
+      
+      if (nucleotide_frequencies->GetHDim () * nucleotide_frequencies->GetVDim () != 4L) {
+        DeleteObject (empirical);
+        throw _String ("Expected a vector of 4 nucleotide frequencies for TN93 distances");
+      }
+      
+      hyFloat const * f = nucleotide_frequencies->theData;
+      fY = f[1] + f[3];
+      fR = 1. - fY;
+      use_k2p = f[0] == 0. || f[1] == 0. || f[2] == 0. || f[3] == 0.;
+      if (!use_k2p) {
+        tn93_K[0] = 2.*f[0]*f[2]/fR;
+        tn93_K[1] = 2.*f[1]*f[3]/fY;
+        tn93_K[2] = 2.*(fR*fY-f[0]*f[2]*fY/fR-f[1]*f[3]*fR/fY);
+      }
+      DeleteObject (empirical);
+    }
+    
+    auto distance_from_counts = [&] (hyFloat total, hyFloat identical, hyFloat AG, hyFloat CT) -> hyFloat {
+      if (total > 0.) {
+        if (metric == kDistanceMetricProportion) {
+          return (total - identical) / total;
+        }
+        AG /= total;
+        CT /= total;
+        hyFloat const transversions = 1. - AG - CT - identical / total;
+        if (use_k2p) {
+          hyFloat const d1 = 1. - 2.*(AG+CT) - transversions,
+                        d2 = 1. - 2.*transversions;
+          if (d1 > 0. && d2 > 0.) {
+            return -(0.5*log (d1)+.25*log(d2));
+          }
+        } else {
+          hyFloat const d1 = 1. - AG/tn93_K[0] - 0.5*transversions/fR,
+                        d2 = 1. - CT/tn93_K[1] - 0.5*transversions/fY,
+                        d3 = 1. - 0.5*transversions/fR/fY;
+          if (d1 > 0. && d2 > 0. && d3 > 0.) {
+            return -tn93_K[0]*log(d1)-tn93_K[1]*log(d2)-tn93_K[2]*log(d3);
+          }
+        }
+      }
+      return 1000.;
+    };
+    
+    _Matrix * distances = new _Matrix (species_count, species_count, false, true);
+    
+    auto store_distance = [distances, species_count] (unsigned long i, unsigned long j, hyFloat d) -> void {
+      distances->theData [i*species_count + j] = d;
+      distances->theData [j*species_count + i] = d;
+    };
+    
+    if (unitLength != 1UL || dimension != 4L || theExclusions.nonempty() || (resolution_option != kAmbiguityHandlingResolve && resolution_option != kAmbiguityHandlingSkip)) {
+      // general case: ambiguity handling depends on character frequencies at each site
+      for (unsigned long i = 0UL; i < species_count; i++) {
+        for (unsigned long j = i + 1UL; j < species_count; j++) {
+          _Matrix * counts = ComputePairwiseDifferences (i, j, resolution_option);
+          hyFloat   total = 0., identical = 0., AG = 0., CT = 0.;
+          long      const count_dimension = counts->GetHDim ();
+          for (long k = 0L; k < count_dimension; k++) {
+            for (long l = 0L; l < count_dimension; l++) {
+              total += counts->theData[k*count_dimension+l];
+            }
+            identical += counts->theData[k*count_dimension+k];
+          }
+          if (count_dimension == 4L) {
+            AG = counts->theData[2] + counts->theData[8];
+            CT = counts->theData[7] + counts->theData[13];
+          }
+          DeleteObject (counts);
+          store_distance (i, j, distance_from_counts (total, identical, AG, CT));
+        }
+      }
+      return distances;
+    }
+    
+    // classify characters: resolved characters (0-3), ambiguous characters
+    // (which resolve to more than one state), and characters that resolve to nothing (gaps)
+    
+    unsigned long const site_count = duplicateMap.countitems(),
+                        word_count = (site_count + 63UL) >> 6;
+    
+    long            character_index [256];
+    unsigned char   character_masks [256];
+    long            character_count = 0L;
+    InitializeArray (character_index, 256, -1L);
+    
+    unsigned char * site_characters = new unsigned char [species_count * site_count];
+    uint64_t      * planes = new uint64_t [species_count * word_count * kPairwiseDistancePlanes];
+    InitializeArray (planes, species_count * word_count * kPairwiseDistancePlanes, (uint64_t)0ULL);
+    
+    hyFloat resolutions [4];
+    
+    for (unsigned long species = 0UL; species < species_count; species++) {
+      long       const sequence = theNodeMap.get (species);
+      uint64_t * const sequence_planes = planes + species * word_count * kPairwiseDistancePlanes;
+      for (unsigned long site = 0UL; site < site_count; site++) {
+        unsigned char const c = direct_index_character (duplicateMap.get (site), sequence);
+        if (character_index[c] < 0L) {
+          long const resolved = Translate2Frequencies ((char)c, resolutions, false);
+          unsigned char mask = 0;
+          for (long k = 0L; k < 4L; k++) {
+            if (resolutions[k] > 0.) {
+              mask |= 1 << k;
+            }
+          }
+          character_masks [character_count] = mask;
+          character_index [c] = character_count ++;
+          if (resolved == 1L && _PairwiseDistancePopCount (mask) == 1UL) {
+            character_masks [character_index [c]] |= 0x80;
+          }
+        }
+        
+        long          const ci   = character_index [c];
+        unsigned char const mask = character_masks [ci];
+        uint64_t      const bit  = 1ULL << (site & 63UL);
+        uint64_t    * word_planes = sequence_planes + (site >> 6) * kPairwiseDistancePlanes;
+        
+        site_characters [species * site_count + site] = ci;
+        if (mask & 0x80) {
+          word_planes [_PairwiseDistanceLowestBit (mask & 0x0f)] |= bit;
+          word_planes [kPairwiseDistanceResolved] |= bit;
+        } else if (mask) {
+          word_planes [kPairwiseDistanceAmbiguous] |= bit;
+        }
+      }
+    }
+    
+    // contributions of character pairs involving an ambiguity, following the
+    // conventions of ComputePairwiseDifferences for kAmbiguityHandlingResolve:
+    //  - if the ambiguity includes the resolved character, count as a match
+    //  - two ambiguities which share a resolution are not counted
+    //  - otherwise, spread the site across all combinations of resolutions
+    
+    hyFloat * pair_contributions = new hyFloat [character_count * character_count * 4L];
+    InitializeArray (pair_contributions, character_count * character_count * 4L, 0.);
+    
+    if (resolution_option == kAmbiguityHandlingResolve) {
+      for (long c1 = 0L; c1 < character_count; c1++) {
+        for (long c2 = 0L; c2 < character_count; c2++) {
+          unsigned char const m1 = character_masks[c1] & 0x0f,
+                              m2 = character_masks[c2] & 0x0f;
+          
+          if ((character_masks[c1] & 0x80) && (character_masks[c2] & 0x80)) {
+            continue;
+          }
+          
+          hyFloat counts [16];
+          InitializeArray (counts, 16, 0.);
+          
+          if (character_masks[c1] & 0x80) {
+            long const s1 = _PairwiseDistanceLowestBit (m1);
+            if (m2 & m1) {
+              counts [s1*5] = 1.;
+            } else if (m2) {
+              hyFloat const weight = 1./_PairwiseDistancePopCount (m2);
+              for (long k = 0L; k < 4L; k++) {
+                if (m2 & (1 << k)) {
+                  counts [s1*4+k] = weight;
+                }
+              }
+            }
+          } else if (character_masks[c2] & 0x80) {
+            long const s2 = _PairwiseDistanceLowestBit (m2);
+            if (m2 & m1) {
+              counts [s2*5] = 1.;
+            } else if (m1) {
+              hyFloat const weight = 1./_PairwiseDistancePopCount (m1);
+              for (long k = 0L; k < 4L; k++) {
+                if (m1 & (1 << k)) {
+                  counts [k*4+s2] = weight;
+                }
+              }
+            }
+          } else if (m1 && m2 && !(m1 & m2)) {
+            hyFloat const weight = 1./(_PairwiseDistancePopCount (m1) * _PairwiseDistancePopCount (m2));
+            for (long k = 0L; k < 4L; k++) {
+              for (long l = 0L; l < 4L; l++) {
+                if ((m1 & (1 << k)) && (m2 & (1 << l))) {
+                  counts [k*4+l] = weight;
+                }
+              }
+            }
+          }
+          
+          hyFloat * contribution = pair_contributions + (c1 * character_count + c2) * 4L;
+          for (long k = 0L; k < 16L; k++) {
+            contribution[0] += counts[k];
+          }
+          contribution[1] = counts[0] + counts[5] + counts[10] + counts[15];
+          contribution[2] = counts[2] + counts[8];
+          contribution[3] = counts[7] + counts[13];
+        }
+      }
+    }
+    
+    bool const do_ambiguities = resolution_option == kAmbiguityHandlingResolve,
+               do_tn93        = metric == kDistanceMetricTN93;
+    
+    unsigned long const tile_count      = (species_count + kPairwiseDistanceTile - 1UL) / kPairwiseDistanceTile,
+                        tile_pair_count = tile_count * (tile_count + 1UL) / 2UL;
+    
+#ifdef _OPENMP
+    long const nt = MIN((unsigned long)omp_get_max_threads(), tile_pair_count);
+#pragma omp parallel for default(shared) schedule(dynamic) if (nt > 1) num_threads(nt)
+#endif
+    for (unsigned long tile_pair = 0UL; tile_pair < tile_pair_count; tile_pair++) {
+      // map the index to a pair of tiles (t1 <= t2)
+      unsigned long t1 = 0UL, remaining = tile_pair;
+      while (remaining >= tile_count - t1) {
+        remaining -= tile_count - t1;
+        t1 ++;
+      }
+      unsigned long const t2 = t1 + remaining,
+                          i_end = MIN (species_count, (t1 + 1UL) * kPairwiseDistanceTile),
+                          j_end = MIN (species_count, (t2 + 1UL) * kPairwiseDistanceTile);
+      
+      for (unsigned long i = t1 * kPairwiseDistanceTile; i < i_end; i++) {
+        uint64_t const * planes_i = planes + i * word_count * kPairwiseDistancePlanes;
+        for (unsigned long j = MAX (i + 1UL, t2 * kPairwiseDistanceTile); j < j_end; j++) {
+          uint64_t const * planes_j = planes + j * word_count * kPairwiseDistancePlanes;
+          
+          unsigned long total = 0UL, identical = 0UL, AG = 0UL, CT = 0UL;
+          hyFloat       ambiguous [4] = {0., 0., 0., 0.};
+          
+          for (unsigned long w = 0UL; w < word_count; w++) {
+            uint64_t const * a = planes_i + w * kPairwiseDistancePlanes,
+                           * b = planes_j + w * kPairwiseDistancePlanes;
+            
+            total     += _PairwiseDistancePopCount (a[kPairwiseDistanceResolved] & b[kPairwiseDistanceResolved]);
+            identical += _PairwiseDistancePopCount ((a[0] & b[0]) | (a[1] & b[1]) | (a[2] & b[2]) | (a[3] & b[3]));
+            if (do_tn93) {
+              AG += _PairwiseDistancePopCount ((a[0] & b[2]) | (a[2] & b[0]));
+              CT += _PairwiseDistancePopCount ((a[1] & b[3]) | (a[3] & b[1]));
+            }
+            if (do_ambiguities) {
+              uint64_t with_ambiguity = (a[kPairwiseDistanceAmbiguous] & (b[kPairwiseDistanceResolved] | b[kPairwiseDistanceAmbiguous])) | (a[kPairwiseDistanceResolved] & b[kPairwiseDistanceAmbiguous]);
+              while (with_ambiguity) {
+                unsigned long const site = (w << 6) + _PairwiseDistanceLowestBit (with_ambiguity);
+                hyFloat const * contribution = pair_contributions + (site_characters [i * site_count + site] * character_count + site_characters [j * site_count + site]) * 4L;
+                for (long k = 0L; k < 4L; k++) {
+                  ambiguous[k] += contribution[k];
+                }
+                with_ambiguity &= with_ambiguity - 1ULL;
+              }
+            }
+          }
+          
+          store_distance (i, j, distance_from_counts (total + ambiguous[0], identical + ambiguous[1], AG + ambiguous[2], CT + ambiguous[3]));
+        }
+      }
+    }
+    
+    delete [] planes;
+    delete [] site_characters;
+    delete [] pair_contributions;
+    return distances;
+  }
+  catch (const _String& error) {
+    HandleApplicationError(error);
+    return new _Matrix (1,1,false,true);
+  }
+}
+
+//_________________________________________________________
+
 void _DataSetFilter::ComputePairwiseDifferences (_Matrix& target, long i, long j) const
 // matrix of dimension nx4n containing pairwise distances as follows (n=number of species)
 // first lower diag - count the same (AA,CC,GG,TT)
@@ -1920,7 +2402,8 @@ void    _DataSetFilter::internalToStr (FILE * file ,_StringBuffer * string_buffe
       kFormatFASTASequential            = 9,
       kFormatFASTAInterleaved           = 10,
       kFormatPAML                       = 11,
-      kFormatSTOCKHOLM                  = 12
+      kFormatSTOCKHOLM                  = 12,
+      kFormatBinary                     = 13
   } datafile_format = kFormatMEGASequential;
   
   auto trim_to_10 = [] (const _String& seq_name) -> _String const {
@@ -1947,6 +2430,15 @@ void    _DataSetFilter::internalToStr (FILE * file ,_StringBuffer * string_buffe
     gapWidth = hy_env::EnvVariableGetDefaultNumber(hy_env::data_file_gap_width);
   }
   
+  if (outputFormat == kFormatBinary) {
+    if (file) {
+      WriteBinary (file);
+    } else {
+      HandleApplicationError ("The binary data set format (DATA_FILE_PRINT_FORMAT = 13) can only be written to a file");
+    }
+    return;
+  }
+
   StringFileWrapper write_here (file ? nil : string_buffer, file);
   
   if (outputFormat < 4 || outputFormat > 8) {
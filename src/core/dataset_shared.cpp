@@ -0,0 +1,593 @@
+/*
+
+HyPhy - Hypothesis Testing Using Phylogenies.
+
+Copyright (C) 1997-now
+Core Developers:
+   Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+   Art FY Poon    (apoon42@uwo.ca)
+   Steven Weaver (sweaver@temple.edu)
+
+Module Developers:
+        Lance Hepler (nlhepler@gmail.com)
+        Martin Smith (martin.audacis@gmail.com)
+
+Significant contributions from:
+  Spencer V Muse (muse@stat.ncsu.edu)
+  Simon DW Frost (sdf22@cam.ac.uk)
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dataset.h"
+#include "batchlan.h"
+#include "hbl_env.h"
+#include "global_things.h"
+#include "mpi_node_layout.h"
+
+#ifdef __HYPHYMPI__
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <signal.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+using namespace hy_global;
+
+/*
+   The layout of a shared data set segment (see _SharedDataSetClaim). All
+   integers are 64-bit; strings are stored as a length followed by the
+   characters, padded to a multiple of 8 bytes.
+
+     header (see _SharedDataSetHeader)
+     species, sites, unique patterns
+     translation table: base length, base set, added tokens, added translations
+     species names (their number, then the names)
+     tree string (empty if none)
+     site -> pattern map (sites values)
+     pattern frequencies (unique patterns values)
+     pattern characters (species bytes and a terminating 0 per pattern)
+
+   Segments are written once, by the rank which claimed them, and are then
+   mapped read-only; readers wait for 'state' to become kSharedDataSetReady.
+   Each rank which maps a segment counts itself in 'readers' (once); the rank
+   which brings the count to the number of worker ranks on the host removes
+   the name of the segment, so that it goes away with the last mapping even
+   if the job is aborted.
+*/
+
+#ifdef __HYPHYMPI__
+
+static const char     kSharedDataSetMagic [8]   = {'H','Y','P','H','Y','S','D','S'};
+static const uint32_t kSharedDataSetVersion     = 2U,
+                      kSharedDataSetWriting     = 0U,
+                      kSharedDataSetReady       = 1U,
+                      kSharedDataSetAbandoned   = 2U;
+
+/** shorter strings are parsed by each rank; sharing them would save less than it costs */
+static const unsigned long kSharedDataSetMinimumLength = 1UL << 16;
+
+/** the longest interval (in microseconds) between checks of a segment which is being written */
+static const useconds_t    kSharedDataSetMaxPollInterval = 50000U;
+
+struct _SharedDataSetHeader {
+  char     magic [8];
+  uint32_t state,
+           version;
+  int64_t  creator, // the process id of the rank which writes the segment
+           size,    // the size of the segment in bytes (including this header)
+           readers; // the number of ranks which have mapped the segment
+};
+
+static _List shared_data_set_names,   // the segments created by this process
+             shared_data_set_mappings; // the segments this process has counted itself in (name:inode)
+
+//_________________________________________________________
+
+class _SharedDataSetImage : public BaseObj {
+  // a read-only mapping of a shared data set segment; unmapped with the last site which refers to it
+public:
+  _SharedDataSetImage (void * address, size_t size) : address (address), size (size) {}
+  virtual ~_SharedDataSetImage (void) {
+    munmap (address, size);
+  }
+  // mappings are not copied
+  virtual BaseRef makeDynamic (void) const {
+    return nil;
+  }
+  virtual void Duplicate (BaseRefConst) {
+  }
+
+  void * address;
+  size_t size;
+private:
+  _SharedDataSetImage (_SharedDataSetImage const &);
+  _SharedDataSetImage & operator = (_SharedDataSetImage const &);
+};
+
+//_________________________________________________________
+
+static void _SharedImageWriteInteger (char * image, int64_t & offset, int64_t value) {
+  // image == nil only advances the offset (used to compute the size of the segment)
+  if (image) {
+    memcpy (image + offset, &value, sizeof (int64_t));
+  }
+  offset += sizeof (int64_t);
+}
+
+//_________________________________________________________
+
+static void _SharedImageWriteString (char * image, int64_t & offset, _String const& value) {
+  _SharedImageWriteInteger (image, offset, value.length());
+  if (image && value.nonempty()) {
+    memcpy (image + offset, value.get_str(), value.length());
+  }
+  offset += (value.length() + 7L) & ~7L;
+}
+
+//_________________________________________________________
+
+static int64_t _SharedImageReadInteger (char const * image, int64_t size, int64_t & offset) {
+  if (offset + (int64_t)sizeof (int64_t) > size) {
+    throw _String ("Truncated shared data set segment");
+  }
+  int64_t value;
+  memcpy (&value, image + offset, sizeof (int64_t));
+  offset += sizeof (int64_t);
+  return value;
+}
+
+//_________________________________________________________
+
+static int64_t _SharedImageReadCount (char const * image, int64_t size, int64_t & offset, int64_t upper_bound) {
+  int64_t const value = _SharedImageReadInteger (image, size, offset);
+  if (value < 0 || value > upper_bound) {
+    throw _String ("Invalid count or index (") & _String ((long)value) & ") in a shared data set segment";
+  }
+  return value;
+}
+
+//_________________________________________________________
+
+static const _String _SharedImageReadString (char const * image, int64_t size, int64_t & offset) {
+  int64_t const length = _SharedImageReadCount (image, size, offset, size - offset - (int64_t)sizeof (int64_t));
+  _String value ((unsigned long)length);
+  memcpy ((char*)value.get_str(), image + offset, length);
+  offset += (length + 7L) & ~7L;
+  return value;
+}
+
+//_________________________________________________________
+
+static void _SharedImageWrite (char * image, int64_t & offset, _DataSet const & data, _SimpleList const & map, _List const & names, _TranslationTable const * table) {
+  unsigned long const species_count = data.NoOfSpecies(),
+                      pattern_count = data.NoOfUniqueColumns();
+
+  _SharedImageWriteInteger (image, offset, species_count);
+  _SharedImageWriteInteger (image, offset, map.countitems());
+  _SharedImageWriteInteger (image, offset, pattern_count);
+
+  _SharedImageWriteInteger (image, offset, table->baseLength);
+  _SharedImageWriteString  (image, offset, table->baseSet);
+  _SharedImageWriteString  (image, offset, table->tokensAdded);
+  _SharedImageWriteInteger (image, offset, table->translationsAdded.countitems());
+  table->translationsAdded.Each ([&] (long value, unsigned long) -> void {
+    _SharedImageWriteInteger (image, offset, value);
+  });
+
+  _SharedImageWriteInteger (image, offset, names.countitems());
+  names.ForEach ([&] (BaseRefConst name, unsigned long) -> void {
+    _SharedImageWriteString (image, offset, *(_String const*)name);
+  });
+
+  _SharedImageWriteString (image, offset, data.GetTreeString());
+
+  map.Each ([&] (long value, unsigned long) -> void {
+    _SharedImageWriteInteger (image, offset, value);
+  });
+  for (unsigned long pattern = 0UL; pattern < pattern_count; pattern++) {
+    _SharedImageWriteInteger (image, offset, data.GetFreqType (pattern));
+  }
+
+  for (unsigned long pattern = 0UL; pattern < pattern_count; pattern++) {
+    _Site const * site = (_Site const*)data.GetItem (pattern);
+    if (site->length() != species_count) {
+      throw _String ("Pattern ") & _String ((long)pattern) & " has " & _String ((long)site->length()) & " characters instead of " & _String ((long)species_count);
+    }
+    if (image) {
+      memcpy (image + offset, site->get_str(), species_count);
+      image [offset + species_count] = 0;
+    }
+    offset += species_count + 1L;
+  }
+}
+
+//_________________________________________________________
+
+static bool _SharedDataSetText (_String const & source, unsigned long & data_length, _String & hbl_block) {
+  /* the part of 'source' which determines the data set: all of it, or, for a
+     NEXUS string, the blocks before the HYPHY block, which is returned in
+     'hbl_block'; NEXUS strings with blocks other than TAXA, CHARACTERS (DATA)
+     and a final HYPHY block are not shared, because reading them has other
+     side effects */
+
+  static const _String kNEXUS ("#NEXUS"), kBegin ("BEGIN"), kEnd ("END;"),
+                       kTaxa ("TAXA"), kCharacters ("CHARACTERS"), kData ("DATA"), kHyPhy ("HYPHY");
+
+  hbl_block = kEmptyString;
+  data_length = source.length();
+
+  if (!source.BeginsWith (kNEXUS, false)) {
+    return true;
+  }
+
+  for (long block = source.FindAnyCase (kBegin); block != kNotFound; block = source.FindAnyCase (kBegin, block + 1L)) {
+    long const name_start = source.FirstNonSpaceIndex (block + kBegin.length());
+    long const name_end   = name_start == kNotFound ? kNotFound : source.Find (';', name_start);
+    if (name_end == kNotFound) {
+      return false;
+    }
+    _String const block_name (source.Cut (name_start, source.FirstNonSpaceIndex (name_start, name_end - 1L, kStringDirectionBackward)));
+
+    if (block_name.EqualIgnoringCase (kHyPhy)) {
+      long const block_end = source.FindAnyCase (kEnd, name_end + 1L);
+      if (block_end == kNotFound || source.FirstNonSpaceIndex (block_end + kEnd.length()) != kNotFound) {
+        return false;
+      }
+      data_length = block;
+      hbl_block   = source.Cut (name_end + 1L, block_end - 1L);
+      return true;
+    }
+    if (!(block_name.EqualIgnoringCase (kTaxa) || block_name.EqualIgnoringCase (kCharacters) || block_name.EqualIgnoringCase (kData))) {
+      return false;
+    }
+    block = name_end;
+  }
+  return true;
+}
+
+//_________________________________________________________
+
+static uint64_t _SharedDataSetHash (char const * text, unsigned long length) {
+  // 64-bit FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned long k = 0UL; k < length; k++) {
+    hash = (hash ^ (unsigned char)text[k]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+//_________________________________________________________
+
+static void _SharedDataSetAddReader (char const * segment_name, int segment) {
+  struct stat segment_status;
+  if (fstat (segment, &segment_status) != 0) {
+    return;
+  }
+  // the name may be reused by a new segment once the old one has been removed
+  _String * mapping = new _String (_String (segment_name) & ':' & _String ((long)segment_status.st_ino));
+  if (shared_data_set_mappings.FindObject (mapping) != kNotFound) {
+    DeleteObject (mapping);
+    return;
+  }
+  void * mapped = mmap (nil, sizeof (_SharedDataSetHeader), PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0);
+  if (mapped == MAP_FAILED) {
+    DeleteObject (mapping);
+    return;
+  }
+  shared_data_set_mappings < mapping;
+  int64_t const readers = __atomic_add_fetch (&((_SharedDataSetHeader*)mapped)->readers, 1, __ATOMIC_ACQ_REL);
+  munmap (mapped, sizeof (_SharedDataSetHeader));
+  if (readers >= MPIHostWorkerCount ()) {
+    shm_unlink (segment_name);
+    ReportWarning (_String ("[MPI] All ranks on this host have mapped shared data set ") & _String (segment_name) & "; removed its name");
+  }
+}
+
+#endif
+
+//_________________________________________________________
+
+_SharedDataSetClaim::_SharedDataSetClaim (void) : name (), descriptor (-1), header (nil) {
+}
+
+//_________________________________________________________
+
+_SharedDataSetClaim::~_SharedDataSetClaim (void) {
+#ifdef __HYPHYMPI__
+  if (header) {
+    _SharedDataSetHeader * segment_header = (_SharedDataSetHeader*)header;
+    if (__atomic_load_n (&segment_header->state, __ATOMIC_ACQUIRE) != kSharedDataSetReady) {
+      // not published: let the waiting ranks read the data themselves, and the next ones claim it again
+      __atomic_store_n (&segment_header->state, kSharedDataSetAbandoned, __ATOMIC_RELEASE);
+      shm_unlink (name.get_str());
+    }
+    munmap (header, sizeof (_SharedDataSetHeader));
+  }
+  if (descriptor >= 0) {
+    close (descriptor);
+  }
+#endif
+}
+
+//_________________________________________________________
+
+bool _SharedDataSetClaim::Attach (_String const & source, _String * namespace_id, _TranslationTable const * table, _DataSet & result) {
+#ifdef __HYPHYMPI__
+  if (hy_mpi_node_rank == 0L || MPIHostWorkerCount () < 2L || table != &hy_default_translation_table ||
+      hy_env::EnvVariableGetNumber (hy_env::mpi_share_data_sets, 1.) == 0.) {
+    return false;
+  }
+
+  unsigned long data_length;
+  _String       hbl_block;
+
+  if (source.length() < kSharedDataSetMinimumLength || !_SharedDataSetText (source, data_length, hbl_block) || data_length < kSharedDataSetMinimumLength) {
+    return false;
+  }
+
+  char segment_name [128];
+  snprintf (segment_name, sizeof (segment_name), "/hyphy.%ld.%016llx.%lx", MPIHostSessionID (),
+            (unsigned long long)_SharedDataSetHash (source.get_str(), data_length), data_length);
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    int segment = shm_open (segment_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (segment >= 0) { // this rank reads the data set, and will publish it
+      _SharedDataSetHeader initial;
+      memcpy (initial.magic, kSharedDataSetMagic, sizeof (kSharedDataSetMagic));
+      initial.state   = kSharedDataSetWriting;
+      initial.version = kSharedDataSetVersion;
+      initial.creator = getpid ();
+      initial.size    = 0L;
+      initial.readers = 0L;
+
+      void * mapped = MAP_FAILED;
+      if (ftruncate (segment, sizeof (_SharedDataSetHeader)) == 0) {
+        mapped = mmap (nil, sizeof (_SharedDataSetHeader), PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0);
+      }
+      if (mapped == MAP_FAILED) {
+        shm_unlink (segment_name);
+        close (segment);
+        return false;
+      }
+      memcpy (mapped, &initial, sizeof (_SharedDataSetHeader));
+      name       = segment_name;
+      descriptor = segment;
+      header     = mapped;
+      shared_data_set_names < new _String (name);
+      return false;
+    }
+
+    if (errno != EEXIST) {
+      return false;
+    }
+
+    segment = shm_open (segment_name, O_RDWR, 0); // writable, to count this rank as a reader
+    if (segment < 0) {
+      continue; // abandoned and removed in the meantime; try to claim it
+    }
+
+    if (Map (segment, result)) {
+      _SharedDataSetAddReader (segment_name, segment);
+      close (segment);
+      if (result.treeString.nonempty()) { // as set by ProcessTree
+        hy_env::EnvVariableSetNamespace (hy_env::data_file_tree, new HY_CONSTANT_TRUE, namespace_id, false);
+        hy_env::EnvVariableSet (hy_env::data_file_tree_string, new _FString (result.treeString, false), false);
+      }
+      if (source.BeginsWith ("#NEXUS", false)) {
+        nexusBFBody = hbl_block;
+      }
+      ReportWarning (_String ("[MPI] Mapped shared data set ") & _String ((const char*)segment_name));
+      return true;
+    }
+    close (segment);
+    return false;
+  }
+#endif
+  return false;
+}
+
+//_________________________________________________________
+
+bool _SharedDataSetClaim::Map (int segment, _DataSet & result) {
+  // wait for the segment to be published, then map it into (the empty) 'result'
+#ifdef __HYPHYMPI__
+  useconds_t poll_interval = 100U;
+  int64_t    size = 0L;
+
+  while (true) {
+    struct stat segment_status;
+    if (fstat (segment, &segment_status) != 0) {
+      return false;
+    }
+    if (segment_status.st_size >= (off_t)sizeof (_SharedDataSetHeader)) {
+      void * mapped = mmap (nil, sizeof (_SharedDataSetHeader), PROT_READ, MAP_SHARED, segment, 0);
+      if (mapped == MAP_FAILED) {
+        return false;
+      }
+      _SharedDataSetHeader * segment_header = (_SharedDataSetHeader*)mapped;
+      uint32_t const state   = __atomic_load_n (&segment_header->state, __ATOMIC_ACQUIRE);
+      pid_t    const creator = segment_header->creator;
+      bool     const valid   = memcmp (segment_header->magic, kSharedDataSetMagic, sizeof (kSharedDataSetMagic)) == 0 && segment_header->version == kSharedDataSetVersion;
+      size = segment_header->size;
+      munmap (mapped, sizeof (_SharedDataSetHeader));
+
+      if (!valid || state == kSharedDataSetAbandoned) {
+        return false;
+      }
+      if (state == kSharedDataSetReady) {
+        break;
+      }
+      if (kill (creator, 0) != 0 && errno == ESRCH) { // the rank which claimed the segment has died
+        return false;
+      }
+    }
+    usleep (poll_interval);
+    poll_interval = MIN (poll_interval * 2U, kSharedDataSetMaxPollInterval);
+  }
+
+  void * mapped = mmap (nil, size, PROT_READ, MAP_SHARED, segment, 0);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  _SharedDataSetImage * image_owner = new _SharedDataSetImage (mapped, size);
+  char const          * image       = (char const*)mapped;
+  int64_t               offset      = sizeof (_SharedDataSetHeader);
+
+  try {
+    long const species_count = _SharedImageReadCount (image, size, offset, 0x7FFFFFFFL),
+               site_count    = _SharedImageReadCount (image, size, offset, 0x7FFFFFFFL),
+               pattern_count = _SharedImageReadCount (image, size, offset, site_count);
+
+    _TranslationTable * table = new _TranslationTable;
+    try {
+      table->baseLength  = _SharedImageReadCount (image, size, offset, 255L);
+      table->baseSet     = _SharedImageReadString (image, size, offset);
+      table->tokensAdded = _SharedImageReadString (image, size, offset);
+      for (long translations = _SharedImageReadCount (image, size, offset, 0x7FFFFFFFL); translations > 0L; translations--) {
+        table->translationsAdded << _SharedImageReadInteger (image, size, offset);
+      }
+    } catch (_String const&) {
+      DeleteObject (table);
+      throw;
+    }
+
+    if (table->IsStandardNucleotide() && table->tokensAdded.empty() && table->translationsAdded.empty()) {
+      DeleteObject (table);
+      result.theTT = &hy_default_translation_table;
+    } else {
+      result.theTT = table;
+    }
+
+    for (long names = _SharedImageReadCount (image, size, offset, 0x7FFFFFFFL); names > 0L; names--) {
+      result.AddName (_SharedImageReadString (image, size, offset));
+    }
+
+    result.treeString = _SharedImageReadString (image, size, offset);
+
+    result.theMap.RequestSpace (site_count);
+    for (long site = 0L; site < site_count; site++) {
+      result.theMap << _SharedImageReadCount (image, size, offset, pattern_count - 1L);
+    }
+    result.theFrequencies.RequestSpace (pattern_count);
+    for (long pattern = 0L; pattern < pattern_count; pattern++) {
+      result.theFrequencies << _SharedImageReadCount (image, size, offset, site_count);
+    }
+
+    if (offset + pattern_count * (species_count + 1L) > size) {
+      throw _String ("Truncated shared data set segment");
+    }
+
+    result.RequestSpace (pattern_count);
+    for (long pattern = 0L; pattern < pattern_count; pattern++) {
+      result < new _Site (image + offset + pattern * (species_count + 1L), species_count, image_owner);
+    }
+    result.noOfSpecies = species_count;
+  } catch (_String const& error) {
+    ReportWarning (_String ("[MPI] Could not map a shared data set: ") & error);
+    result.Clear();
+    DeleteObject (image_owner);
+    return false;
+  }
+
+  DeleteObject (image_owner); // the sites now hold the references to the mapping
+  return true;
+#else
+  return false;
+#endif
+}
+
+//_________________________________________________________
+
+void _SharedDataSetClaim::Publish (_DataSet & data) {
+  // copy the data set which has just been read into the claimed segment, and replace the characters of 'data' with the shared ones
+#ifdef __HYPHYMPI__
+  if (!header) {
+    return;
+  }
+
+  _SharedDataSetHeader * segment_header = (_SharedDataSetHeader*)header;
+
+  try {
+    _SimpleList const & map = data.DuplicateMap();
+    int64_t             size = sizeof (_SharedDataSetHeader);
+
+    _SharedImageWrite (nil, size, data, map, data.GetNames(), data.GetTT());
+
+    if (ftruncate (descriptor, size) != 0) {
+      throw _String ("could not resize the segment to ") & _String ((long)size) & " bytes";
+    }
+    void * mapped = mmap (nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (mapped == MAP_FAILED) {
+      throw _String ("could not map the segment");
+    }
+
+    int64_t offset = sizeof (_SharedDataSetHeader);
+    try {
+      _SharedImageWrite ((char*)mapped, offset, data, map, data.GetNames(), data.GetTT());
+    } catch (_String const&) {
+      munmap (mapped, size);
+      throw;
+    }
+    munmap (mapped, size);
+
+    segment_header->size = size;
+    __atomic_store_n (&segment_header->state, kSharedDataSetReady, __ATOMIC_RELEASE);
+  } catch (_String const& error) {
+    ReportWarning (_String ("[MPI] Could not share a data set: ") & error);
+    return; // abandoned by the destructor
+  }
+
+  // the data set is now published; drop the private copy
+  _DataSet shared;
+  if (Map (descriptor, shared)) {
+    _SharedDataSetAddReader (name.get_str(), descriptor);
+    data.Clear();
+    data.theTT   = shared.theTT;
+    shared.theTT = &hy_default_translation_table;
+    data.theMap.Duplicate (&shared.theMap);
+    data.theFrequencies.Duplicate (&shared.theFrequencies);
+    data.SetNames (shared.GetNames());
+    data.treeString = shared.treeString;
+    data << shared;
+    data.noOfSpecies = shared.noOfSpecies;
+    ReportWarning (_String ("[MPI] Published shared data set ") & name);
+  }
+#endif
+}
+
+//_________________________________________________________
+
+void ReleaseSharedDataSets (void) {
+#ifdef __HYPHYMPI__
+  shared_data_set_names.ForEach ([] (BaseRef name, unsigned long) -> void {
+    shm_unlink (((_String*)name)->get_str());
+  });
+  shared_data_set_names.Clear();
+#endif
+}
@@ -2802,6 +2802,80 @@ void _Formula::SimplifyConstants (void){
   ConvertFromTree ();
 }
 
+//__________________________________________________________________________________
+_String* _Formula::CanonicalForm (void) {
+    
+    // only reorder operands if every term is known to be a scalar, because
+    // e.g. matrix multiplication does not commute
+    
+    bool all_scalar = true;
+    
+    for (unsigned long i = 0UL; i < theFormula.countitems() && all_scalar; i++) {
+        _Operation* this_op = ItemAt (i);
+        if (this_op->theNumber) {
+            all_scalar = this_op->theNumber->ObjectClass() == NUMBER;
+        } else if (this_op->theData >= 0L) {
+            all_scalar = LocateVar (this_op->theData)->ObjectClass() == NUMBER;
+        } else {
+            all_scalar = this_op->theData == -1L && this_op->numberOfTerms >= 0L && this_op->opCode != HY_OP_CODE_MACCESS && this_op->opCode != HY_OP_CODE_MCOORD;
+        }
+    }
+    
+    if (all_scalar) {
+        ConvertToTree (false);
+    }
+    
+    if (!all_scalar || !theTree) {
+        return (_String*)toStr (kFormulaStringConversionNormal, nil, true);
+    }
+    
+    _StringBuffer * result = new _StringBuffer (64UL);
+    SubtreeToCanonicalForm (*result, theTree);
+    theTree->delete_tree();
+    delete theTree;
+    theTree = nil;
+    return result;
+}
+
+//__________________________________________________________________________________
+void _Formula::SubtreeToCanonicalForm (_StringBuffer & result, node<long>* top_node) const {
+    _Operation * this_op = GetIthTerm (top_node->get_data());
+    
+    if (this_op->theNumber) {
+        // hex float: exact, so that only bit-identical constants match
+        result << '#' << _String (this_op->theNumber->Value(), "%a");
+        return;
+    }
+    if (this_op->theData >= 0L) {
+        result << '$' << _String (this_op->theData);
+        return;
+    }
+    
+    long const n_children = top_node->get_num_nodes();
+    
+    result << '(' << _String (this_op->opCode) << ':';
+    
+    if (n_children == 2L && (this_op->opCode == HY_OP_CODE_ADD || this_op->opCode == HY_OP_CODE_MUL)) {
+        _StringBuffer left  (32UL),
+                      right (32UL);
+        SubtreeToCanonicalForm (left, top_node->go_down (1));
+        SubtreeToCanonicalForm (right, top_node->go_down (2));
+        if (left.Compare (right) == kCompareGreater) {
+            result << right << ',' << left;
+        } else {
+            result << left << ',' << right;
+        }
+    } else {
+        for (long k = 1L; k <= n_children; k++) {
+            if (k > 1L) {
+                result << ',';
+            }
+            SubtreeToCanonicalForm (result, top_node->go_down (k));
+        }
+    }
+    result << ')';
+}
+
 //__________________________________________________________________________________
 HBLObjectRef _Formula::GetTheMatrix (void) {
     if (theFormula.countitems()==1) {
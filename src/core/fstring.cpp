@@ -498,14 +498,16 @@ HBLObjectRef _FString::RerootTree (HBLObjectRef root, HBLObjectRef cache) {
 
 HBLObjectRef _FString::Evaluate (_hyExecutionContext* context) {
     if (has_data ()) {
-        _String     s (get_str());
-        _Formula    evaluator (s, (_VariableContainer*)context->GetContext());
-        HBLObjectRef   evalTo = evaluator.Compute(0,(_VariableContainer*)context->GetContext());
+        _VariableContainer * eval_context = (_VariableContainer*)context->GetContext();
+        _ParsedFormula     * evaluator    = FetchParsedFormula (get_str(), eval_context);
+        HBLObjectRef         evalTo       = evaluator->formula->Compute(0,eval_context);
 
         if (evalTo && !terminate_execution) {
             evalTo->AddAReference();
+            DeleteObject (evaluator);
             return evalTo;
         }
+        DeleteObject (evaluator);
     }
     return new _MathObject;
 }
@@ -67,7 +67,8 @@ namespace hyphy_global_objects {
   
   enum kNotificationType {
     kNotificationTypeChange,
-    kNotificationTypeDelete
+    kNotificationTypeDelete,
+    kNotificationTypePatternsChange
   };
   
   /**
@@ -104,7 +105,7 @@ namespace hyphy_global_objects {
     }
   }
   
-  void    _NotifyDataFilterListeners (const long index, kNotificationType event_type) {
+  void    _NotifyDataFilterListeners (const long index, kNotificationType event_type, _SimpleList const * changed_patterns = nil) {
     _List * listeners = (_List*)_data_filter_listeners.GetDataByKey( (BaseRef) index);
     if (listeners) {
       
@@ -116,7 +117,7 @@ namespace hyphy_global_objects {
         if (_LikelihoodFunction* lf = dynamic_cast<_LikelihoodFunction*> (this_listener)) {
             //StringToConsole(_String("_NotifyDataFilterListeners ") & index & " " & (long)lf & "\n");
        
-          if (event_type == kNotificationTypeChange) {
+          if (event_type == kNotificationTypeChange || event_type == kNotificationTypePatternsChange) {
             buffered_updates << lf;
             //lf->Rebuild();
                /* 20170328 SLKP: this COULD MODIFY the 'listeners' object, hence the buffering */
@@ -127,7 +128,11 @@ namespace hyphy_global_objects {
       }
         
         for (unsigned long k = 0UL; k < buffered_updates.lLength; k++) {
-            ((_LikelihoodFunction*)buffered_updates.GetItem (k)) -> Rebuild();
+            if (event_type == kNotificationTypePatternsChange) {
+                ((_LikelihoodFunction*)buffered_updates.GetItem (k)) -> UpdatePatterns (index, *changed_patterns);
+            } else {
+                ((_LikelihoodFunction*)buffered_updates.GetItem (k)) -> Rebuild();
+            }
         }
     }
   }
@@ -294,6 +299,13 @@ namespace hyphy_global_objects {
     return _data_filters.Find (&name);
   }
   
+  void    NotifyDataFilterSitesChanged (long index, _SimpleList const * changed_patterns) {
+    if (_data_filters.IsValidIndex (index)) {
+      _NotifyDataFilterListeners (index, changed_patterns ? kNotificationTypePatternsChange : kNotificationTypeChange, changed_patterns);
+      _SetDataFilterParameters (*GetFilterName (index), *GetDataFilter (index));
+    }
+  }
+  
   long    StoreDataFilter (_String const& name, _DataSetFilter* object, bool handle_errors) {
     
     if (name.IsValidIdentifier(fIDAllowCompound)) {
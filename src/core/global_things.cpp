@@ -44,6 +44,9 @@
 #include "batchlan.h"
 #include "mersenne_twister.h"
 #include "global_object_lists.h"
+#include "compressed_input.h"
+#include "local_workers.h"
+#include "mpi_node_layout.h"
 
 #if defined   __UNIX__ 
     #include <unistd.h>
@@ -228,6 +231,19 @@ namespace hy_global {
         }
         return daFile;
     }
+
+    //____________________________________________________________________________________
+
+    FILE *      doDataFileOpen (const char * fileName) {
+        if (fileName) {
+            // gzip-compressed data files are decompressed transparently when read
+            FILE * daFile = OpenCompressedInput (fileName);
+            if (daFile) {
+                return daFile;
+            }
+        }
+        return doFileOpen (fileName, "rb");
+    }
     //____________________________________________________________________________________
    
 
@@ -258,6 +274,7 @@ namespace hy_global {
             &last_file_path,
             &mpi_node_id,
             &mpi_last_sent_message,
+            &mpi_job_arguments,
             &mpi_node_count,
             &error_report_format_expression,
             &error_report_format_expression_stack,
@@ -313,6 +330,7 @@ namespace hy_global {
         
         using namespace hyphy_global_objects;
         
+        ClearParsedCodeCache();
         executionStack.Clear();
         loadedLibraryPaths.Clear(true);
         _HY_HBL_Namespaces.Clear();
@@ -353,6 +371,8 @@ namespace hy_global {
         MPI_Comm_size   (MPI_COMM_WORLD, &hy_mpi_node_count);
         EnvVariableSet  (mpi_node_count, new _Constant (hy_mpi_node_count), false);
         EnvVariableSet  (mpi_node_id, new _Constant (hy_mpi_node_rank), false);
+#else
+        SetLocalWorkerEnvironment ();
 #endif
     }
 
@@ -431,6 +451,10 @@ namespace hy_global {
         if (hy_env::cli_env_settings.nonempty()) {
             _ExecutionList (hy_env::cli_env_settings).Execute();
         }
+#ifdef __HYPHYMPI__
+        ConfigureMPINodeLayout ();
+#endif
+        ConfigureLocalWorkers ();
         return hy_error_log_file && hy_message_log_file;
     }
     
@@ -452,6 +476,7 @@ namespace hy_global {
         ReportWarning ("PurgeAll was successful");
         if (hy_mpi_node_rank == 0) {
             fflush (stdout);
+            MPIDiscardOutstandingReplies ();
             
             for (long count = 1; count < hy_mpi_node_count; count++) {
                 ReportWarning (_String ("Sending shutdown command to node ") & count & '.');
@@ -460,6 +485,7 @@ namespace hy_global {
         }
 #else
         fflush (stdout);
+        ShutdownLocalWorkers ();
 #endif
         
         
@@ -478,7 +504,9 @@ namespace hy_global {
         
         
 #ifdef  __HYPHYMPI__
+        ReleaseSharedDataSets ();
         // MPI_Barrier (MPI_COMM_WORLD);
+        MPIFinishCommunication ();
         ReportWarning ("Calling MPI_Finalize");
     #ifdef __USE_ABORT_HACK__
             MPI_Abort(MPI_COMM_WORLD,0);
@@ -715,6 +743,15 @@ namespace hy_global {
             currentExecutionList->ReportAnExecutionError(message, true);
             return;
         }
+        
+        if (!force_exit && RunningWorkerJob()) {
+            // return the error to the master instead of terminating the node (see ExecuteWorkerJob);
+            // the master reports it if it can not recover
+            if (DeferWorkerJobFailure (message)) {
+                return; // raised once the parallel region has ended
+            }
+            throw _WorkerJobFailure (message);
+        }
             
     #ifdef  __HEADLESS__
         if (globalInterfaceInstance) {
@@ -741,6 +778,7 @@ namespace hy_global {
         if (hy_mpi_node_rank > 0) {
             errMsg = ConstructAnErrorMessage (message);
             fprintf (stderr, "HYPHYMPI terminated.\n%s\n\n", errMsg.get_str());
+            ReleaseSharedDataSets ();
             MPI_Abort (MPI_COMM_WORLD,1);
             abort   ();
         } else {
@@ -759,6 +797,7 @@ namespace hy_global {
     #endif
     #ifdef __HYPHYMPI__
             if (hy_mpi_node_rank==0) {
+                ReleaseSharedDataSets ();
                 MPI_Abort (MPI_COMM_WORLD,1);
             }
     #endif
@@ -785,6 +824,9 @@ namespace hy_global {
     #endif
     #ifdef __HYPHYMPI__
       theMessage <<  "(MPI)";
+    #endif
+    #ifdef __HYPHYZLIB__
+      theMessage <<  "(zlib)";
     #endif
      theMessage << " for ";
     #ifdef __UNIX__
@@ -259,6 +259,9 @@ _String const
     
     lib_directory                                   ("HYPHY_LIB_DIRECTORY"),
         // is set to the library directory for standard library searchers; can be set via a CL argument (LIBPATH)
+    local_worker_count                              ("LOCAL_WORKER_COUNT"),
+        // [non-MPI builds] the number of forked local worker processes which serve as MPI nodes
+        // for MPISend/MPIReceive; defaults to the number of CPUs if > 1, 0 disables local workers
     matrix_element_column                           ("_MATRIX_ELEMENT_COLUMN_"),
     matrix_element_row                              ("_MATRIX_ELEMENT_ROW_"),
     matrix_element_value                            ("_MATRIX_ELEMENT_VALUE_"),
@@ -270,8 +273,25 @@ _String const
         // [MPI only] the ID (0 = master, etc) for teh current process
     mpi_node_count                                  ("MPI_NODE_COUNT"),
         // [MPI only] the count of MPI nodes (master + slaves)
+    mpi_discard_replies                             ("MPI_DISCARD_REPLIES"),
+        // [MPI only] SetParameter (MPI_DISCARD_REPLIES, node, stop) makes MPIReceive drop the replies to
+        // all jobs sent to 'node' so far; if 'stop' is non-zero, a local worker is also terminated
+        // (see LocalWorkerTerminate), so that the next job sent to it starts a fresh worker
     mpi_last_sent_message                           ("MPI_LAST_SENT_MSG"),
         // [MPI only] the contents of the last message sent by the current node
+    mpi_job_arguments                               ("MPI_JOB_ARGUMENTS"),
+        // [MPI only] the "arguments" value of the binary job (MPISend with a dictionary) being executed by the current node
+    mpi_receive_spin_count                          ("MPI_RECEIVE_SPIN_COUNT"),
+        // [MPI only] how many times to poll for an incoming message before sleeping between polls (default 1000)
+    mpi_receive_max_sleep                           ("MPI_RECEIVE_MAX_SLEEP"),
+        // [MPI only] the longest interval (in microseconds, default 1000) between polls for an incoming message;
+        // the interval starts at 1 and doubles after every poll; 0 blocks in MPI_Wait instead
+    mpi_share_data_sets                             ("MPI_SHARE_DATA_SETS"),
+        // [MPI only] if non-zero (default), MPI ranks on the same host keep one shared, read-only copy
+        // of the characters of each large data set they receive (see _SharedDataSetClaim)
+    mpi_share_node_cores                            ("MPI_SHARE_NODE_CORES"),
+        // [MPI only] if non-zero (default), MPI ranks on the same host divide its cores among themselves
+        // at startup (see ConfigureMPINodeLayout); must be set with ENV= on the command line to take effect
     nexus_file_tree_matrix                          ("NEXUS_FILE_TREE_MATRIX"),
         // the tree matrix read from the last valid NEXUS TREE block
     normalize_sequence_names                        ("NORMALIZE_SEQUENCE_NAMES"),
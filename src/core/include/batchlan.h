@@ -479,6 +479,45 @@ _ElementaryCommand               * makeNewCommand       (long);
 
 //____________________________________________________________________________________
 
+class   _ParsedFormula: public BaseObj
+{
+    /**
+        A reference counted holder for an expression parsed from HBL source text
+        (e.g. the argument of Eval), together with the variable bindings
+        (variable slot and name) that were resolved at parse time, and the
+        context it was parsed in.
+     
+        Parsed expressions are cached by source text, so that repeated evaluation
+        of identical text can skip parsing; when a cached expression is used, its
+        identifiers are resolved again relative to the context of the use (Rebind),
+        and a copy with the new bindings is made if these differ (SetBindings).
+    */
+    
+public:
+    _ParsedFormula (_Formula * f) : formula (f) {}
+    virtual ~_ParsedFormula (void);
+    
+    virtual BaseRef makeDynamic (void) const;
+    virtual void    Duplicate   (BaseRefConst);
+    // the terms of the formula are copied, so that the bindings of a copy can be changed
+    
+    bool            Rebind       (_VariableContainer const*, _SimpleList&) const;
+    // store the slots of the variables bound to in the given context in the second argument;
+    // false if some identifier does not resolve to a variable
+    void            SetBindings  (_SimpleList const&);
+    
+    _Formula    *   formula;
+    _SimpleList     bound_slots;
+    _List           bound_names;
+    _String         context_name;
+    
+private:
+    _ParsedFormula (_ParsedFormula const&);
+    _ParsedFormula& operator = (_ParsedFormula const&);
+};
+
+//____________________________________________________________________________________
+
 #ifdef __HYPHYMPI__
 #include <mpi.h>
 
@@ -494,7 +533,12 @@ _ElementaryCommand               * makeNewCommand       (long);
 
 void     ReportMPIError         (int, bool);
 void     MPISendString          (_String const&,long,bool=false);
-_String* MPIRecvString          (long,long&);
+_String* MPIRecvString          (long,long&,hyFloat = 0.);
+  // the third argument is a timeout (in seconds; <= 0 to wait indefinitely); nil is returned if no message arrived in time
+void     MPIFinishCommunication (void);
+  // complete pending sends and cancel posted receives; must be called before MPI_Finalize
+void     MPIDiscardOutstandingReplies (void);
+  // [master] receive and drop the replies to jobs sent by MPISend which MPIReceive has not returned (or was told to discard)
 
 #endif
 //____________________________________________________________________________________
@@ -628,6 +672,8 @@ extern  _Trie                       _HY_ValidHBLExpressions,
                                     _HY_HBL_KeywordsPreserveSpaces;
 
 extern  long                        matrixExpCount;
+extern  unsigned long               parseTimeSideEffects;
+            // incremented every time parsing HBL has global side effects (e.g. defining a function)
  
 
 
@@ -674,6 +720,22 @@ ProcessDictionaryArgument (_String* data, _VariableContainer* theP, _ExecutionLi
 const _String GetStringFromFormula         (_String const*,_VariableContainer*);
 void    ExecuteBLString              (_String&,_VariableContainer*);
 
+_ExecutionList*
+        FetchParsedCode              (_String const&, _String const*);
+void    StoreParsedCode              (_String const&, _String const*, _ExecutionList*);
+_ParsedFormula*
+        FetchParsedFormula           (_String const&, _VariableContainer const*);
+void    ClearParsedCodeCache         (void);
+/*
+    content addressed caches of parsed HBL code, keyed on (namespace, source text) for
+    execution lists (not cached in generated namespaces, e.g. those of lfunctions), and on
+    source text for expressions, which are rebound to the context they are used in.
+    FetchParsedCode returns a referenced execution list (or nil on a miss),
+    StoreParsedCode adds a reference to the stored list, and FetchParsedFormula
+    always returns a referenced holder (parsed anew if needed);
+    callers release their references with DeleteObject.
+ */
+
 void    SerializeModel               (_StringBuffer &,long,_AVLList* = nil, bool = false);
 bool    Get_a_URL                    (_String&,_String* = nil);
 
@@ -0,0 +1,66 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef __HYCOMPRESSEDINPUT__
+#define __HYCOMPRESSEDINPUT__
+
+#include <stdio.h>
+
+namespace hy_global {
+
+  /**
+   If the file located at file_path is gzip-compressed, open it for reading
+   as a stdio stream which returns the decompressed data. Decompression runs
+   on a background thread, which fills a ring of buffers ahead of the reader.
+
+   The stream supports fseek/ftell/rewind in terms of uncompressed offsets;
+   seeking backwards restarts decompression from the beginning of the file,
+   and seeking relative to the end decompresses the rest of the file once
+   to find its size. The stream is released with fclose.
+
+   @param file_path the path of the file to open
+
+   @return the decompressing stream, or nil if the file is not gzip-compressed,
+   could not be opened, or HyPhy was built without zlib support
+   */
+  FILE*   OpenCompressedInput       (const char * file_path);
+
+}
+
+#endif
@@ -162,11 +162,17 @@ public:
 
   _SimpleList const &DuplicateMap(void) const { return theMap; }
 
+  _String const &GetTreeString(void) const { return treeString; }
+  void SetTreeString(_String const &tree) { treeString = tree; }
+  // the tree string read from the same file as this data set (empty if none)
+
   friend class _DataSetFilter;
   friend _DataSet *ReadDataSetFile(FILE *, char, _String *, _String *,
                                    _String *, _TranslationTable *,
                                    _ExecutionList *);
   friend long ProcessLine(_String &s, FileState *fs, _DataSet &ds);
+  friend bool ReadBinaryDataSet(FILE *, _DataSet &, _String *, _TranslationTable const *);
+  friend class _SharedDataSetClaim;
 
   static _DataSet *Concatenate(const _SimpleList &);
   static _DataSet *Combine(const _SimpleList &);
@@ -186,6 +192,15 @@ public:
   void SetNoSpecies(unsigned long n) { noOfSpecies = n; }
   void ResetIHelper(void);
 
+  _SimpleList PatternClasses(_SimpleList const &species) const;
+  /* for every unique site (pattern) of the data set, return
+     the index of the first pattern which has the same characters in all of
+     the given species; sites which map to the same class are identical when
+     restricted to these species. Used by _DataSetFilter::SetFilter to compress
+     sites without comparing characters; the classes for a few recently used
+     species sets are cached (and discarded by Finalize and Clear). The cache
+     is locked, so filters can be built concurrently. */
+
 private:
   _SimpleList theMap,
       theFrequencies; // remapping vector, and the counter of frequencies
@@ -195,10 +210,13 @@ private:
   _TranslationTable *theTT; // translation Table, if any
 
   _List theNames; // Names of species
+  _String treeString; // the tree which came with the data (if any)
   FILE *streamThrough;
 
   _DSHelper *dsh;
   bool useHorizontalRep;
+
+  mutable _List patternClassCache; // (sorted species list, pattern classes) pairs, most recent last
 };
 
 void ReadNextLine(FILE *fp, _String *s, FileState *fs, bool append = false,
@@ -211,8 +229,60 @@ _DataSet *ReadDataSetFile(FILE *, char = 0, _String * = nil, _String * = nil,
 
 
 bool StoreADataSet(_DataSet *, _String *);
+
+bool ReadBinaryDataSet(FILE *, _DataSet &, _String * = nil, _TranslationTable const * = nil);
+/* if the file is a binary data set container (written with
+   DATA_FILE_PRINT_FORMAT = 13), load it into the (empty) data set and return
+   true; otherwise rewind the file and return false. Malformed containers are
+   reported by throwing a _String, as ReadDataSetFile does.
+   As in the text reader, IS_TREE_PRESENT_IN_DATA is set in the given namespace.
+   A non-default translation table must match the one stored in the container. */
 void    ReadNexusFile               (FileState& fState, FILE*f, _DataSet& result);
 
+class _SharedDataSetClaim {
+  /* MPI worker ranks which run on the same host keep a single
+     read-only copy of the characters of each (large) data set they receive as
+     text, e.g. with a likelihood function, in a POSIX shared memory segment
+     named after a hash of the text (see dataset_shared.cpp). Names, the site
+     map and the filters built on the data set stay private to each rank.
+
+     ReadDataSetFile calls Attach before parsing a string: if another rank has
+     published the same data, Attach maps it into 'result' (and extracts the
+     HYPHY block of a NEXUS string) and returns true; if another rank is still
+     reading it, Attach waits for it. Otherwise this rank may claim the data set,
+     and then calls Publish with the parsed result, which copies it into the
+     segment and replaces the private characters with the mapped ones. A claim
+     which is not published (e.g. because of a parse error) is abandoned by the
+     destructor; ranks waiting for it then parse the text themselves.
+
+     Only used on MPI worker ranks which share the host with other ranks, for
+     strings of at least kSharedDataSetMinimumLength characters read with the
+     default translation table; set MPI_SHARE_DATA_SETS to 0 to disable. */
+
+public:
+  _SharedDataSetClaim(void);
+  ~_SharedDataSetClaim(void);
+
+  bool Attach(_String const &, _String *, _TranslationTable const *,
+              _DataSet &);
+  void Publish(_DataSet &);
+
+private:
+  _SharedDataSetClaim(_SharedDataSetClaim const &);
+  _SharedDataSetClaim &operator=(_SharedDataSetClaim const &);
+
+  bool Map(int, _DataSet &);
+
+  _String name;       // the segment claimed by this rank (empty if none)
+  int descriptor;     // the descriptor of the claimed segment
+  void *header;       // the header of the claimed segment (mapped read-write)
+};
+
+void ReleaseSharedDataSets(void);
+/* remove the names of the shared data set segments created by this process
+   (ranks which have mapped them keep their mappings); called from
+   GlobalShutdown, and before MPI_Abort, which does not return. */
+
 
 extern _String nexusBFBody;
 extern _DataSet *lastNexusDataMatrix;
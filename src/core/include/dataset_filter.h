@@ -52,6 +52,11 @@ enum _hy_dataset_filter_ambiguity_resolution {
   kAmbiguityHandlingSkip
 };
 
+enum _hy_dataset_filter_distance_metric {
+  kDistanceMetricProportion,
+  kDistanceMetricTN93
+};
+
 enum _hy_dataset_filter_unique_match {
   kUniqueMatchExact = 0L,
   kUniqueMatchExactOrGap = 1L,
@@ -77,6 +82,27 @@ public:
   void CopyFilter(_DataSetFilter const *);
   void SetFilter(_DataSet const *, unsigned char, _SimpleList &, _SimpleList &,
                  bool isFilteredAlready = false);
+
+  /**
+   Replace the sites of the filter in place, reusing the rows of the site
+   patterns which still occur among the new sites; intended for sliding
+   windows, where consecutive site ranges share most of their patterns.
+
+   Patterns present before and after the update keep their indices; rows
+   of patterns which no longer occur are given to new patterns, and the
+   remaining gaps are filled by moving the last patterns down.
+
+   @param sites the new sites (indices into the underlying data set)
+   @param changed_patterns receives the sorted indices of the pattern rows
+   whose contents changed (new patterns and moved patterns)
+
+   @return false (and leave the filter unchanged) if the filter can not be
+   updated in place (numeric filters, filters with excluded characters, or
+   when patterns with deletions are being skipped); the caller should then
+   rebuild the filter with SetFilter
+   */
+  bool UpdateSites(_SimpleList const &sites, _SimpleList &changed_patterns);
+
   void SetExclusions(_String const&, bool = true);
 
   _String *GetExclusions(void) const;
@@ -112,6 +138,23 @@ public:
                              _hy_dataset_filter_ambiguity_resolution =
                                  kAmbiguityHandlingResolveFrequencyAware) const;
 
+  /**
+   Compute distances between all pairs of sequences in the filter
+
+   @param metric the proportion of differing sites (p-distance) or the
+   Tamura-Nei (1993) distance (nucleotide data only)
+   @param resolution_option how to count sites with ambiguous characters
+   (same as for ComputePairwiseDifferences)
+   @param frequencies nucleotide frequencies for TN93 (if nil, use the
+   empirical frequencies in the filter)
+
+   @return a symmetric species x species matrix; pairs without comparable
+   sites, or whose distance is undefined are assigned 1000.
+   */
+  _Matrix *ComputePairwiseDistances(_hy_dataset_filter_distance_metric metric,
+                                    _hy_dataset_filter_ambiguity_resolution resolution_option,
+                                    _Matrix const *frequencies = nil) const;
+
   BaseRefConst GetMap(void) const {
     return theNodeMap.lLength ? &theNodeMap : NULL;
   }
@@ -350,6 +393,9 @@ protected:
 
 private:
   void internalToStr(FILE *, _StringBuffer *);
+  void WriteBinary(FILE *) const;
+  // write the filtered data in the binary container format
+  // read by ReadBinaryDataSet (see dataset_binary.cpp)
   
   
    inline void retrieve_individual_site_from_raw_coordinates (_String & store, unsigned long site, unsigned long sequence) const {
@@ -215,6 +215,13 @@ public:
     void        ConvertFromSimple   (_AVLList const& variableIndex);
     void        ConvertFromSimpleList   (_SimpleList const& variableIndex);
     void        SimplifyConstants   (void);
+    _String*    CanonicalForm       (void);
+    /*
+        return a key which is the same for formulas that differ only in the
+        order of operands of commutative scalar operations (+ and *), e.g. 'kappa*t' and 't*kappa';
+        formulas which may involve non-scalar values get their usual string representation.
+        Used to share compiled formulas between equivalent cells of rate matrices.
+    */
     _Variable * Dereference         (bool, _hyExecutionContext* = _hyDefaultExecutionContext);
 
     hyFloat  ComputeSimple       (_SimpleFormulaDatum* stack, _SimpleFormulaDatum* varValues) ;
@@ -270,6 +277,7 @@ public:
 protected:
 
     void        SubtreeToString     (_StringBuffer & result, node<long>* top_node, int op_level, _List* match_names, _Operation* this_node_op, _hyFormulaStringConversionMode mode = kFormulaStringConversionNormal);
+    void        SubtreeToCanonicalForm  (_StringBuffer & result, node<long>* top_node) const;
     void        ConvertToTree       (bool err_msg = true);
     void        ConvertFromTree     (void);
     bool        CheckSimpleTerm     (HBLObjectRef);
@@ -138,6 +138,19 @@ namespace hyphy_global_objects {
    
    */
   
+  void    NotifyDataFilterSitesChanged (long index, _SimpleList const * changed_patterns);
+  
+  /**
+   Inform the likelihood functions which use this data set filter that its sites
+   were changed in place, and update the HBL variables (.sites, .site_freqs, etc)
+   which describe the filter
+   
+   @param index the direct referencing index for this object
+   @param changed_patterns if not nil, the filter was updated by _DataSetFilter::UpdateSites,
+          and only the listed pattern rows changed; otherwise the likelihood functions are rebuilt
+   
+   */
+  
   const _String* GetFilterName  (long index);
   
   /**
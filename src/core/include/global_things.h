@@ -131,6 +131,17 @@ namespace hy_global {
    @return the FILE handle or nil (if file does not exist or could not be open with the requested mode)
    */
   FILE*   doFileOpen                (const char * file_path, const char * mode , bool error = false);
+
+  /**
+   Open the data file (alignment, tree etc) located at file_path for reading;
+   gzip-compressed files are decompressed as they are read (see OpenCompressedInput),
+   other files are opened with doFileOpen (file_path, "rb")
+
+   @param file_path the path of the file to open
+
+   @return the FILE handle or nil (if file does not exist or could not be opened)
+   */
+  FILE*   doDataFileOpen            (const char * file_path);
   
   /**
    The omnibus clean-up function that attempts to deallocate all application memory
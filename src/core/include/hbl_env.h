@@ -156,6 +156,7 @@ namespace hy_env {
           assigned_seed,
           base_directory,
           lib_directory,
+          local_worker_count,
           directory_separator_char,
           path_to_current_bf,
           print_float_digits,
@@ -170,7 +171,13 @@ namespace hy_env {
           message_logging,
           mpi_node_id,
           mpi_node_count,
+          mpi_discard_replies,
           mpi_last_sent_message,
+          mpi_job_arguments,
+          mpi_receive_spin_count,
+          mpi_receive_max_sleep,
+          mpi_share_data_sets,
+          mpi_share_node_cores,
           error_report_format_expression,
           error_report_format_expression_string,
           error_report_format_expression_stack,
@@ -241,13 +241,22 @@ public:
   _StringBuffer& operator<<(const _String & buffer);
 
   /**
-   * Append a single char to the buffer
+   * Append a single char to the buffer; the case when there is spare capacity
+   * is inlined, because data file readers call this for every character
    * @param buffer append this character
    *  Revision history
    - SLKP 20170614 reviewed while porting from v3 branch
      [CHANGE-NOTE SLKP 20170614 all << operators return *this for chaining]
    */
-  _StringBuffer& operator<<(const char);
+  _StringBuffer& operator<<(const char c) {
+    if (s_length < sa_length) {
+      s_data[s_length++] = c;
+      s_data[s_length] = '\0';
+    } else {
+      this->PushChar(c);
+    }
+    return *this;
+  }
 
   /**
    * Append all chars in the string buffer to this string
@@ -194,6 +194,7 @@ public:
 
     bool        PreCompute      (void);
     void        PostCompute     (void);
+    bool        AffectedDependents (_SimpleList&) const;
     virtual
     hyFloat     Compute         (void);
 
@@ -254,6 +255,10 @@ public:
     long        SequenceCount           (long);
     unsigned long        SiteCount               (void) const;
     void        Rebuild                 (bool rescan_parameters = false);
+    void        UpdatePatterns          (long, _SimpleList const&);
+    // the data filter with the given global index had some of its
+    // patterns replaced in place (see _DataSetFilter::UpdateSites); the second
+    // argument lists the pattern rows whose contents changed
     virtual void        SerializeLF             (_StringBuffer&, char=0, _SimpleList* = nil, _SimpleList* = nil);
     _Formula*   HasComputingTemplate    (void) const{
         return computingTemplate;
@@ -322,6 +327,8 @@ protected:
 
     _Matrix*        PairwiseDistances       (long index);
     void            CheckDependentBounds    (void);
+    void            MapDependentsToIndependents (void);
+    void            ClearDependentMaps      (void);
     void            AllocateSiteResults     (void);
     void            ZeroSiteResults         (void);
     // 20090211: A utility function to reset site results.
@@ -340,8 +347,13 @@ protected:
     virtual void            ScanAllVariables        (void);
     // internal function to scan all the variables in
 
-    void            OptimalOrder            (long, _SimpleList&, const _SimpleList* clone = nil);
+    void            OptimalOrder            (long, _SimpleList&, const _SimpleList* clone = nil, const _SimpleList* changed = nil);
     // determine the optimal order of compuation for a block
+    // if 'changed' is given, the second argument holds the existing order, which is updated
+    // for the listed pattern rows, if possible (see ReorderChangedPatterns)
+
+    bool            ReorderChangedPatterns  (long, _SimpleList&, _SimpleList const&) const;
+    // reinsert changed pattern rows into an existing summation order
 
     hyFloat      ComputeBlock            (long, hyFloat* siteResults = nil, long currentRateClass = -1, long = -1, _SimpleList* = nil);
     // 20090224: SLKP
@@ -414,6 +426,10 @@ protected:
     bool            SendOffToMPI                (long);
     void            InitMPIOptimizer            (void);
     void            CleanupMPIOptimizer         (void);
+    hyFloat         MPIPartitionCost            (long);
+    // the relative cost of evaluating a partition (site patterns x states^2 x branches x rate classes)
+    void            RebalanceMPIPartitions      (void);
+    // in the partition optimizer mode, reassign partitions to nodes based on measured evaluation times
     void            ComputeBlockInt1            (long,hyFloat&,_TheTree*,_DataSetFilter*, char);
     void            CheckStep                   (hyFloat&, const _Matrix&, _Matrix* selection = nil);
     void            GetGradientStepBound        (_Matrix&, hyFloat &, hyFloat &, long* = nil);
@@ -525,6 +541,14 @@ protected:
                     indexCat,
                     *nonConstantDep,
                     blockDependancies,
+                    dependentUpdateKeys,
+                    dependentsAlwaysUpdated,
+    /* these lists map each independent variable (sorted indices in
+        dependentUpdateKeys) to the positions of non-constant dependent variables
+        (stored in dependentUpdateLists) which need to be recomputed when it changes;
+        dependentsAlwaysUpdated lists the dependents which rely on something that
+        is not an independent parameter of this LF (e.g. a category variable)
+    */
                     parameterTransformationFunction;
     /* 20110718: SLKP this list holds the index of the parameter interval mapping function
         used during optimization */
@@ -566,6 +590,7 @@ protected:
                      */
                     indVarsByPartition,
                     depVarsByPartition,
+                    dependentUpdateLists,
                     *variable_to_node_map;
 
 
@@ -0,0 +1,170 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef __HYLOCALWORKERS__
+#define __HYLOCALWORKERS__
+
+#include "hy_strings.h"
+#include "hy_string_buffer.h"
+
+namespace hy_global {
+
+  /**
+   Thrown by HandleApplicationError when an error occurs while a worker node runs
+   a job (see ExecuteWorkerJob), so that the error can be returned to the master
+   instead of terminating the node.
+   */
+  class _WorkerJobFailure {
+    public:
+      _WorkerJobFailure (_String const & error) : error (error) {}
+      _String error;
+  };
+
+  /**
+   @return true while the current process is running a job as a worker node (see ExecuteWorkerJob)
+   */
+  bool            RunningWorkerJob          (void);
+
+  /**
+   Called by HandleApplicationError for an error raised by a job: if the error
+   occurred inside an OpenMP parallel region, where throwing _WorkerJobFailure
+   would terminate the process, record it (the first one, if several threads
+   fail) and stop the execution list instead.
+
+   @return true if the error was recorded, false if it can be thrown right away
+   */
+  bool            DeferWorkerJobFailure     (_String const & error);
+
+  /**
+   Throw the _WorkerJobFailure recorded by DeferWorkerJobFailure, if any, once
+   the parallel region which raised it has ended; called after each command
+   of an execution list and at the end of a job.
+   */
+  void            RaiseDeferredWorkerJobFailure (void);
+
+  /**
+   Run a job received by a worker node (an MPI node other than the master, or
+   a local worker process): a likelihood function in NEXUS format, which
+   is read and (possibly) optimized, HBL code, which is executed, or a binary
+   job (see EncodeWorkerValue) -- a dictionary with the HBL code to execute
+   ("code") and a value to make available to it as MPI_JOB_ARGUMENTS ("arguments").
+
+   @param message the job
+   Errors raised by the job are returned to the master as a failure reply
+   (see EncodeWorkerFailure); the state of the node is then discarded (by
+   the following ResetWorkerState, regardless of PRESERVE_SLAVE_NODE_STATE),
+   because the job may have stopped halfway through changing it.
+
+   @return the string to send back to the master (the value of MPI_NEXUS_FILE_RETURN,
+   or the serialized likelihood function named by LIKE_FUNC_NAME_TO_SEND_BACK for
+   likelihood functions; the value returned by the code otherwise, in binary form
+   for binary jobs; a failure reply if the job failed), or nil if the node should
+   stop (the error has been reported)
+   */
+  _String*        ExecuteWorkerJob          (_String & message);
+
+  /**
+   Discard the state created by the last job on a worker node, unless the job
+   set PRESERVE_SLAVE_NODE_STATE.
+
+   @param base_directory the path to restore as the current directory
+   */
+  void            ResetWorkerState          (_String const & base_directory);
+
+  /**
+   Decide how many local worker processes can be used as MPI nodes by a build
+   without MPI; called once by GlobalStartup, after command line settings have
+   been applied. The count is given by LOCAL_WORKER_COUNT if set, and defaults to
+   the number of CPUs if there is more than one (0 turns the backend off).
+
+   When enabled, MPI_NODE_COUNT is set to the number of workers + 1, and
+   MPISend/MPIReceive exchange messages between the master (node 0) and forked
+   worker processes over pipes. Each worker is forked when the first message is
+   sent to it, and handles jobs the same way MPI nodes do (see ExecuteWorkerJob).
+   */
+  void            ConfigureLocalWorkers     (void);
+
+  /**
+   Set MPI_NODE_COUNT and MPI_NODE_ID for the local worker backend (if enabled);
+   called whenever global variables are reinitialized.
+   */
+  void            SetLocalWorkerEnvironment (void);
+
+  /**
+   @return the number of local workers (0 if the backend is not in use)
+   */
+  long            LocalWorkerCount          (void);
+
+  /**
+   Send a message from the master to a local worker (starting the worker if needed);
+   an empty message shuts the worker down. Errors are reported by throwing a _String.
+
+   @param node the worker node (1 to LocalWorkerCount())
+   @param message the message to send
+   */
+  void            LocalWorkerSend           (long node, _String const & message);
+
+  /**
+   Wait for a message from a local worker. Errors (including a worker which
+   terminated without replying) are reported by throwing a _String.
+
+   @param node the worker to receive from, or -1 to accept a message from any worker
+   @param sender receives the node which sent the message (or which terminated;
+   -1 if there was no message)
+   @param timeout how long to wait (in seconds); wait indefinitely if <= 0
+   @return the message (owned by the caller), or nil if the wait timed out
+   */
+  _String*        LocalWorkerReceive        (long node, long & sender, hyFloat timeout = 0.);
+
+  /**
+   Terminate a local worker (e.g. one which stopped responding) without waiting
+   for it to finish its jobs; the next message sent to the node starts a new worker.
+
+   @param node the worker node (1 to LocalWorkerCount())
+   */
+  void            LocalWorkerTerminate      (long node);
+
+  /**
+   Shut down all running local workers and wait for them to exit.
+   */
+  void            ShutdownLocalWorkers      (void);
+
+}
+
+#endif
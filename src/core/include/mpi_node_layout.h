@@ -0,0 +1,83 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef __HYMPINODELAYOUT__
+#define __HYMPINODELAYOUT__
+
+namespace hy_global {
+
+  /**
+   Divide the cores of each host among the MPI ranks which run on it (as
+   determined by MPI_Comm_split_type), so that co-resident ranks do not
+   oversubscribe cores with their OpenMP threads. Each rank gets a contiguous
+   block of the CPUs available to the process, ordered by NUMA domain, is pinned
+   to that block (on Linux), and runs at most as many threads as there are CPUs
+   in the block. If the launcher has already bound the ranks of the host to
+   sets of CPUs which do not overlap, that binding is kept and only the thread
+   count is adjusted; a restricted set shared by the ranks is still divided.
+
+   The layout of all ranks is written to the message log of the master node.
+   Set MPI_SHARE_NODE_CORES to 0 to leave the thread count and affinity alone.
+
+   This is a collective call; all ranks must make it (from GlobalStartup).
+   Does nothing in non-MPI builds.
+   */
+  void    ConfigureMPINodeLayout (void);
+
+  /**
+   @return the number of ranks of this MPI job (including this one) which run
+   on the same host as this rank (1 before ConfigureMPINodeLayout or in non-MPI builds)
+   */
+  long    MPIHostRankCount       (void);
+
+  /**
+   @return the number of ranks counted by MPIHostRankCount other than the master
+   (node 0), i.e. the ranks on this host which run jobs
+   */
+  long    MPIHostWorkerCount     (void);
+
+  /**
+   @return an identifier which is shared by the ranks of this MPI job running on
+   the same host, and is distinct from those of other jobs on it (the process id
+   of the first of these ranks); 0 before ConfigureMPINodeLayout or in non-MPI builds
+   */
+  long    MPIHostSessionID       (void);
+}
+
+#endif
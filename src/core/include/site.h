@@ -85,6 +85,10 @@ public:
   // reference constructor
   _Site(long);
 
+  // a site whose (read-only) characters are owned by 'image', e.g. a shared
+  // memory mapping (see _SharedDataSetClaim); the site holds a reference to it
+  _Site(char const *, unsigned long, BaseObj *image);
+
   // destructor
   virtual ~_Site(void);
 
@@ -102,6 +106,7 @@ private:
   long refNo; // if this site contains a reference to another one
   // if refNo is negative, then shows whether the definition of this datatype
   // has been completed
+  BaseObj *image; // the owner of the characters, if they are not owned by the site
 };
 
 #endif
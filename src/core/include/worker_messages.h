@@ -0,0 +1,127 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+
+#ifndef __HYWORKERMESSAGES__
+#define __HYWORKERMESSAGES__
+
+#include "hy_strings.h"
+#include "mathobj.h"
+
+class _AssociativeList;
+
+namespace hy_global {
+
+  /**
+   Serialize an HBL value into a binary message for exchange between MPI nodes
+   (or local workers). Numbers, strings, numeric matrices (as raw arrays of doubles)
+   and dictionaries of these are stored in binary form; other values (e.g. trees or
+   formula matrices) are stored as their string representation, and are rebuilt
+   with Eval by the receiving node.
+
+   Messages use the native byte order and floating point format, i.e. all nodes
+   are assumed to run on the same architecture.
+
+   @param value the value to serialize (nil is treated as 0)
+   @return the message (owned by the caller)
+   */
+  _String*        EncodeWorkerValue         (HBLObjectRef value);
+
+  /**
+   @return true if the message was produced by EncodeWorkerValue (rather than
+   being HBL code or a string result)
+   */
+  bool            IsWorkerValueMessage      (_String const & message);
+
+  /**
+   Build the reply sent to the master by a node whose job failed with an error
+   (see ExecuteWorkerJob), so that the master can recover, e.g. by running the
+   job elsewhere, rather than wait for a reply which will never come.
+
+   @param error the error message
+   @return the message (owned by the caller)
+   */
+  _String*        EncodeWorkerFailure       (_String const & error);
+
+  /**
+   @return true if the message was produced by EncodeWorkerFailure
+   */
+  bool            IsWorkerFailureMessage    (_String const & message);
+
+  /**
+   @return the error message carried by a message produced by EncodeWorkerFailure
+   */
+  const _String   DecodeWorkerFailure       (_String const & message);
+
+  /**
+   Rebuild the value serialized by EncodeWorkerValue. A malformed message is
+   reported by throwing a _String.
+
+   @param message the message to decode (IsWorkerValueMessage must be true)
+   @return the value (owned by the caller)
+   */
+  HBLObjectRef    DecodeWorkerValue         (_String const & message);
+
+  /**
+   Serialize a binary job ({"code" : ..., "arguments" : {key : value}}) for 'node'.
+   Arguments whose value is the same as the one last sent to this node under the
+   same key are not sent again; the node substitutes its stored copy, so that
+   (large) inputs shared by many jobs, e.g. model mappings, are shipped once and
+   only the arguments that change travel with each job.
+
+   @param job  the job to serialize
+   @param node the receiving node (a node < 1 disables argument reuse)
+   @return the message (owned by the caller); decode it with DecodeWorkerJob
+   */
+  _String*        EncodeWorkerJob           (_AssociativeList * job, long node);
+
+  /**
+   Rebuild the job serialized by EncodeWorkerJob, and store its arguments for
+   reuse by later jobs. A malformed message is reported by throwing a _String.
+   */
+  HBLObjectRef    DecodeWorkerJob           (_String const & message);
+
+  /**
+   Forget which arguments were sent to 'node' (e.g. because the node was restarted)
+   */
+  void            ForgetWorkerJobArguments  (long node);
+
+}
+
+#endif
@@ -109,6 +109,62 @@ long            MPICategoryCount,
 _String         mpiLoopSwitchToOptimize ("_CONTEXT_SWITCH_MPIPARTITIONS_"),
                 mpiLoopSwitchToBGM      ("_BGM_SWITCH_");
 
+/* the state of dynamic load balancing in the partition optimizer mode
+   (see _LikelihoodFunction::RebalanceMPIPartitions) */
+
+static _List    mpi_partition_assignment,   // computational node - 1 -> the partitions it evaluates
+                mpi_partition_rebalance;    // if not empty, the assignment for InitMPIOptimizer to use
+
+static _Matrix  mpi_partition_node_times;   // 2 x computational nodes: the time spent computing, and the number of timed evaluations
+
+static long     mpi_partition_evaluations = 0L;
+
+//_______________________________________________________________________________________
+
+static hyFloat _AssignPartitionsToNodes (_Matrix const & costs, long nodes, _List & assignment) {
+    /* longest processing time first: partitions, from the most to the least expensive,
+       go to the node with the smallest total cost so far; several cheap partitions
+       may end up on the same node. Returns the largest total cost of a node. */
+
+    long const        partitions = costs.GetHDim();
+    _Matrix           node_costs (MIN (nodes, partitions), 1, false, true),
+                      cost_and_index (partitions, 2, false, true);
+
+    nodes = node_costs.GetHDim();
+
+    for (long p = 0L; p < partitions; p++) {
+        cost_and_index.Store (p, 0, costs.theData[p]);
+        cost_and_index.Store (p, 1, p);
+    }
+    _Constant  sort_on (0.);
+    _Matrix  * by_cost = (_Matrix*)cost_and_index.SortMatrixOnColumn (&sort_on, nil); // ascending
+
+    assignment.Clear();
+    for (long k = 0L; k < nodes; k++) {
+        assignment.AppendNewInstance (new _SimpleList);
+    }
+
+    for (long p = partitions - 1L; p >= 0L; p--) {
+        long const partition = round ((*by_cost)(p, 1));
+        long least_loaded = 0L;
+        for (long k = 1L; k < nodes; k++) {
+            if (node_costs.theData[k] < node_costs.theData[least_loaded]) {
+                least_loaded = k;
+            }
+        }
+        node_costs.theData[least_loaded] += costs.theData[partition];
+        (*(_SimpleList*)assignment.GetItem (least_loaded)) << partition;
+    }
+    DeleteObject (by_cost);
+
+    hyFloat max_cost = 0.;
+    for (long k = 0L; k < nodes; k++) {
+        ((_SimpleList*)assignment.GetItem (k))->Sort();
+        max_cost = MAX (max_cost, node_costs.theData[k]);
+    }
+    return max_cost;
+}
+
 #endif
 
 #define     SQR(A) (A)*(A)
@@ -183,6 +239,12 @@ _String  const
                                 categoryMatrixScalers           (".site_scalers"),
                                 categoryLogMultiplier           (".log_scale_multiplier"),
                                 minimumSitesForAutoParallelize  ("MINIMUM_SITES_FOR_AUTO_PARALLELIZE"),
+                                kMPIPartitionRebalanceInterval  ("MPI_PARTITION_REBALANCE_INTERVAL"),
+                                // how many likelihood evaluations to time before (possibly) reassigning partitions
+                                // to MPI nodes in the partition optimizer mode; 0 to keep the initial assignment
+                                kMPIPartitionAssignment         ("MPI_PARTITION_ASSIGNMENT"),
+                                // set by the partition optimizer mode: a row vector with the MPI node
+                                // which evaluates each partition
                                 userSuppliedVariableGrouping    ("PARAMETER_GROUPING"),
                                 kAddLFSmoothing                 ("LF_SMOOTHING_SCALER"),
                                 kOptimizationPrecision          ("OPTIMIZATION_PRECISION"),
@@ -806,6 +868,39 @@ void     _LikelihoodFunction::Rebuild (bool rescan_parameters) {
 
 //_______________________________________________________________________________________
 
+void     _LikelihoodFunction::UpdatePatterns (long filter_index, _SimpleList const& changed_patterns) {
+    /*
+       patterns which are not listed in 'changed_patterns' kept their rows in the filter, so the
+       summation orders of the partitions which use it are updated for the changed rows only,
+       instead of being recomputed from scratch as Rebuild does
+     */
+    
+    if (mstCache || optimalOrders.lLength != theTrees.lLength || treeTraversalMasks.lLength != theTrees.lLength) {
+        Rebuild ();
+        return;
+    }
+    
+    computationalResults.Clear();
+    hasBeenSetUp     = 0;
+    
+    for (unsigned long i = 0UL; i < theDataFilters.lLength; i++) {
+        if (theDataFilters.get (i) == filter_index) {
+            _DataSetFilter const * df    = GetIthFilter (i);
+            _SimpleList          * order = (_SimpleList*)optimalOrders (i),
+                                 * skips = (_SimpleList*)leafSkips (i);
+            
+            treeTraversalMasks.Replace (i, new _SimpleList (GetIthTree (i)->GetINodeCount() * df->GetPatternCount() / _HY_BITMASK_WIDTH_ + 1,0,0), false);
+            OptimalOrder (i, *order, nil, &changed_patterns);
+            skips->Clear();
+            df->MatchStartNEnd (*order, *skips);
+        }
+    }
+    
+    AllocateTemplateCaches();
+}
+
+//_______________________________________________________________________________________
+
 void     _LikelihoodFunction::Clear (void)
 {
     DeleteCaches  ();
@@ -821,6 +916,7 @@ void     _LikelihoodFunction::Clear (void)
     indexDep.Clear();
     indexCat.Clear();
     blockDependancies.Clear();
+    ClearDependentMaps ();
     computationalResults.Clear();
     partScalingCache.Clear();
     indVarsByPartition.Clear();
@@ -1161,6 +1257,9 @@ void    _LikelihoodFunction::Duplicate (BaseRefConst obj) // duplicate an object
     indexDep.Duplicate(&lf->indexDep);
     indexCat.Duplicate(&lf->indexCat);
     blockDependancies.Duplicate(&lf->blockDependancies);
+    dependentUpdateKeys.Duplicate(&lf->dependentUpdateKeys);
+    dependentUpdateLists.Duplicate(&lf->dependentUpdateLists);
+    dependentsAlwaysUpdated.Duplicate(&lf->dependentsAlwaysUpdated);
     computationalResults.Duplicate(&lf->computationalResults);
     siteResults = nil;
     variables_changed_during_last_compute = nil;
@@ -1470,6 +1569,7 @@ void        _LikelihoodFunction::MPI_LF_Compute (long, bool)
     {
         //ReportWarning (_String("In at step  ") & loopie);
         bool    doSomething = false;
+        TimeDifference timer;
         for (long i = 0; i<indexInd.lLength; i++) {
             _Variable *anInd = LocateVar(indexInd.list_data[i]);
             //ReportWarning (*anInd->GetName() & " = " & variableStash.theData[i]);
@@ -1510,7 +1610,9 @@ void        _LikelihoodFunction::MPI_LF_Compute (long, bool)
         //printf ("%d [mode = %d] %d/%d\n", hy_mpi_node_rank, partMode, siteResults->GetSize(), siteScalerBuffer.lLength);
 
         if (partMode) {
-            ReportMPIError(MPI_Send(&siteLL, 1, MPI_DOUBLE, senderID, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD),true);
+            // the log-likelihood and the time it took to compute it (0 if nothing needed to be recomputed)
+            hyFloat reply [2] = {siteLL, doSomething ? timer.TimeSinceStart() : 0.};
+            ReportMPIError(MPI_Send(reply, 2, MPI_DOUBLE, senderID, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD),true);
         } else
             // need to send both
         {
@@ -1875,7 +1977,7 @@ bool      _LikelihoodFunction::SendOffToMPI       (long index) {
 /* 20170404 SLKP Need to check if the decision to recompute a partition is made correctly.
  In particular, need to confirm that changes to category variables are handled correctly (e.g. HaveParametersChanged, vs has changed */
 
-    bool                sendToSlave = (computationalResults.GetSize() < parallelOptimizerTasks.lLength);
+    bool                sendToSlave = (computationalResults.get_used() < parallelOptimizerTasks.lLength);
     _SimpleList     *   slaveParams = (_SimpleList*)parallelOptimizerTasks(index);
 
     for (unsigned long varID = 0UL; varID < slaveParams->lLength; varID++) {
@@ -1911,19 +2013,34 @@ bool    _LikelihoodFunction::PreCompute         (void)
     unsigned long i = 0UL;
     
     _SimpleList * arrayToCheck = nonConstantDep?nonConstantDep:&indexDep;
-
+    _SimpleList   affected;
     
-    
-    for (; i < arrayToCheck->lLength; i++) {
-        _Variable* cornholio = LocateVar(arrayToCheck->list_data[i]);
+    auto refresh_dependent = [] (long var_index) -> void {
+        _Variable* cornholio = LocateVar(var_index);
         hyFloat tp = cornholio->Compute()->Value();
-         if (!cornholio->IsValueInBounds(tp)){
+        if (!cornholio->IsValueInBounds(tp)){
             ReportWarning (_String ("Failing bound checks on ") & *cornholio->GetName() & " = " & _String (tp, "%25.16g"));
         }
+    };
+
+    if (AffectedDependents (affected)) {
+        // only the dependents reachable from the parameters
+        // which changed since the last evaluation need to be refreshed here
+        affected.Each ([arrayToCheck, refresh_dependent] (long position, unsigned long) -> void {
+            refresh_dependent (arrayToCheck->list_data[position]);
+        });
+        i = arrayToCheck->lLength;
+    } else {
+        for (; i < arrayToCheck->lLength; i++) {
+            refresh_dependent (arrayToCheck->list_data[i]);
+        }
     }
 
     useGlobalUpdateFlag = false;
     // mod 20060125 to only update large globals once
+    
+    // dependents which were not visited directly could still have been computed
+    // while evaluating the ones that were, so the flags are cleared for all of them
 
     for (unsigned long j=0UL; j < i; j++) {
         _Variable* cornholio = LocateVar(arrayToCheck->list_data[j]);
@@ -1941,10 +2058,17 @@ bool    _LikelihoodFunction::PreCompute         (void)
 
 void    _LikelihoodFunction::PostCompute        (void) {
     _SimpleList * arrayToCheck = nonConstantDep?nonConstantDep:&indexDep;
+    _SimpleList   affected;
 
     //useGlobalUpdateFlag = true;
-    for (unsigned long i=0; i<arrayToCheck->lLength; i++) {
-        LocateVar (arrayToCheck->list_data[i])->Compute();
+    if (AffectedDependents (affected)) {
+        for (unsigned long i=0; i<affected.lLength; i++) {
+            LocateVar (arrayToCheck->list_data[affected.list_data[i]])->Compute();
+        }
+    } else {
+        for (unsigned long i=0; i<arrayToCheck->lLength; i++) {
+            LocateVar (arrayToCheck->list_data[i])->Compute();
+        }
     }
     //useGlobalUpdateFlag = false;
     // mod 20060125 comment out the compute loop; seems redundant
@@ -1970,6 +2094,111 @@ void    _LikelihoodFunction::PostCompute        (void) {
     }
 }
 
+//_______________________________________________________________________________________
+
+void    _LikelihoodFunction::MapDependentsToIndependents (void) {
+    /*
+        for every non-constant dependent variable, find all the independent
+        variables it (possibly transitively) depends on, and record the reverse
+        map, so that after a few parameters change, only the dependents that
+        can be affected are refreshed by Pre/PostCompute
+    */
+    
+    ClearDependentMaps ();
+    
+    if (!nonConstantDep) {
+        return;
+    }
+    
+    _SimpleList sorted_independents (indexInd);
+    sorted_independents.Sort();
+    
+    for (unsigned long i = 0UL; i < nonConstantDep->lLength; i++) {
+        _Variable * dependent = LocateVar (nonConstantDep->list_data[i]);
+        _SimpleList   references;
+        _AVLList      references_avl (&references);
+        
+        if (dependent->varFormula) {
+            dependent->varFormula->ScanFForVariables (references_avl, true, true, true);
+        }
+        
+        bool always = false;
+        
+        for (unsigned long r = 0UL; r < references.lLength; r++) {
+            long       var_index = references.list_data[r];
+            _Variable* reference = LocateVar (var_index);
+            if (!reference->IsIndependent()) {
+                // its own inputs were also collected by the scan
+                continue;
+            }
+            if (sorted_independents.BinaryFind (var_index) < 0L) {
+                always = true;
+                break;
+            }
+            long key = dependentUpdateKeys.BinaryFind (var_index);
+            if (key < 0L) {
+                key = dependentUpdateKeys.BinaryInsert (var_index);
+                dependentUpdateLists.InsertElement (new _SimpleList, key, false, false);
+            }
+            (*(_SimpleList*)dependentUpdateLists.GetItem (key)) << i;
+        }
+        
+        if (always) {
+            dependentsAlwaysUpdated << i;
+        }
+    }
+}
+
+//_______________________________________________________________________________________
+
+void    _LikelihoodFunction::ClearDependentMaps (void) {
+    dependentUpdateKeys.Clear();
+    dependentUpdateLists.Clear();
+    dependentsAlwaysUpdated.Clear();
+}
+
+//_______________________________________________________________________________________
+
+bool    _LikelihoodFunction::AffectedDependents (_SimpleList& affected) const {
+    /*
+        populate 'affected' with sorted positions (in nonConstantDep) of dependent
+        variables which need to be refreshed given the parameters changed since the last
+        evaluation; return false if all of them need to be visited (no change tracking,
+        too many changes, or changes that were made outside the optimizer)
+    */
+    
+    affected.Clear();
+    
+    if (!nonConstantDep || !variables_changed_during_last_compute || (nonConstantDep->nonempty() && dependentUpdateKeys.empty() && dependentsAlwaysUpdated.empty())) {
+        return false;
+    }
+    
+    unsigned long changed_count = variables_changed_during_last_compute->countitems();
+    
+    if (changed_count == 0UL || (changed_count << 1) > indexInd.lLength) {
+        return false;
+    }
+    
+    _AVLList affected_avl (&affected);
+    
+    for (unsigned long i = 0UL; i < _variables_changed_during_last_compute->lLength; i++) {
+        long key = dependentUpdateKeys.BinaryFind (_variables_changed_during_last_compute->list_data[i]);
+        if (key >= 0L) {
+            _SimpleList const * dependents = (_SimpleList const*)dependentUpdateLists.GetItem (key);
+            for (unsigned long d = 0UL; d < dependents->lLength; d++) {
+                affected_avl.InsertNumber (dependents->list_data[d]);
+            }
+        }
+    }
+    
+    for (unsigned long i = 0UL; i < dependentsAlwaysUpdated.lLength; i++) {
+        affected_avl.InsertNumber (dependentsAlwaysUpdated.list_data[i]);
+    }
+    
+    affected_avl.ReorderList ();
+    return true;
+}
+
 
 
 //_______________________________________________________________________________________
@@ -2282,6 +2511,10 @@ hyFloat  _LikelihoodFunction::Compute        (void)
         if (computeMode == 4) {
 #ifdef __HYPHYMPI__
             if (hy_mpi_node_rank == 0) {
+                if (hyphyMPIOptimizerMode == _hyphyLFMPIModePartitions) {
+                    RebalanceMPIPartitions ();
+                }
+
                 long    totalSent = 0;
                 for (long blockID = 0; blockID < parallelOptimizerTasks.lLength; blockID ++) {
                     bool sendToSlave = SendOffToMPI (blockID);
@@ -2294,15 +2527,20 @@ hyFloat  _LikelihoodFunction::Compute        (void)
 
                 while (totalSent) {
                     MPI_Status      status;
-                    hyFloat      blockRes;
-                    ReportMPIError(MPI_Recv (&blockRes, 1, MPI_DOUBLE, MPI_ANY_SOURCE , HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD,&status),true);
-                    //printf ("Got %g from block %d \n", blockRes, status.MPI_SOURCE-1);
+                    hyFloat      blockRes [2]; // log-likelihood, compute time
+                    ReportMPIError(MPI_Recv (blockRes, 2, MPI_DOUBLE, MPI_ANY_SOURCE , HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD,&status),true);
+                    //printf ("Got %g from block %d \n", blockRes[0], status.MPI_SOURCE-1);
 
-                    result            += blockRes;
+                    if (blockRes[1] > 0. && status.MPI_SOURCE <= mpi_partition_node_times.GetVDim()) {
+                        mpi_partition_node_times.theData[status.MPI_SOURCE-1] += blockRes[1];
+                        mpi_partition_node_times.theData[mpi_partition_node_times.GetVDim() + status.MPI_SOURCE-1] += 1.;
+                    }
+
+                    result            += blockRes[0];
                     /*if (status.MPI_SOURCE == 1 && computationalResults.GetUsed()) {
                         printf ("\033\015 COMPUTED / CACHED %g / %g             ", blockRes, computationalResults[0]);
                     }*/
-                    UpdateBlockResult (status.MPI_SOURCE-1, blockRes);
+                    UpdateBlockResult (status.MPI_SOURCE-1, blockRes[0]);
                     totalSent--;
                 }
 
@@ -2692,6 +2930,8 @@ void    _LikelihoodFunction::CheckDependentBounds (void) {
         }
     }
     
+    MapDependentsToIndependents ();
+    
     if (badIndices.lLength && !ohWell) // one of the variables has left its prescribed bounds
                                        // build a table of dependancies
     {
@@ -3488,78 +3728,60 @@ void    _LikelihoodFunction::InitMPIOptimizer (void)
                 }
                 // no autoParallelize
                 else {
-                    long     perNode        =  (hyphyMPIOptimizerMode == _hyphyLFMPIModeAuto)?1:theDataFilters.lLength / slaveNodes,
-                             overFlow       =  (hyphyMPIOptimizerMode == _hyphyLFMPIModeAuto)?0:theDataFilters.lLength % slaveNodes;
-
-                    if (perNode == 0L) { // more nodes than filters
-                        slaveNodes         = theDataFilters.lLength;
-                        totalNodeCount     = slaveNodes + 1;
-                        perNode            = 1L;
-                        overFlow           = 0L;
-                    }
+                    _List assignment; // computational node - 1 -> the partitions it evaluates
 
-                    _Matrix partition_weights (theDataFilters.lLength, 2, false, true);
-                    
-                    if (theDataFilters.lLength > slaveNodes) {
-                        
-                        for (unsigned long i = 0UL; i < theDataFilters.lLength; i++) {
-                            //fprintf (stderr, "\nComputing block %ld\n", i);
-                            TimeDifference timer;
-                            ComputeBlock(i);
-                            hyFloat timeDiff   = timer.TimeSinceStart();
-                            partition_weights.Store (i, 0, timeDiff);
+                    if (hyphyMPIOptimizerMode == _hyphyLFMPIModePartitions) {
+                        if (mpi_partition_rebalance.nonempty()) {
+                            // set by RebalanceMPIPartitions from measured evaluation times
+                            assignment << mpi_partition_rebalance;
+                            mpi_partition_rebalance.Clear();
+                        } else {
+                            _Matrix costs (theDataFilters.lLength, 1, false, true);
+                            for (unsigned long i = 0UL; i < theDataFilters.lLength; i++) {
+                                costs.theData[i] = MPIPartitionCost (i);
+                            }
+                            _AssignPartitionsToNodes (costs, slaveNodes, assignment);
                         }
-                        
                     } else {
+                        // the by-site template expects partition i on node i+1
                         for (unsigned long i = 0UL; i < theDataFilters.lLength; i++) {
-                            partition_weights.Store (i, 0, 1.);
+                            assignment.AppendNewInstance (new _SimpleList ((long)i));
                         }
                     }
-                    
-                    _Constant * sum = (_Constant*)partition_weights.Sum(nil);
-                    partition_weights *= (slaveNodes/sum->Value());
-                    for (unsigned long i = 0UL; i < theDataFilters.lLength; i++) {
-                        partition_weights.Store (i, 1, i);
-                    }
-                    
-                    sum->SetValue(0.);
-                    _Matrix * sorted_by_weight = (_Matrix*)partition_weights.SortMatrixOnColumn(sum, nil);
-                    DeleteObject (sum);
-                    
+
+                    slaveNodes     = assignment.countitems();
+                    totalNodeCount = slaveNodes + 1;
 
                     MPISwitchNodesToMPIMode (slaveNodes);
-                    
-                    long current_index = 0L;
-                    
+
                     ReportWarning    (_String ("InitMPIOptimizer with:") & (long)theDataFilters.lLength & " partitions on " & (long)slaveNodes
                                       & " MPI computational nodes. ");
-                    
+
                     for (long i = 1L; i<totalNodeCount; i++) {
-                        hyFloat sum = 0.;
-                        _SimpleList my_part;
-                        do {
-                            sum += (*sorted_by_weight) (current_index, 0);
-                            my_part << round ((*sorted_by_weight) (current_index, 1));
-                            current_index++;
-                        } while (sum < 1. && theDataFilters.lLength - current_index >= (totalNodeCount - i));
-                        
-                        ReportWarning    (_String ("InitMPIOptimizer sending partitions ") & _String ((_String*)my_part.toStr()) & " to node " & i);
-                        
-                        
-                        //fprintf (stderr, "%s\n", _String ((_String*)my_part.toStr()).getStr());
-                        
-                        
+                        _SimpleList * my_part = (_SimpleList*)assignment.GetItem (i-1L);
+
+                        ReportWarning    (_String ("InitMPIOptimizer sending partitions ") & _String ((_String*)my_part->toStr()) & " to node " & i);
+
                         _StringBuffer     sLF (8192L);
-                        SerializeLF       (sLF,_hyphyLFSerializeModeVanilla,&my_part);
+                        SerializeLF       (sLF,_hyphyLFSerializeModeVanilla,my_part);
                         sLF.TrimSpace     ();
-                        
+
                         MPISendString    (sLF,i);
                         parallelOptimizerTasks.AppendNewInstance (new _SimpleList);
                     }
-                    
-                    
-                    DeleteObject (sorted_by_weight);
-                    
+
+                    mpi_partition_assignment.Clear();
+                    mpi_partition_assignment << assignment;
+
+                    _Matrix * partition_nodes = new _Matrix (1, theDataFilters.lLength, false, true);
+                    for (long k = 0L; k < slaveNodes; k++) {
+                        ((_SimpleList*)assignment.GetItem (k))->Each ([&] (long p, unsigned long) -> void {
+                            partition_nodes->theData[p] = k + 1L;
+                        });
+                    }
+                    hy_env::EnvVariableSet (kMPIPartitionAssignment, partition_nodes, false);
+                    _Matrix::CreateMatrix (&mpi_partition_node_times, 2, slaveNodes, false, true, false);
+                    mpi_partition_evaluations = 0L;
                 }
 
 
@@ -3619,6 +3841,72 @@ void    _LikelihoodFunction::CleanupMPIOptimizer (void)
 #endif
 }
 
+//_______________________________________________________________________________________
+
+hyFloat    _LikelihoodFunction::MPIPartitionCost (long index) {
+    _DataSetFilter const * filter = GetIthFilter (index);
+    _TheTree       const * tree   = GetIthTree   (index);
+    hyFloat        const   states = filter->GetDimension (true);
+
+    return (hyFloat)filter->GetPatternCount() * states * states * (tree->GetLeafCount() + tree->GetINodeCount() - 1L)
+           * MAX (1L, TotalRateClassesForAPartition (index));
+}
+
+//_______________________________________________________________________________________
+
+void    _LikelihoodFunction::RebalanceMPIPartitions (void) {
+#ifdef __HYPHYMPI__
+    /* the initial assignment of partitions to nodes is based on MPIPartitionCost;
+       every MPI_PARTITION_REBALANCE_INTERVAL evaluations, the time each node spent computing is
+       split among its partitions (in proportion to their costs), and if assigning partitions
+       based on these times would make the slowest node substantially faster, the partitions
+       are redistributed (which requires sending the likelihood functions to nodes again) */
+
+    hyFloat interval = 50.;
+    checkParameter (kMPIPartitionRebalanceInterval, interval, 50.);
+
+    long const nodes = mpi_partition_assignment.countitems();
+
+    if (interval < 1. || nodes < 2L || ++mpi_partition_evaluations < interval) {
+        return;
+    }
+    mpi_partition_evaluations = 0L;
+
+    _Matrix   estimates (theDataFilters.lLength, 1, false, true);
+    hyFloat   slowest_node = 0.;
+
+    for (long k = 0L; k < nodes; k++) {
+        hyFloat const samples = mpi_partition_node_times (1, k);
+        if (samples < 1.) {
+            return; // this node has not been timed yet
+        }
+        hyFloat const      mean_time = mpi_partition_node_times (0, k) / samples;
+        _SimpleList const* partitions = (_SimpleList const*)mpi_partition_assignment.GetItem (k);
+        hyFloat            node_cost = 0.;
+
+        slowest_node = MAX (slowest_node, mean_time);
+        partitions->Each ([&] (long p, unsigned long) -> void {
+            estimates.theData[p] = MPIPartitionCost (p);
+            node_cost += estimates.theData[p];
+        });
+        partitions->Each ([&] (long p, unsigned long) -> void {
+            estimates.theData[p] = node_cost > 0. ? mean_time * estimates.theData[p] / node_cost : mean_time / partitions->countitems();
+        });
+    }
+
+    _List     proposed;
+    hyFloat   const proposed_slowest_node = _AssignPartitionsToNodes (estimates, RetrieveMPICount (0) - 1, proposed);
+
+    if (proposed_slowest_node < 0.9 * slowest_node) {
+        ReportWarning (_String ("[MPI] Rebalancing partitions: the slowest node should take ") & _String (proposed_slowest_node, "%g") & " instead of " & _String (slowest_node, "%g") & " seconds per evaluation");
+        CleanupMPIOptimizer ();
+        mpi_partition_rebalance << proposed;
+        InitMPIOptimizer ();
+        computationalResults.ZeroUsed(); // per-node results refer to the old assignment
+    }
+#endif
+}
+
 //_______________________________________________________________________________________
 void            _LikelihoodFunction::SetupLFCaches              (void) {
     // need to decide which data represenation to use,
@@ -5190,6 +5478,7 @@ void _LikelihoodFunction::CleanUpOptimize (void) {
     lockedLFID       = -1;
     DeleteAndZeroObject     (nonConstantDep);
     DeleteAndZeroObject     (variable_to_node_map);
+    ClearDependentMaps      ();
 }
 
 //_______________________________________________________________________________________
@@ -6929,12 +7218,14 @@ void    _LikelihoodFunction::GradientDescent (hyFloat& gPrecision, _Matrix& best
 //_______________________________________________________________________________________
 
 void    _LikelihoodFunction::LocateTheBump (long index,hyFloat gPrecision, hyFloat& maxSoFar, hyFloat& bestVal, bool go2Bound, hyFloat bracketSetting) {
-    hyFloat left,
-               right,
+    // Bracket may read left/leftValue when it hits the lower bound
+    // on the very first step; seed them with the current point so that it does not read garbage
+    hyFloat left             = bestVal,
+               right            = bestVal,
                middle           = bestVal,
-               leftValue,
+               leftValue         = maxSoFar,
                middleValue       = maxSoFar,
-               rightValue,
+               rightValue        = maxSoFar,
                bp               = 2.*gPrecision,
                brentPrec        = bracketSetting>0.?bracketSetting:gPrecision,
                originalValue         = index >= 0 ? GetIthIndependent(index) : 0.;
@@ -9015,7 +9306,83 @@ void    setComputingArrays (node<long>* startingNode, node<long>* childNode, _Si
 
 //_______________________________________________________________________________________
 
-void        _LikelihoodFunction::OptimalOrder    (long index, _SimpleList& sl, _SimpleList const * clone) {
+bool        _LikelihoodFunction::ReorderChangedPatterns (long index, _SimpleList& sl, _SimpleList const& changed) const {
+    /*
+       'sl' is the summation order of partition 'index' from before some of the pattern rows
+       of its filter changed. Unchanged rows keep their relative order; each changed or new row is
+       inserted right after the ordered row which it is the cheapest to reach from, which is the
+       step that the spanning tree construction in OptimalOrder takes for every site.
+     
+       Returns false (leaving 'sl' as is) if there is no order to update or if most of the rows
+       changed; the order should then be computed from scratch.
+     */
+    
+    _DataSetFilter const * df            = GetIthFilter (index);
+    _TheTree             * t             = GetIthTree   (index);
+    long           const   pattern_count = df->GetPatternCount();
+    
+    if (sl.empty() || changed.countitems() * 2L >= pattern_count) {
+        return false;
+    }
+    
+    const long kPatternChanged = 1L,
+               kPatternOrdered = 2L;
+    
+    _SimpleList pattern_state (pattern_count, 0L, 0L),
+                order,
+                to_place;
+    
+    changed.Each ([&] (long row, unsigned long) -> void {
+        if (row < pattern_count) {
+            pattern_state.list_data[row] = kPatternChanged;
+        }
+    });
+    
+    sl.Each ([&] (long row, unsigned long) -> void {
+        if (row < pattern_count && pattern_state.list_data[row] == 0L) {
+            pattern_state.list_data[row] = kPatternOrdered;
+            order << row;
+        }
+    });
+    
+    if (order.empty()) {
+        return false;
+    }
+    
+    for (long row = 0L; row < pattern_count; row++) {
+        if (pattern_state.list_data[row] != kPatternOrdered) {
+            to_place << row;
+        }
+    }
+    
+    _SimpleList child_count (t->get_flat_nodes().MapList([] (long n, unsigned long ) -> long {
+        return ((node <long>*)n)->get_num_nodes();
+    }));
+    
+    bool const by_character = df->GetUnitLength() == 1;
+    
+    to_place.Each ([&] (long row, unsigned long) -> void {
+        long best_cost     = 0x0fffffff,
+             best_position = 0L;
+        
+        for (unsigned long k = 0UL; k < order.lLength; k++) {
+            long const cost = by_character ? t->ComputeReleafingCostChar (df, order.list_data[k], row, &child_count)
+                                           : t->ComputeReleafingCost (df, order.list_data[k], row, nil, 0, &child_count);
+            if (cost < best_cost) {
+                best_cost     = cost;
+                best_position = k;
+            }
+        }
+        order.InsertElement ((BaseRef)row, best_position + 1L, false, false);
+    });
+    
+    sl = order;
+    return true;
+}
+
+//_______________________________________________________________________________________
+
+void        _LikelihoodFunction::OptimalOrder    (long index, _SimpleList& sl, _SimpleList const * clone, _SimpleList const * changed) {
 
     //printf ("\nEntered _LikelihoodFunction::OptimalOrder\n");
     //TimeDifference tracker;
@@ -9049,6 +9416,12 @@ void        _LikelihoodFunction::OptimalOrder    (long index, _SimpleList& sl, _
             return;
         }
 
+        if (changed && ReorderChangedPatterns (index, sl, *changed)) {
+            completedSites = totalSites; // the existing order has been updated; skip the full optimization
+        } else {
+            sl.Clear();
+        }
+
         partition = hy_env::EnvVariableGetNumber(optimizePartitionSize, 0.0);
         
          if (partition) { //  partition the sequence into smaller subseqs. for optimization
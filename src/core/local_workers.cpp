@@ -0,0 +1,670 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+
+#include "local_workers.h"
+#include "global_things.h"
+#include "global_object_lists.h"
+#include "hbl_env.h"
+#include "batchlan.h"
+#include "likefunc.h"
+#include "dataset.h"
+#include "worker_messages.h"
+#include "time_difference.h"
+
+#if defined __UNIX__ && ! defined __HYPHYMPI__ && ! defined __HEADLESS__
+  #define __HYPHY_LOCAL_WORKERS__
+#endif
+
+#ifdef __HYPHY_LOCAL_WORKERS__
+  #include <unistd.h>
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <signal.h>
+  #include <sys/types.h>
+  #include <sys/wait.h>
+#endif
+
+#ifdef _OPENMP
+  #include "omp.h"
+#endif
+
+using namespace hy_global;
+using namespace hyphy_global_objects;
+
+static const _String kPreserveWorkerNodeState ("PRESERVE_SLAVE_NODE_STATE"),
+                     kMPINexusFileReturn      ("MPI_NEXUS_FILE_RETURN"),
+                     kWorkerJobCode           ("code"),
+                     kWorkerJobArguments      ("arguments");
+
+static bool          running_worker_job = false; // see ExecuteWorkerJob
+
+static bool          has_deferred_failure = false; // see DeferWorkerJobFailure
+static _String       deferred_failure;
+
+#ifdef __HYPHY_LOCAL_WORKERS__
+
+static long          local_worker_count = 0L,   // 0 if the backend is not in use
+                     local_worker_rank  = 0L,   // 0 for the master, k for the k-th worker
+                     local_worker_next  = 0L;   // where to start polling for replies (round robin)
+
+static _SimpleList   local_worker_pids,         // per worker (node - 1); 0 if not running
+                     local_worker_input,        // master -> worker pipes (write end, non-blocking)
+                     local_worker_output;       // worker -> master pipes (read end)
+
+static _List         local_worker_replies;      // per worker: replies read while sending to the worker, not yet received
+
+//____________________________________________________________________________________
+
+static bool _WriteToPipe (int descriptor, const char * buffer, unsigned long size) {
+  while (size) {
+    ssize_t const written = write (descriptor, buffer, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buffer += written;
+    size   -= written;
+  }
+  return true;
+}
+
+//____________________________________________________________________________________
+
+static bool _ReadFromPipe (int descriptor, char * buffer, unsigned long size) {
+  while (size) {
+    ssize_t const received = read (descriptor, buffer, size);
+    if (received <= 0) {
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buffer += received;
+    size   -= received;
+  }
+  return true;
+}
+
+//____________________________________________________________________________________
+
+static bool _SendPipeMessage (int descriptor, _String const & message) {
+  // messages are framed as in MPISendString: the length, followed by the characters
+  long const length = message.length();
+  return _WriteToPipe (descriptor, (const char*)&length, sizeof (long)) && (length == 0L || _WriteToPipe (descriptor, message.get_str(), length));
+}
+
+//____________________________________________________________________________________
+
+static _String * _ReceivePipeMessage (int descriptor) {
+  long length;
+  if (!_ReadFromPipe (descriptor, (char*)&length, sizeof (long)) || length < 0L) {
+    return nil;
+  }
+  _String * message = new _String ((unsigned long)length);
+  if (length && !_ReadFromPipe (descriptor, (char*)message->get_str(), length)) {
+    DeleteObject (message);
+    return nil;
+  }
+  return message;
+}
+
+//____________________________________________________________________________________
+
+static bool _WriteToWorker (long node, const char * buffer, unsigned long size) {
+  /* the master may send a job to a worker which is still busy with an earlier one;
+     if the pipe fills up, the worker may in turn be blocked writing its reply, so
+     replies are read (and kept for LocalWorkerReceive) while waiting to write */
+  int const input  = (int)local_worker_input.get (node - 1L),
+            output = (int)local_worker_output.get (node - 1L);
+
+  while (size) {
+    ssize_t const written = write (input, buffer, size);
+    if (written >= 0) {
+      buffer += written;
+      size   -= written;
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      return false;
+    }
+
+    struct pollfd descriptors [2] = {{input, POLLOUT, 0}, {output, POLLIN, 0}};
+    if (poll (descriptors, 2, -1) < 0 && errno != EINTR) {
+      return false;
+    }
+    if (descriptors[1].revents) {
+      _String * reply = _ReceivePipeMessage (output);
+      if (!reply) {
+        return false;
+      }
+      ((_List*)local_worker_replies.GetItem (node - 1L))->AppendNewInstance (reply);
+    }
+  }
+  return true;
+}
+
+//____________________________________________________________________________________
+
+static bool _SendToWorker (long node, _String const & message) {
+  long const length = message.length();
+  return _WriteToWorker (node, (const char*)&length, sizeof (long)) && (length == 0L || _WriteToWorker (node, message.get_str(), length));
+}
+
+//____________________________________________________________________________________
+
+static _String * _TakeStoredReply (long node) {
+  _List * replies = (_List*)local_worker_replies.GetItem (node - 1L);
+  if (replies->empty()) {
+    return nil;
+  }
+  _String * reply = (_String*)replies->GetItem (0);
+  reply->AddAReference();
+  replies->Delete (0);
+  return reply;
+}
+
+//____________________________________________________________________________________
+
+static int _PollWithTimeout (struct pollfd * descriptors, unsigned long count, hyFloat timeout) {
+  // wait for up to 'timeout' seconds (indefinitely if timeout <= 0); returns 0 on timeout
+  TimeDifference timer;
+  while (true) {
+    int wait_for = -1;
+    if (timeout > 0.) {
+      wait_for = MAX (0, (int)ceil ((timeout - timer.TimeSinceStart()) * 1000.));
+    }
+    int const ready = poll (descriptors, count, wait_for);
+    if (ready >= 0 || errno != EINTR) {
+      return ready;
+    }
+  }
+}
+
+//____________________________________________________________________________________
+
+static void _LocalWorkerLoop (int input, int output, _String const & base_directory) {
+  // as with MPI nodes other than the master, console output of workers is discarded;
+  // workers run one job at a time, so they do not need threads of their own
+  if (!freopen ("/dev/null", "w", stdout)) {
+    _exit (1);
+  }
+  system_CPU_count = 1L;
+#ifdef _OPENMP
+  omp_set_num_threads (1);
+#endif
+  // a forked worker starts with a copy of everything the master has defined (and of the
+  // master's execution stack); discard it, so that the first job runs in the same clean
+  // state as the jobs after it and as the jobs on MPI nodes
+  PurgeAll (true);
+  InitializeGlobals ();
+  PushFilePath ((_String&)base_directory, false, false);
+  currentExecutionList = nil;
+  SetLocalWorkerEnvironment ();
+
+  while (_String * message = _ReceivePipeMessage (input)) {
+    if (message->empty()) {
+      DeleteObject (message);
+      break;
+    }
+    _String * result = ExecuteWorkerJob (*message);
+    DeleteObject (message);
+    if (!result || !_SendPipeMessage (output, *result)) {
+      DeleteObject (result);
+      break;
+    }
+    DeleteObject (result);
+    ResetWorkerState (base_directory);
+  }
+
+  fflush (nil);
+  _exit (0);
+}
+
+//____________________________________________________________________________________
+
+static void _StartLocalWorker (long node) {
+  int to_worker [2],
+      from_worker [2];
+
+  if (pipe (to_worker) != 0) {
+    throw _String ("Failed to create a pipe for local worker ") & node;
+  }
+  if (pipe (from_worker) != 0) {
+    close (to_worker[0]); close (to_worker[1]);
+    throw _String ("Failed to create a pipe for local worker ") & node;
+  }
+
+  fflush (nil); // otherwise buffered output would be written by both processes
+
+  pid_t const worker = fork ();
+
+  if (worker < 0) {
+    close (to_worker[0]); close (to_worker[1]);
+    close (from_worker[0]); close (from_worker[1]);
+    throw _String ("Failed to start local worker ") & node;
+  }
+
+  if (worker == 0) { // the worker process
+    close (to_worker[1]);
+    close (from_worker[0]);
+    for (unsigned long k = 0UL; k < local_worker_pids.lLength; k++) {
+      if (local_worker_pids.get (k)) {
+        close (local_worker_input.get (k));
+        close (local_worker_output.get (k));
+      }
+    }
+    local_worker_pids.Clear();
+    local_worker_rank = node;
+    _LocalWorkerLoop (to_worker[0], from_worker[1], hy_base_directory);
+  }
+
+  close (to_worker[0]);
+  close (from_worker[1]);
+  fcntl (to_worker[1], F_SETFL, fcntl (to_worker[1], F_GETFL) | O_NONBLOCK);
+
+  local_worker_pids.list_data   [node - 1L] = worker;
+  local_worker_input.list_data  [node - 1L] = to_worker[1];
+  local_worker_output.list_data [node - 1L] = from_worker[0];
+  ReportWarning (_String ("Started local worker ") & node & " (process " & (long)worker & ")");
+}
+
+//____________________________________________________________________________________
+
+static void _StopLocalWorker (long node, bool terminate = false) {
+  long const k = node - 1L;
+  if (local_worker_pids.get (k)) {
+    close (local_worker_input.get (k));
+    close (local_worker_output.get (k));
+    if (terminate) {
+      kill ((pid_t)local_worker_pids.get (k), SIGKILL);
+    }
+    waitpid ((pid_t)local_worker_pids.get (k), nil, 0);
+    local_worker_pids.list_data[k] = 0L;
+    ((_List*)local_worker_replies.GetItem (k))->Clear();
+    ForgetWorkerJobArguments (node); // a restarted worker starts with no stored arguments
+  }
+}
+
+#endif
+
+namespace hy_global {
+
+  //____________________________________________________________________________________
+
+  static _String*  _ExecuteWorkerJob (_String & message) {
+    if (IsWorkerValueMessage (message)) {
+      // a binary job: {"code" : HBL code, "arguments" : value bound to MPI_JOB_ARGUMENTS};
+      // the result is also returned in binary form
+      _String code;
+      try {
+        HBLObjectRef job = DecodeWorkerJob (message);
+        HBLObjectRef job_code = job->ObjectClass() == ASSOCIATIVE_LIST ? ((_AssociativeList*)job)->GetByKey (kWorkerJobCode, STRING) : nil;
+        if (!job_code) {
+          DeleteObject (job);
+          throw _String ("did not specify the code to execute");
+        }
+        code = ((_FString*)job_code)->get_str();
+        HBLObjectRef arguments = ((_AssociativeList*)job)->GetByKey (kWorkerJobArguments);
+        if (arguments) {
+          arguments->AddAReference();
+        }
+        hy_env::EnvVariableSet (hy_env::mpi_job_arguments, arguments ? arguments : new _AssociativeList, false);
+        DeleteObject (job);
+      } catch (const _String& error) {
+        HandleApplicationError (_String("[MPI] Malformed binary MPI job - ") & error);
+        return nil;
+      }
+      _ExecutionList job_program (code);
+      return EncodeWorkerValue (job_program.Execute());
+    }
+
+    if (message.BeginsWith ("#NEXUS")) {
+      ReportWarning       ("[MPI] Received a likelihood function");
+      ReadDataSetFile     (nil,true,&message);
+      ReportWarning       ("[MPI] Read/optimized the likelihood function");
+      _Variable*          lf_name = FetchVar(LocateVarByName(kMPINexusFileReturn));
+
+      if (lf_name) {
+        return new _StringBuffer ((_String*)lf_name->Compute()->toStr());
+      }
+
+      _FString        *lf_id = (_FString*)FetchObjectFromVariableByType (&lf2SendBack, STRING);
+
+      if (!lf_id) {
+        HandleApplicationError (_String("[MPI] Malformed MPI likelihood function optimization request - did not specify the LF name to return in variable ") & lf2SendBack & ".\n\n\n" );
+        return nil;
+      }
+
+      long type = HY_BL_LIKELIHOOD_FUNCTION, index;
+
+      _LikelihoodFunction *lf = (_LikelihoodFunction *)_HYRetrieveBLObjectByName (lf_id->get_str(), type, &index, false, false);
+
+      if (lf == nil) {
+        HandleApplicationError (_String("[MPI] Malformed MPI likelihood function optimization request - '") & lf_id->get_str() &"' did not refer to a well-defined likelihood function.\n\n\n");
+        return nil;
+      }
+
+      _StringBuffer * result = new _StringBuffer (1024UL);
+      lf->SerializeLF(*result,hy_env::EnvVariableTrue (hy_env::short_mpi_return) ? _hyphyLFSerializeModeShortMPI:_hyphyLFSerializeModeLongMPI);
+      return result;
+    }
+
+    _ExecutionList code (message);
+    HBLObjectRef   result = code.Execute();
+    return result ? new _StringBuffer ((_String*)result->toStr()) : new _StringBuffer ("0");
+  }
+
+  //____________________________________________________________________________________
+
+  bool  RunningWorkerJob (void) {
+    return running_worker_job;
+  }
+
+  //____________________________________________________________________________________
+
+  bool  DeferWorkerJobFailure (_String const & error) {
+#ifdef _OPENMP
+    if (omp_get_level () > 0) {
+      #pragma omp critical (hy_deferred_worker_failure)
+      if (!has_deferred_failure) {
+        has_deferred_failure = true;
+        deferred_failure     = error;
+      }
+      terminate_execution = true;
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  //____________________________________________________________________________________
+
+  void  RaiseDeferredWorkerJobFailure (void) {
+    if (has_deferred_failure && running_worker_job) {
+#ifdef _OPENMP
+      if (omp_get_level () > 0) {
+        return;
+      }
+#endif
+      has_deferred_failure = false;
+      throw _WorkerJobFailure (deferred_failure);
+    }
+  }
+
+  //____________________________________________________________________________________
+
+  _String*  ExecuteWorkerJob (_String & message) {
+    /* errors raised by the job unwind to here (HandleApplicationError throws
+       _WorkerJobFailure while running_worker_job is set); the execution stack
+       is restored to where it was before the job started, and the rest of
+       the state left behind by the job is discarded by ResetWorkerState
+    */
+    unsigned long const stack_depth = executionStack.countitems();
+    _ExecutionList    * const current_list = currentExecutionList;
+
+    running_worker_job   = true;
+    has_deferred_failure = false;
+    try {
+      _String * result = _ExecuteWorkerJob (message);
+      if (has_deferred_failure) {
+        // e.g. a likelihood function job, which does not run an execution list
+        DeleteObject (result);
+        RaiseDeferredWorkerJobFailure ();
+      }
+      running_worker_job = false;
+      return result;
+    } catch (const _WorkerJobFailure & failure) {
+      running_worker_job   = false;
+      has_deferred_failure = false;
+      while (executionStack.countitems() > stack_depth) {
+        // these execution lists may have been destroyed while the stack was unwound
+        executionStack.Delete (executionStack.countitems() - 1L, false);
+      }
+      currentExecutionList = current_list;
+      terminate_execution  = false;
+      hy_env::EnvVariableSet (kPreserveWorkerNodeState, new _Constant (0.), false);
+      ReportWarning (_String ("[MPI] The job failed: ") & failure.error);
+      return EncodeWorkerFailure (failure.error);
+    }
+  }
+
+  //____________________________________________________________________________________
+
+  void    ResetWorkerState (_String const & base_directory) {
+    if (hy_env::EnvVariableTrue (kPreserveWorkerNodeState) == false) {
+      PurgeAll (true);
+      InitializeGlobals ();
+      PushFilePath((_String&)base_directory, false, false);
+      ReportWarning("Reset node state");
+    } else {
+      ReportWarning("Preserved node state");
+    }
+  }
+
+  //____________________________________________________________________________________
+
+  void    ConfigureLocalWorkers (void) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    local_worker_count = MAX (0L, (long)hy_env::EnvVariableGetNumber (hy_env::local_worker_count, system_CPU_count > 1L ? system_CPU_count : 0L));
+    if (local_worker_count) {
+      local_worker_pids.Populate   (local_worker_count, 0L, 0L);
+      local_worker_input.Populate  (local_worker_count, 0L, 0L);
+      local_worker_output.Populate (local_worker_count, 0L, 0L);
+      for (long k = 0L; k < local_worker_count; k++) {
+        local_worker_replies.AppendNewInstance (new _List);
+      }
+      // a worker which exits early should be reported as an error, not terminate the master
+      signal (SIGPIPE, SIG_IGN);
+      SetLocalWorkerEnvironment ();
+    }
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  void    SetLocalWorkerEnvironment (void) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    if (local_worker_count) {
+      hy_env::EnvVariableSet (hy_env::mpi_node_count, new _Constant (local_worker_count + 1L), false);
+      hy_env::EnvVariableSet (hy_env::mpi_node_id, new _Constant (local_worker_rank), false);
+    }
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  long    LocalWorkerCount (void) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    return local_worker_count;
+#else
+    return 0L;
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  void    LocalWorkerSend (long node, _String const & message) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    if (local_worker_rank) {
+      throw _String ("Local workers can not send messages to other nodes");
+    }
+    if (node < 1L || node > local_worker_count) {
+      throw _String ("Local worker node index must be between 1 and ") & local_worker_count & " (was " & node & ")";
+    }
+    if (!local_worker_pids.get (node - 1L)) {
+      if (message.empty()) {
+        return; // no need to start a worker just to stop it
+      }
+      _StartLocalWorker (node);
+    }
+    if (!_SendToWorker (node, message)) {
+      _StopLocalWorker (node);
+      throw _String ("Failed to send a message to local worker ") & node & " (the worker may have terminated with an error)";
+    }
+    if (message.empty()) {
+      _StopLocalWorker (node);
+    }
+    hy_env::EnvVariableSet (hy_env::mpi_last_sent_message, new _FString (message, false), false);
+#else
+    throw _String ("Local workers are not supported by this build of HyPhy");
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  _String*    LocalWorkerReceive (long node, long & sender, hyFloat timeout) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    sender = -1L;
+    if (local_worker_rank) {
+      throw _String ("Local workers can not receive messages from other nodes");
+    }
+
+    if (node < 0L) {
+      // replies which were read while sending jobs come first
+      for (long k = 0L; k < local_worker_count; k++) {
+        long const candidate = (local_worker_next + k) % local_worker_count;
+        if (_String * reply = _TakeStoredReply (candidate + 1L)) {
+          local_worker_next = (candidate + 1L) % local_worker_count;
+          sender = candidate + 1L;
+          return reply;
+        }
+      }
+
+      _SimpleList   running;
+      for (long k = 0L; k < local_worker_count; k++) {
+        long const candidate = (local_worker_next + k) % local_worker_count;
+        if (local_worker_pids.get (candidate)) {
+          running << candidate;
+        }
+      }
+      if (running.empty()) {
+        throw _String ("No local workers are running; there are no messages to receive");
+      }
+
+      struct pollfd * descriptors = new struct pollfd [running.lLength];
+      for (unsigned long k = 0UL; k < running.lLength; k++) {
+        descriptors[k].fd      = local_worker_output.get (running.get (k));
+        descriptors[k].events  = POLLIN;
+        descriptors[k].revents = 0;
+      }
+
+      int const ready = _PollWithTimeout (descriptors, running.lLength, timeout);
+      if (ready == 0) {
+        delete [] descriptors;
+        return nil;
+      }
+
+      node = -1L;
+      for (unsigned long k = 0UL; k < running.lLength && ready > 0; k++) {
+        if (descriptors[k].revents) {
+          node = running.get (k) + 1L;
+          break;
+        }
+      }
+      delete [] descriptors;
+
+      if (node < 0L) {
+        throw _String ("Failed while waiting for messages from local workers");
+      }
+      local_worker_next = node % local_worker_count;
+    } else {
+      if (node < 1L || node > local_worker_count) {
+        throw _String ("Local worker node index must be between 1 and ") & local_worker_count & " (was " & node & ")";
+      }
+      if (_String * reply = _TakeStoredReply (node)) {
+        sender = node;
+        return reply;
+      }
+      if (!local_worker_pids.get (node - 1L)) {
+        throw _String ("Local worker ") & node & " is not running; there are no messages to receive";
+      }
+      if (timeout > 0.) {
+        struct pollfd descriptor = {(int)local_worker_output.get (node - 1L), POLLIN, 0};
+        if (_PollWithTimeout (&descriptor, 1, timeout) == 0) {
+          return nil;
+        }
+      }
+    }
+
+    _String * message = _ReceivePipeMessage ((int)local_worker_output.get (node - 1L));
+    if (!message) {
+      _StopLocalWorker (node);
+      sender = node;
+      throw _String ("Local worker ") & node & " terminated before sending a reply; check the error log for its error message";
+    }
+    sender = node;
+    return message;
+#else
+    throw _String ("Local workers are not supported by this build of HyPhy");
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  void    LocalWorkerTerminate (long node) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    if (node >= 1L && node <= local_worker_count && local_worker_rank == 0L) {
+      _StopLocalWorker (node, true);
+      ReportWarning (_String ("Terminated local worker ") & node);
+    }
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  void    ShutdownLocalWorkers (void) {
+#ifdef __HYPHY_LOCAL_WORKERS__
+    if (local_worker_rank == 0L) {
+      for (long node = 1L; node <= local_worker_count; node++) {
+        if (local_worker_pids.get (node - 1L)) {
+          _SendToWorker (node, kEmptyString);
+          _StopLocalWorker (node);
+        }
+      }
+    }
+#endif
+  }
+}
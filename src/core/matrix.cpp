@@ -2474,7 +2474,7 @@ bool        _Matrix::ProcessFormulas (long& stackLength, _AVLList& varList,   _S
                 thisFormula = theFormulas[i];
 
                 if (runAll || thisFormula->AmISimple(stackLength,varList)) {
-                    _String * flaString = (_String*)thisFormula->toStr(kFormulaStringConversionNormal, nil,true);
+                    _String * flaString = runAll ? (_String*)thisFormula->toStr(kFormulaStringConversionNormal, nil,true) : thisFormula->CanonicalForm();
                     long      fref = flaStrings.Insert(flaString,newFormulas.lLength);
                     if (fref < 0) {
                         references << flaStrings.GetXtra (-fref-1);
@@ -2503,7 +2503,7 @@ bool        _Matrix::ProcessFormulas (long& stackLength, _AVLList& varList,   _S
                 }
 
                 if (runAll || thisFormula->AmISimple(stackLength,varList)) {
-                    _String * flaString = (_String*)thisFormula->toStr(kFormulaStringConversionNormal, nil,true);
+                    _String * flaString = runAll ? (_String*)thisFormula->toStr(kFormulaStringConversionNormal, nil,true) : thisFormula->CanonicalForm();
                     long      fref = flaStrings.Insert(flaString,newFormulas.lLength);
                     if (fref < 0) {
                         references << flaStrings.GetXtra (-fref-1);
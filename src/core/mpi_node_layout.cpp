@@ -0,0 +1,366 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "mpi_node_layout.h"
+#include "global_things.h"
+#include "hbl_env.h"
+#include "hy_string_buffer.h"
+#include "simplelist.h"
+
+#ifdef __HYPHYMPI__
+
+#include <mpi.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#if defined __linux__
+  #define __HYPHY_CPU_AFFINITY__
+  #include <sched.h>
+  #include <dirent.h>
+#endif
+
+/** the longest description of a rank's layout sent to the master */
+static const int kNodeLayoutDescriptionLength = 256;
+
+static long host_rank_count   = 1L,
+            host_worker_count = 0L,
+            host_session_id   = 0L;
+
+#ifdef __HYPHY_CPU_AFFINITY__
+
+//____________________________________________________________________________________
+
+static void _ParseCPUList (const char * list, _SimpleList & cpus) {
+  // a list like "0-3,8,10-11", as in /sys/devices/system/node/node*/cpulist
+  while (*list) {
+    char * end;
+    long const from = strtol (list, &end, 10);
+    if (end == list) {
+      break;
+    }
+    long to = from;
+    if (*end == '-') {
+      list = end + 1;
+      to = strtol (list, &end, 10);
+      if (end == list) {
+        break;
+      }
+    }
+    for (long cpu = from; cpu <= to; cpu++) {
+      cpus << cpu;
+    }
+    list = end;
+    if (*list == ',') {
+      list++;
+    } else {
+      break;
+    }
+  }
+}
+
+//____________________________________________________________________________________
+
+static void _CPUsByNUMADomain (cpu_set_t const & allowed, _SimpleList & cpus, _SimpleList & domains) {
+  /* the CPUs in 'allowed', grouped by NUMA domain (in the order of domain indices);
+     domains[k] is the domain of cpus[k] (-1 if it could not be determined) */
+
+  _SimpleList  domain_indices;
+  if (DIR * node_directory = opendir ("/sys/devices/system/node")) {
+    while (struct dirent * entry = readdir (node_directory)) {
+      long domain;
+      char trailing;
+      if (sscanf (entry->d_name, "node%ld%c", &domain, &trailing) == 1) {
+        domain_indices << domain;
+      }
+    }
+    closedir (node_directory);
+  }
+  domain_indices.Sort ();
+
+  cpu_set_t assigned;
+  CPU_ZERO (&assigned);
+
+  for (unsigned long d = 0UL; d < domain_indices.countitems(); d++) {
+    char path [128],
+         list [4096];
+    snprintf (path, sizeof (path), "/sys/devices/system/node/node%ld/cpulist", domain_indices.get (d));
+    if (FILE * list_file = fopen (path, "r")) {
+      if (fgets (list, sizeof (list), list_file)) {
+        _SimpleList domain_cpus;
+        _ParseCPUList (list, domain_cpus);
+        domain_cpus.Each ([&] (long cpu, unsigned long) -> void {
+          if (cpu < CPU_SETSIZE && CPU_ISSET (cpu, &allowed) && !CPU_ISSET (cpu, &assigned)) {
+            CPU_SET (cpu, &assigned);
+            cpus    << cpu;
+            domains << domain_indices.get (d);
+          }
+        });
+      }
+      fclose (list_file);
+    }
+  }
+
+  // CPUs which are not listed in any domain (e.g. when /sys is not available) go last
+  for (long cpu = 0L; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET (cpu, &allowed) && !CPU_ISSET (cpu, &assigned)) {
+      cpus    << cpu;
+      domains << -1L;
+    }
+  }
+}
+
+//____________________________________________________________________________________
+
+static void _DescribeCPURange (_SimpleList const & cpus, _SimpleList const & domains, long first, long count, _StringBuffer & description) {
+  description << " on CPU";
+  if (count > 1L) {
+    description << 's';
+  }
+  description << ' ';
+  for (long k = first; k < first + count; k++) {
+    // collapse runs of consecutive CPUs into ranges
+    long run_end = k;
+    while (run_end + 1L < first + count && cpus.get (run_end + 1L) == cpus.get (run_end) + 1L) {
+      run_end++;
+    }
+    if (k > first) {
+      description << ',';
+    }
+    description << _String (cpus.get (k));
+    if (run_end > k) {
+      description << '-' << _String (cpus.get (run_end));
+    }
+    k = run_end;
+  }
+
+  _SimpleList used_domains;
+  for (long k = first; k < first + count; k++) {
+    if (domains.get (k) >= 0L && used_domains.Find (domains.get (k)) == kNotFound) {
+      used_domains << domains.get (k);
+    }
+  }
+  if (used_domains.nonempty()) {
+    description << " (NUMA domain" << (used_domains.countitems() > 1UL ? "s " : " ");
+    used_domains.Each ([&] (long domain, unsigned long index) -> void {
+      if (index) {
+        description << ',';
+      }
+      description << _String (domain);
+    });
+    description << ')';
+  }
+}
+
+#endif
+
+#endif
+
+namespace hy_global {
+
+  //____________________________________________________________________________________
+
+  void    ConfigureMPINodeLayout (void) {
+#ifdef __HYPHYMPI__
+    int      local_rank = 0,
+             local_size = 1,
+             host_name_length = 0;
+    char     host_name [MPI_MAX_PROCESSOR_NAME] = "";
+    MPI_Comm host_ranks;
+
+    bool const have_host_ranks = MPI_Comm_split_type (MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, hy_mpi_node_rank, MPI_INFO_NULL, &host_ranks) == MPI_SUCCESS;
+
+    if (have_host_ranks) {
+      MPI_Comm_rank (host_ranks, &local_rank);
+      MPI_Comm_size (host_ranks, &local_size);
+      host_session_id = getpid ();
+      MPI_Bcast (&host_session_id, 1, MPI_LONG, 0, host_ranks);
+      // ranks are ordered by their global rank, so the master is on this host if it is the first rank
+      long first_rank = hy_mpi_node_rank;
+      MPI_Bcast (&first_rank, 1, MPI_LONG, 0, host_ranks);
+      host_worker_count = local_size - (first_rank == 0L ? 1L : 0L);
+    }
+
+#ifdef __HYPHY_CPU_AFFINITY__
+    cpu_set_t  allowed;
+    bool const have_affinity = sched_getaffinity (0, sizeof (cpu_set_t), &allowed) == 0;
+    if (!have_affinity) {
+      CPU_ZERO (&allowed);
+    }
+
+    /* the launcher has bound ranks to CPUs only if the ranks on this host are allowed to run
+       on CPUs which do not overlap; a restricted set shared by the ranks (e.g. that of a
+       container or a batch job) must still be divided between them */
+    bool bound_by_launcher = false;
+    if (have_host_ranks && local_size > 1) {
+      cpu_set_t * host_masks = new cpu_set_t [local_size];
+      MPI_Allgather (&allowed, sizeof (cpu_set_t), MPI_BYTE, host_masks, sizeof (cpu_set_t), MPI_BYTE, host_ranks);
+      // every rank compares all pairs, so that all ranks on the host reach the same decision
+      bound_by_launcher = true;
+      for (int r = 0; r < local_size && bound_by_launcher; r++) {
+        if (CPU_COUNT (host_masks + r) == 0) {
+          bound_by_launcher = false;
+        }
+        for (int r2 = r + 1; r2 < local_size && bound_by_launcher; r2++) {
+          cpu_set_t common;
+          CPU_AND (&common, host_masks + r, host_masks + r2);
+          if (CPU_COUNT (&common) > 0) {
+            bound_by_launcher = false;
+          }
+        }
+      }
+      delete [] host_masks;
+    }
+#endif
+
+    if (have_host_ranks) {
+      MPI_Comm_free (&host_ranks);
+    }
+    host_rank_count = local_size;
+    if (!have_host_ranks) {
+      host_worker_count = hy_mpi_node_rank == 0L ? 0L : 1L;
+    }
+    if (MPI_Get_processor_name (host_name, &host_name_length) != MPI_SUCCESS) {
+      host_name[0] = 0;
+    }
+
+    _StringBuffer description;
+    description << "rank " << _String ((long)hy_mpi_node_rank) << " on " << _String ((const char*)host_name)
+                << " (" << _String ((long)local_rank + 1L) << " of " << _String ((long)local_size) << " on this host): ";
+
+    if (hy_env::EnvVariableGetNumber (hy_env::mpi_share_node_cores, 1.) != 0.) {
+#ifdef __HYPHY_CPU_AFFINITY__
+      _SimpleList cpus,
+                 domains;
+
+      if (have_affinity) {
+        _CPUsByNUMADomain (allowed, cpus, domains);
+      }
+
+      long const available = cpus.countitems();
+
+      if (available > 0L && bound_by_launcher) {
+        // each rank has CPUs of its own; use them as they are
+        system_CPU_count = MIN (system_CPU_count, available);
+        description << _String (system_CPU_count) << " thread(s), bound by the launcher";
+        _DescribeCPURange (cpus, domains, 0L, available, description);
+      } else if (available > 0L) {
+        // consecutive ranks get consecutive blocks of CPUs, so that blocks stay within NUMA domains
+        long const share = available / local_size,
+                   extra = available % local_size;
+        long       first = local_rank * share + MIN ((long)local_rank, extra),
+                   count = share + (local_rank < extra ? 1L : 0L);
+
+        if (count == 0L) { // more ranks than CPUs: ranks take turns on CPUs
+          first = local_rank % available;
+          count = 1L;
+        }
+
+        cpu_set_t block;
+        CPU_ZERO (&block);
+        for (long k = first; k < first + count; k++) {
+          CPU_SET (cpus.get (k), &block);
+        }
+        // threads started later (including OpenMP workers) inherit the affinity of the main thread
+        bool const pinned = sched_setaffinity (0, sizeof (cpu_set_t), &block) == 0;
+
+        system_CPU_count = MIN (system_CPU_count, count);
+        description << _String (system_CPU_count) << " thread(s)" << (pinned ? ", pinned" : ", could not be pinned");
+        _DescribeCPURange (cpus, domains, first, count, description);
+      } else {
+        description << _String (system_CPU_count) << " thread(s), CPU affinity unavailable";
+      }
+#else
+      long const online = sysconf (_SC_NPROCESSORS_ONLN);
+      if (online > 0L) {
+        system_CPU_count = MIN (system_CPU_count, MAX (1L, online / local_size + (local_rank < online % local_size ? 1L : 0L)));
+      }
+      description << _String (system_CPU_count) << " thread(s)";
+#endif
+    } else {
+      description << _String (system_CPU_count) << " thread(s), cores not shared out (MPI_SHARE_NODE_CORES = 0)";
+    }
+
+    ReportWarning (_String ("[MPI] Node layout: ") & description);
+
+    // the master logs the layout of every rank
+    char   local_description [kNodeLayoutDescriptionLength];
+    char * all_descriptions = hy_mpi_node_rank == 0L ? new char [kNodeLayoutDescriptionLength * hy_mpi_node_count] : nil;
+
+    snprintf (local_description, kNodeLayoutDescriptionLength, "%s", description.get_str());
+    MPI_Gather (local_description, kNodeLayoutDescriptionLength, MPI_CHAR, all_descriptions, kNodeLayoutDescriptionLength, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    if (all_descriptions) {
+      for (long rank = 1L; rank < hy_mpi_node_count; rank++) {
+        ReportWarning (_String ("[MPI] Node layout: ") & _String (all_descriptions + rank * kNodeLayoutDescriptionLength));
+      }
+      delete [] all_descriptions;
+    }
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  long    MPIHostRankCount (void) {
+#ifdef __HYPHYMPI__
+    return host_rank_count;
+#else
+    return 1L;
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  long    MPIHostWorkerCount (void) {
+#ifdef __HYPHYMPI__
+    return host_worker_count;
+#else
+    return 0L;
+#endif
+  }
+
+  //____________________________________________________________________________________
+
+  long    MPIHostSessionID (void) {
+#ifdef __HYPHYMPI__
+    return host_session_id;
+#else
+    return 0L;
+#endif
+  }
+}
@@ -49,6 +49,10 @@
 #include "global_object_lists.h"
 #include "global_things.h"
 
+#ifdef _OPENMP
+  #include "omp.h"
+#endif
+
 
 using namespace hy_global;
 using namespace hyphy_global_objects;
@@ -81,6 +85,9 @@ void    NexusParseEqualStatement    (_String&);
 
 static auto  error_conext = [] (_String const& buffer, long position) -> const _String {return (buffer.Cut (0,position) & " <=? " & buffer.Cut (position+1,kStringEnd)).Enquote();};
 
+/** the minimum number of tree strings per thread when post-processing a TREES block */
+static const long kNexusTreesPerThread = 64L;
+
 
 //_________________________________________________________
 
@@ -573,7 +580,8 @@ void    ProcessNexusTrees (FileState& fState, long pos, FILE*f, _String& Current
 
     bool    done = false, readResult, good;
     _List   translationsFrom, translationsTo;
-    _List   treeIdents, treeStrings;
+    _List   treeIdents, treeStrings,
+            sortedTreeIdents; // a sorted copy of treeIdents for fast name uniqueness checks
     long    treeSelected = 0, insertPos = 0;
 
     while (!done) {
@@ -648,7 +656,8 @@ void    ProcessNexusTrees (FileState& fState, long pos, FILE*f, _String& Current
                                   tree_id = nexus_tree_id.ConvertToAnIdent();
                                 }
                                 
-                                tree_id = treeIdents.GenerateUniqueNameForList(GenerateUniqueObjectIDByType (nexus_tree_id, HY_BL_TREE) ,false);
+                                tree_id = sortedTreeIdents.GenerateUniqueNameForList(GenerateUniqueObjectIDByType (nexus_tree_id, HY_BL_TREE) ,true);
+                                sortedTreeIdents.BinaryInsert (&tree_id);
                               
                                 if (tree_id != nexus_tree_id) {
                                   ReportWarning(nexus_tree_id.Enquote('\'') & " has been renamed to " & tree_id.Enquote('\'') & " to avoid naming conflicts and/or comply with HyPhy ID requirements");
@@ -690,9 +699,18 @@ void    ProcessNexusTrees (FileState& fState, long pos, FILE*f, _String& Current
     }
 
     // now we shall check the string and match up node names with those present in the file
-
-    for (long id = 0L; id<treeStrings.lLength; id++) {
-        _String const * file_tree_string = (_String const *) treeStrings (id);
+    // tree strings are independent of each other, so they are processed in parallel;
+    // warnings are stored by tree and reported in the file order afterwards
+
+    long const tree_count = treeStrings.lLength;
+    _List * tree_warnings = new _List [tree_count];
+
+#ifdef _OPENMP
+    long const nt = MIN(omp_get_max_threads(), tree_count / kNexusTreesPerThread);
+#pragma omp parallel for default(shared) schedule(dynamic, kNexusTreesPerThread) if (nt > 1) num_threads(nt)
+#endif
+    for (long id = 0L; id<tree_count; id++) {
+        _String const * file_tree_string = (_String const *) treeStrings.GetItem (id);
         long    treeLevel = 0L,
                 lastNode,
                 i = 0L;
@@ -744,7 +762,7 @@ void    ProcessNexusTrees (FileState& fState, long pos, FILE*f, _String& Current
                     break;
                   }
                   if (!(isalnum(c)||(c=='_'))) {
-                    ReportWarning (_String("Node names should begin with a letter, a number, or an underscore: ") & error_conext (*file_tree_string, i) );
+                    tree_warnings[id] < new _String (_String("Node names should begin with a letter, a number, or an underscore: ") & error_conext (*file_tree_string, i));
                     i = file_tree_string->length() +2;
                     break;
                   }
@@ -769,44 +787,37 @@ void    ProcessNexusTrees (FileState& fState, long pos, FILE*f, _String& Current
           }
         }
         if (treeLevel) {
-            ReportWarning (_String("Unbalanced '(,)' in the tree string:") & revisedTreeString.Enquote());
+            tree_warnings[id] < new _String (_String("Unbalanced '(,)' in the tree string:") & revisedTreeString.Enquote());
         } else if (i==file_tree_string->length()) {
             *((_String*)treeStrings.list_data[id]) = revisedTreeString;
         }
     }
 
+    for (long id = 0L; id<tree_count; id++) {
+        tree_warnings[id].ForEach ([] (BaseRef warning, unsigned long) -> void {
+            ReportWarning (*(_String const*)warning);
+        });
+    }
+    delete [] tree_warnings;
+
     if (treeSelected < treeStrings.lLength) {
         hy_env :: EnvVariableSetNamespace(hy_env::data_file_tree, new HY_CONSTANT_TRUE,fState.theNamespace, false);
         hy_env :: EnvVariableSetNamespace(hy_env::data_file_tree_string, new _FString(*(_String*)treeStrings.list_data[treeSelected], false),fState.theNamespace, false);
+        result.SetTreeString (*(_String*)treeStrings.list_data[treeSelected]);
      }
 
     if (treeStrings.lLength) {
-        _StringBuffer initTreeMatrix (1024UL);
-
-        initTreeMatrix   << hy_env::nexus_file_tree_matrix
-                         << "={"
-                         << _String ((long)treeStrings.lLength)
-                         << ",2};\n";
-
-
-        for (long id = 0; id < treeStrings.lLength; id++) {
-            initTreeMatrix   << hy_env::nexus_file_tree_matrix
-                             << '['
-                             << _String (id)
-                             << "][0]=\""
-                             << (_String*)treeIdents(id)
-                             << "\";\n"
-                             << hy_env::nexus_file_tree_matrix
-                             << '['
-                             << _String (id)
-                             << "][1]=\""
-                             << (_String*)treeStrings(id)
-                             << "\";\n";
+        // populate the tree matrix directly, rather than generating
+        // and executing HBL code to do it
+        _Matrix * tree_matrix = new _Matrix (treeStrings.lLength, 2, false, true);
+        tree_matrix->Convert2Formulas();
+
+        for (long id = 0L; id < treeStrings.lLength; id++) {
+            tree_matrix->StoreFormula (id, 0, *new _Formula (new _FString (*(_String*)treeIdents.GetItem (id))), false, false);
+            tree_matrix->StoreFormula (id, 1, *new _Formula (new _FString (*(_String*)treeStrings.GetItem (id))), false, false);
         }
 
-        _ExecutionList el (initTreeMatrix);
-        el.Execute();
-        terminate_execution = false;
+        hy_env :: EnvVariableSet (hy_env::nexus_file_tree_matrix, tree_matrix, false);
     }
     SkipUntilNexusBlockEnd (fState, f,CurrentLine, pos);
 }
@@ -64,27 +64,47 @@ using namespace hy_global;
 
 //_________________________________________________________
 
-_Site::_Site(void) : _StringBuffer (16L) { refNo = -1; }
+_Site::_Site(void) : _StringBuffer (16L) { refNo = -1; image = nil; }
 
 //_________________________________________________________
 _Site::_Site(_String const &s) : _StringBuffer (s.length()) {
   refNo = -1;
+  image = nil;
   (*this) << &s;
 }
 
 //_________________________________________________________
 _Site::_Site(char s) : _StringBuffer (16L) {
   refNo = -1;
+  image = nil;
   (*this) << s;
 }
 
 //_________________________________________________________
 _Site::_Site(long s) {
   SetRefNo(s);
+  image = nil;
 }
 
 //_________________________________________________________
-_Site::~_Site(void) {}
+_Site::_Site(char const * characters, unsigned long length, BaseObj * owner) : _StringBuffer (0UL) {
+  refNo = -1;
+  free (s_data);
+  s_data   = (char*)characters;
+  s_length = length;
+  image    = owner;
+  owner->AddAReference();
+}
+
+//_________________________________________________________
+_Site::~_Site(void) {
+  if (image) {
+    // the characters belong to the image; keep ~_String from freeing them
+    s_data   = nil;
+    s_length = 0UL;
+    DeleteObject (image);
+  }
+}
 
 //_________________________________________________________
 void _Site::Complete(void) {
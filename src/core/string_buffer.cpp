@@ -44,7 +44,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 using namespace hy_global;
 
-#include <string.h> // for strlen
+#include <string.h> // for strlen, memcpy
 #include <utility>  // for std::move
 
 
@@ -233,12 +233,6 @@ _StringBuffer& _StringBuffer::operator<<(const char *str) {
   return *this;
 }
 
-//=============================================================
-_StringBuffer& _StringBuffer::operator<<(const char c) {
-  this->PushChar(c);
-  return *this;
-}
-
 /*
 ==============================================================
 Methods
@@ -261,9 +255,7 @@ void _StringBuffer::PushCharBuffer( const char* buffer,
     s_length += buffer_l;
     this->ResizeString();
 
-    for (unsigned long k = 0UL; k < buffer_l; k++) {
-      s_data[offset + k] = buffer[k];
-    }
+    memcpy (s_data + offset, buffer, buffer_l);
     s_data[s_length] = '\0';
   }
 }
@@ -291,8 +283,15 @@ _StringBuffer& _StringBuffer::AppendSubstring(const _String& source, long start,
  long requested_range = source.NormalizeRange(start, end);
  
   if (requested_range > 0L) {
-      for (long i = start; i <= end; i++) {
-          (*this) << source.char_at(i);
+      if (&source == this) {
+          // resizing may move the buffer, so copy from it afterwards; the ranges do not overlap
+          unsigned long const offset = s_length;
+          s_length += requested_range;
+          this->ResizeString();
+          memcpy (s_data + offset, s_data + start, requested_range);
+          s_data[s_length] = '\0';
+      } else {
+          this->PushCharBuffer(source.get_str() + start, requested_range);
       }
   }
   return (*this);
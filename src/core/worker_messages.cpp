@@ -0,0 +1,493 @@
+/*
+
+ HyPhy - Hypothesis Testing Using Phylogenies.
+
+ Copyright (C) 1997-now
+ Core Developers:
+ Sergei L Kosakovsky Pond (sergeilkp@icloud.com)
+ Art FY Poon    (apoon42@uwo.ca)
+ Steven Weaver (sweaver@temple.edu)
+
+ Module Developers:
+ Lance Hepler (nlhepler@gmail.com)
+ Martin Smith (martin.audacis@gmail.com)
+
+ Significant contributions from:
+ Spencer V Muse (muse@stat.ncsu.edu)
+ Simon DW Frost (sdf22@cam.ac.uk)
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+
+#include "worker_messages.h"
+#include "global_things.h"
+#include "constant.h"
+#include "fstring.h"
+#include "matrix.h"
+#include "associative_list.h"
+
+#include <string.h>
+
+/** binary messages start with a prefix which can not begin HBL code or a string result */
+static const char          kWorkerValueMagic []     = "\x1BHYB";
+static const unsigned long kWorkerValueMagicLength  = 4UL;
+
+/** failure replies (see EncodeWorkerFailure) have a prefix of the same length, followed by the error message */
+static const char          kWorkerFailureMagic []   = "\x1BHYF";
+
+/** value tags */
+static const char          kWorkerValueNumber       = 'N',
+                           kWorkerValueString       = 'S',
+                           kWorkerValueMatrix       = 'M',
+                           kWorkerValueDictionary   = 'D',
+                           kWorkerValueText         = 'T',
+                           kWorkerValueRetained     = 'R';
+
+/** the key of job arguments in binary jobs (see EncodeWorkerJob) */
+static const _String       kWorkerJobArguments      ("arguments");
+
+static _List               worker_sent_arguments;   // master: per node, argument key -> the encoded value last sent to the node
+static _AssociativeList  * worker_retained_arguments = nil; // worker: argument key -> the encoded value last received
+
+//____________________________________________________________________________________
+
+static bool _IsBinaryMatrix (HBLObjectRef value) {
+  return value->ObjectClass () == MATRIX && ((_Matrix*)value)->is_numeric ();
+}
+
+//____________________________________________________________________________________
+
+static unsigned long _EncodedStringSize (_String const & value) {
+  return sizeof (unsigned long) + value.length ();
+}
+
+//____________________________________________________________________________________
+
+static unsigned long _EncodedSize (HBLObjectRef value, _List & text_values) {
+  // string representations of values without a binary form are generated once, and stored in text_values
+  switch (value->ObjectClass ()) {
+    case NUMBER:
+      return 1UL + sizeof (hyFloat);
+    case STRING:
+      return 1UL + _EncodedStringSize (((_FString*)value)->get_str());
+    case ASSOCIATIVE_LIST: {
+      _AssociativeList * dictionary = (_AssociativeList*)value;
+      _List * keys = dictionary->GetKeys ();
+      unsigned long size = 1UL + sizeof (unsigned long);
+      for (unsigned long k = 0UL; k < keys->countitems(); k++) {
+        _String * key = (_String*)keys->GetItem (k);
+        if (key) {
+          size += _EncodedStringSize (*key) + _EncodedSize (dictionary->GetByKey (*key), text_values);
+        }
+      }
+      DeleteObject (keys);
+      return size;
+    }
+  }
+
+  if (_IsBinaryMatrix (value)) {
+    _Matrix * matrix = (_Matrix*)value;
+    return 1UL + 2UL * sizeof (unsigned long) + matrix->GetHDim () * matrix->GetVDim () * sizeof (hyFloat);
+  }
+
+  _String * text = (_String*)value->toStr ();
+  text_values.AppendNewInstance (text);
+  return 1UL + _EncodedStringSize (*text);
+}
+
+//____________________________________________________________________________________
+
+static char * _EncodeString (_String const & value, char * buffer) {
+  unsigned long const length = value.length ();
+  memcpy (buffer, &length, sizeof (unsigned long));
+  memcpy (buffer + sizeof (unsigned long), value.get_str(), length);
+  return buffer + sizeof (unsigned long) + length;
+}
+
+//____________________________________________________________________________________
+
+static char * _EncodeValue (HBLObjectRef value, char * buffer, _List const & text_values, unsigned long & next_text) {
+  switch (value->ObjectClass ()) {
+    case NUMBER: {
+      hyFloat const number = value->Value ();
+      *(buffer++) = kWorkerValueNumber;
+      memcpy (buffer, &number, sizeof (hyFloat));
+      return buffer + sizeof (hyFloat);
+    }
+    case STRING:
+      *(buffer++) = kWorkerValueString;
+      return _EncodeString (((_FString*)value)->get_str(), buffer);
+    case ASSOCIATIVE_LIST: {
+      _AssociativeList * dictionary = (_AssociativeList*)value;
+      _List * keys = dictionary->GetKeys ();
+      unsigned long const count = dictionary->countitems ();
+      *(buffer++) = kWorkerValueDictionary;
+      memcpy (buffer, &count, sizeof (unsigned long));
+      buffer += sizeof (unsigned long);
+      for (unsigned long k = 0UL; k < keys->countitems(); k++) {
+        _String * key = (_String*)keys->GetItem (k);
+        if (key) {
+          buffer = _EncodeValue (dictionary->GetByKey (*key), _EncodeString (*key, buffer), text_values, next_text);
+        }
+      }
+      DeleteObject (keys);
+      return buffer;
+    }
+  }
+
+  if (_IsBinaryMatrix (value)) {
+    _Matrix * matrix = (_Matrix*)value;
+    unsigned long const rows    = matrix->GetHDim (),
+                        columns = matrix->GetVDim ();
+    *(buffer++) = kWorkerValueMatrix;
+    memcpy (buffer, &rows, sizeof (unsigned long));
+    memcpy (buffer + sizeof (unsigned long), &columns, sizeof (unsigned long));
+    buffer += 2UL * sizeof (unsigned long);
+    if (matrix->is_dense ()) {
+      memcpy (buffer, matrix->theData, rows * columns * sizeof (hyFloat));
+      buffer += rows * columns * sizeof (hyFloat);
+    } else {
+      for (unsigned long r = 0UL; r < rows; r++) {
+        for (unsigned long c = 0UL; c < columns; c++) {
+          hyFloat const cell = (*matrix)(r,c);
+          memcpy (buffer, &cell, sizeof (hyFloat));
+          buffer += sizeof (hyFloat);
+        }
+      }
+    }
+    return buffer;
+  }
+
+  *(buffer++) = kWorkerValueText;
+  return _EncodeString (*(_String*)text_values.GetItem (next_text++), buffer);
+}
+
+//____________________________________________________________________________________
+
+static _String * _EncodeWithOffset (HBLObjectRef value, unsigned long offset) {
+  // the value is written after 'offset' bytes which are left for the caller to fill in
+  _List          text_values;
+  unsigned long  next_text = 0UL;
+  _String      * message = new _String (offset + _EncodedSize (value, text_values));
+  _EncodeValue (value, (char*)message->get_str() + offset, text_values, next_text);
+  return message;
+}
+
+//____________________________________________________________________________________
+
+class _WorkerValueReader {
+
+public:
+
+  _WorkerValueReader (_String const & message) : message (message), position (kWorkerValueMagicLength) {}
+
+  HBLObjectRef ReadValue (void) {
+    char const tag = ReadBytes (1UL)[0];
+
+    switch (tag) {
+      case kWorkerValueNumber: {
+        hyFloat number;
+        memcpy (&number, ReadBytes (sizeof (hyFloat)), sizeof (hyFloat));
+        return new _Constant (number);
+      }
+      case kWorkerValueString:
+        return new _FString (ReadString (), false);
+      case kWorkerValueText: {
+        _FString     text (ReadString (), false);
+        return text.Evaluate (_hyDefaultExecutionContext);
+      }
+      case kWorkerValueMatrix: {
+        unsigned long const rows    = ReadLength (),
+                            columns = ReadLength ();
+        if (columns && rows > (message.length() - position) / sizeof (hyFloat) / columns) {
+          throw _String ("Truncated binary MPI message");
+        }
+        _Matrix * matrix = new _Matrix (rows, columns, false, true);
+        if (rows * columns) {
+          memcpy (matrix->theData, ReadBytes (rows * columns * sizeof (hyFloat)), rows * columns * sizeof (hyFloat));
+        }
+        return matrix;
+      }
+      case kWorkerValueDictionary: {
+        unsigned long const count = ReadLength ();
+        _AssociativeList * dictionary = new _AssociativeList;
+        try {
+          for (unsigned long k = 0UL; k < count; k++) {
+            _String const key (ReadString ());
+            dictionary->MStore (key, ReadValue (), false);
+          }
+        } catch (const _String&) {
+          DeleteObject (dictionary);
+          throw;
+        }
+        return dictionary;
+      }
+    }
+    throw _String ("Invalid value type in a binary MPI message");
+  }
+
+  HBLObjectRef ReadJob (void) {
+    // a dictionary whose "arguments" entry may refer to arguments received with earlier jobs
+    if (ReadBytes (1UL)[0] != kWorkerValueDictionary) {
+      throw _String ("A binary MPI job must be a dictionary");
+    }
+    unsigned long const count = ReadLength ();
+    _AssociativeList * job = new _AssociativeList;
+    try {
+      for (unsigned long k = 0UL; k < count; k++) {
+        _String const key (ReadString ());
+        job->MStore (key, key == kWorkerJobArguments ? ReadArguments () : ReadValue (), false);
+      }
+    } catch (const _String&) {
+      DeleteObject (job);
+      throw;
+    }
+    return job;
+  }
+
+  bool AtEnd (void) const {
+    return position == message.length();
+  }
+
+private:
+
+  HBLObjectRef ReadArguments (void) {
+    if (ReadBytes (1UL)[0] != kWorkerValueDictionary) {
+      throw _String ("Binary MPI job arguments must be a dictionary");
+    }
+    if (!worker_retained_arguments) {
+      worker_retained_arguments = new _AssociativeList;
+    }
+    unsigned long const count = ReadLength ();
+    _AssociativeList * arguments = new _AssociativeList;
+    try {
+      for (unsigned long k = 0UL; k < count; k++) {
+        _String const key (ReadString ());
+        if (position < message.length() && message.char_at (position) == kWorkerValueRetained) {
+          // unchanged since the last job; the value is rebuilt from the stored copy,
+          // because the job is free to modify its arguments
+          position ++;
+          HBLObjectRef retained = worker_retained_arguments->GetByKey (key, STRING);
+          if (!retained) {
+            throw _String ("Job argument ") & key.Enquote() & " refers to a value which was not sent to this node";
+          }
+          _WorkerValueReader retained_reader (((_FString*)retained)->get_str());
+          retained_reader.position = 0UL;
+          arguments->MStore (key, retained_reader.ReadValue (), false);
+        } else {
+          unsigned long const start = position;
+          arguments->MStore (key, ReadValue (), false);
+          worker_retained_arguments->MStore (key, new _FString (message.Cut (start, position - 1UL), false), false);
+        }
+      }
+    } catch (const _String&) {
+      DeleteObject (arguments);
+      throw;
+    }
+    return arguments;
+  }
+
+  const char * ReadBytes (unsigned long size) {
+    if (size > message.length() - position) {
+      throw _String ("Truncated binary MPI message");
+    }
+    const char * bytes = message.get_str() + position;
+    position += size;
+    return bytes;
+  }
+
+  unsigned long ReadLength (void) {
+    unsigned long length;
+    memcpy (&length, ReadBytes (sizeof (unsigned long)), sizeof (unsigned long));
+    return length;
+  }
+
+  _String ReadString (void) {
+    unsigned long const length = ReadLength ();
+    const char * characters = ReadBytes (length);
+    _String result (length);
+    memcpy ((char*)result.get_str(), characters, length);
+    return result;
+  }
+
+  _String const & message;
+  unsigned long   position;
+};
+
+namespace hy_global {
+
+  //____________________________________________________________________________________
+
+  _String*    EncodeWorkerValue (HBLObjectRef value) {
+    _Constant zero (0.);
+    if (!value) {
+      value = &zero;
+    }
+
+    _String * message = _EncodeWithOffset (value, kWorkerValueMagicLength);
+    memcpy ((char*)message->get_str(), kWorkerValueMagic, kWorkerValueMagicLength);
+    return message;
+  }
+
+  //____________________________________________________________________________________
+
+  _String*    EncodeWorkerJob (_AssociativeList * job, long node) {
+    HBLObjectRef arguments = job->GetByKey (kWorkerJobArguments, ASSOCIATIVE_LIST);
+    if (!arguments || node < 1L) {
+      return EncodeWorkerValue (job);
+    }
+
+    while (worker_sent_arguments.countitems() < (unsigned long)node) {
+      worker_sent_arguments.AppendNewInstance (new _AssociativeList);
+    }
+    _AssociativeList * sent = (_AssociativeList*)worker_sent_arguments.GetItem (node - 1L);
+
+    // each argument is encoded on its own; if the node already holds the same value
+    // under the same key, only the 'retained' tag is sent
+    _List            argument_keys,
+                     encoded_arguments;
+    unsigned long    arguments_size = 1UL + sizeof (unsigned long);
+
+    _List * keys = ((_AssociativeList*)arguments)->GetKeys ();
+    for (unsigned long k = 0UL; k < keys->countitems(); k++) {
+      _String * key = (_String*)keys->GetItem (k);
+      if (key) {
+        _String * encoded = _EncodeWithOffset (((_AssociativeList*)arguments)->GetByKey (*key), 0UL);
+        HBLObjectRef previous = sent->GetByKey (*key, STRING);
+        if (previous && ((_FString*)previous)->get_str() == *encoded) {
+          DeleteObject (encoded);
+          encoded = new _String (kWorkerValueRetained);
+        } else {
+          sent->MStore (*key, new _FString (*encoded, false), false);
+        }
+        argument_keys << key;
+        encoded_arguments.AppendNewInstance (encoded);
+        arguments_size += _EncodedStringSize (*key) + encoded->length();
+      }
+    }
+    DeleteObject (keys);
+
+    _List          text_values;
+    unsigned long  next_text = 0UL,
+                   size      = kWorkerValueMagicLength + 1UL + sizeof (unsigned long);
+
+    keys = job->GetKeys ();
+    for (unsigned long k = 0UL; k < keys->countitems(); k++) {
+      _String * key = (_String*)keys->GetItem (k);
+      if (key) {
+        size += _EncodedStringSize (*key) + (*key == kWorkerJobArguments ? arguments_size : _EncodedSize (job->GetByKey (*key), text_values));
+      }
+    }
+
+    _String       * message = new _String (size);
+    char          * buffer  = (char*)message->get_str();
+    unsigned long   count   = job->countitems (),
+                    argument_count = argument_keys.countitems ();
+
+    memcpy (buffer, kWorkerValueMagic, kWorkerValueMagicLength);
+    buffer += kWorkerValueMagicLength;
+    *(buffer++) = kWorkerValueDictionary;
+    memcpy (buffer, &count, sizeof (unsigned long));
+    buffer += sizeof (unsigned long);
+
+    for (unsigned long k = 0UL; k < keys->countitems(); k++) {
+      _String * key = (_String*)keys->GetItem (k);
+      if (key) {
+        buffer = _EncodeString (*key, buffer);
+        if (*key == kWorkerJobArguments) {
+          *(buffer++) = kWorkerValueDictionary;
+          memcpy (buffer, &argument_count, sizeof (unsigned long));
+          buffer += sizeof (unsigned long);
+          for (unsigned long a = 0UL; a < argument_count; a++) {
+            _String const * encoded = (_String const*)encoded_arguments.GetItem (a);
+            buffer = _EncodeString (*(_String const*)argument_keys.GetItem (a), buffer);
+            memcpy (buffer, encoded->get_str(), encoded->length());
+            buffer += encoded->length();
+          }
+        } else {
+          buffer = _EncodeValue (job->GetByKey (*key), buffer, text_values, next_text);
+        }
+      }
+    }
+    DeleteObject (keys);
+    return message;
+  }
+
+  //____________________________________________________________________________________
+
+  void    ForgetWorkerJobArguments (long node) {
+    if (node >= 1L && (unsigned long)node <= worker_sent_arguments.countitems()) {
+      ((_AssociativeList*)worker_sent_arguments.GetItem (node - 1L))->Clear ();
+    }
+  }
+
+  //____________________________________________________________________________________
+
+  bool    IsWorkerValueMessage (_String const & message) {
+    return message.length() > kWorkerValueMagicLength && memcmp (message.get_str(), kWorkerValueMagic, kWorkerValueMagicLength) == 0;
+  }
+
+  //____________________________________________________________________________________
+
+  _String*    EncodeWorkerFailure (_String const & error) {
+    _String * message = new _String ((unsigned long)(kWorkerValueMagicLength + error.length()));
+    memcpy ((char*)message->get_str(), kWorkerFailureMagic, kWorkerValueMagicLength);
+    memcpy ((char*)message->get_str() + kWorkerValueMagicLength, error.get_str(), error.length());
+    return message;
+  }
+
+  //____________________________________________________________________________________
+
+  bool    IsWorkerFailureMessage (_String const & message) {
+    return message.length() >= kWorkerValueMagicLength && memcmp (message.get_str(), kWorkerFailureMagic, kWorkerValueMagicLength) == 0;
+  }
+
+  //____________________________________________________________________________________
+
+  const _String    DecodeWorkerFailure (_String const & message) {
+    return message.Cut (kWorkerValueMagicLength, kStringEnd);
+  }
+
+  //____________________________________________________________________________________
+
+  HBLObjectRef    DecodeWorkerValue (_String const & message) {
+    _WorkerValueReader reader (message);
+    HBLObjectRef value = reader.ReadValue ();
+    if (!reader.AtEnd ()) {
+      DeleteObject (value);
+      throw _String ("Unexpected trailing data in a binary MPI message");
+    }
+    return value;
+  }
+
+  //____________________________________________________________________________________
+
+  HBLObjectRef    DecodeWorkerJob (_String const & message) {
+    _WorkerValueReader reader (message);
+    HBLObjectRef job = reader.ReadJob ();
+    if (!reader.AtEnd ()) {
+      DeleteObject (job);
+      throw _String ("Unexpected trailing data in a binary MPI message");
+    }
+    return job;
+  }
+}
@@ -46,6 +46,10 @@
 
 #include "global_things.h"
 
+#ifdef _OPENMP
+#include "omp.h"
+#endif
+
 using namespace hy_global;
 
 const   _String  kBGMContraintMatrix ("BGM_CONSTRAINT_MATRIX");
@@ -287,7 +291,7 @@ _BayesianGraphicalModel::~_BayesianGraphicalModel (void) {
 
 
 //__________________________________________________________________________________________________________
-bool _BayesianGraphicalModel::SetDataMatrix (_Matrix const * data) {
+bool _BayesianGraphicalModel::SetDataMatrix (_Matrix const * data, bool cache_scores) {
     
     const static _String _HYBgm_CONTINUOUS_MISSING_VALUE ("BGM_CONTINUOUS_MISSING_VALUE");
     
@@ -376,7 +380,9 @@ bool _BayesianGraphicalModel::SetDataMatrix (_Matrix const * data) {
     }
 
     // compute node scores and store in cache
-    CacheNodeScores();
+    if (cache_scores) {
+        CacheNodeScores();
+    }
     return true;
 }
 
@@ -896,449 +902,368 @@ void    _BayesianGraphicalModel::CacheNodeScores (void) {
 
         Each of these _List object are in turn stored in a _List object that is a class member
         variable [node_score_cache].
+
+        The storage is allocated up front and split into chunks of (child node,
+        number of parents, [from, to) index range); chunks are scored by a dynamically
+        scheduled pool of threads, or handed out on request to MPI compute nodes, which
+        send back raw scores that are written directly into the storage
         ----------------------------------------------------------------------------------- */
 
     //ReportWarning (_String ("Entered CacheNodeScores()"));
-  
+
     static const _String kHYBgm_MPI_CACHING ("USE_MPI_CACHING");
 
     if (scores_cached) {
         return;
     }
-  
+
     try {
 
-      _SimpleList     all_but_one (num_nodes-1L, 0, 1),
-                      nk_tuple;
-      
-      _Matrix         single_parent_scores (num_nodes, 1, false, true);
-      
-      auto            handle_node_score = [this, &single_parent_scores,&all_but_one,&nk_tuple] (long node_id) -> _List * {
-                          _SimpleList parents (0L),
-                                      aux_list;
-        
-                          _List*      list_of_matrices = new _List;;
-                          long        maxp = max_parents.get(node_id);
-                          hyFloat     score;
-        
-                            // compute single parent scores
-                          for (long par = 0L; par < num_nodes; par++) {
-                            if (par == node_id) {   // child cannot be its own parent
-                              continue;
-                            }
-                            
-                            parents[0UL] = par;
-                            
-                            if (is_node_discrete(node_id) ) {
-                                // discrete-valued child node cannot have continuous parent
-                              if (is_node_discrete (par)) {
-                                score = ComputeDiscreteScore (node_id, parents);
-                              }
-                            } else {
-                                // continuous child can have discrete or continuous parents
-                              score = ComputeContinuousScore (node_id, parents);
-                            }
-                            
-                            single_parent_scores.Store (par, 0UL, score);
-                          }
-                            // compute multiple parent scores
-                          for (long np = 2; np <= maxp; np++) {
-                            _NTupleStorage * family_scores = new _NTupleStorage (num_nodes-1, np);
-                            
-                            parents << 0L;   // allocate space for one additional parent
-                            
-                            if (all_but_one.NChooseKInit (aux_list, nk_tuple, np, false)) {
-                              bool    remaining, family_is_discrete;
-                              
-                              do {
-                                remaining = all_but_one.NChooseK (aux_list, nk_tuple);
-                                
-                                if (is_node_discrete(node_id)) {
-                                  family_is_discrete = TRUE;
-                                  for (long par, par_idx = 0; par_idx < np; par_idx++) {
-                                    par = nk_tuple.get(par_idx);
-                                    if (par >= node_id) {
-                                      par++;
-                                    }
-                                    
-                                    if (is_node_discrete (par) == false) {    // all parents must be discrete
-                                      family_is_discrete = false;
-                                      break;
-                                    }
-                                    
-                                    parents[par_idx] = par;
-                                  }
-                                  
-                                  if (family_is_discrete) {
-                                    score = ComputeDiscreteScore (node_id, parents);
-                                  }
-                                } else {
-                                  for (long par_idx = 0; par_idx < np; par_idx++) {
-                                    long par = nk_tuple.list_data[par_idx];
-                                    if (par >= node_id) {
-                                      par++;
-                                    }
-                                    parents.list_data[par_idx] = par;
-                                  }
-                                  
-                                  score = ComputeContinuousScore (node_id, parents);
-                                }
-                                
-                                family_scores->Store (score, nk_tuple);
-                              } while (remaining);
-                            } else {
-                              throw _String("Failed to initialize _NTupleStorage object in Bgm::CacheNodeScores().\n");
-                            }
-                            
-                            list_of_matrices->AppendNewInstance(family_scores);   // append duplicate to storage
-                          }
-                          return list_of_matrices;
-        
-                      };
+      _Matrix         orphan_scores (num_nodes, 1, false, true);
+      _SimpleList     chunks; // flattened (node, # parents, from, to) quadruples
+      long            score_count = 0L;
 
-      auto compute_singleton_scores = [this] (long node_id) -> hyFloat {
-        _SimpleList  parents;
-        if (is_node_discrete(node_id)) {
-          return ComputeDiscreteScore (node_id, parents);    // [_SimpleList parents] should always be empty for master node
-        } else {
-          return ComputeContinuousScore (node_id, parents);
-        }
-      };
+      for (long node_id = 0L; node_id < num_nodes; node_id++) {
+        _List * this_list = (_List *) node_score_cache.GetItem (node_id);
 
-#if defined __HYPHYMPI__
-    bool  use_mpi_caching = hy_env::EnvVariableTrue(kHYBgm_MPI_CACHING);
- 
-    if (use_mpi_caching) {
-        ReportWarning (_String ("Using MPI to cache node scores."));
+        this_list->Clear();
+        this_list->AppendNewInstance (new _Constant (0.)); // replaced by the orphan score once it is known
+        this_list->AppendNewInstance (new _Matrix (num_nodes, 1, false, true));
 
-        // MPI_Init() is called in main()
-        int             size, rank;
-        long            mpi_node;
-      
+        for (long np = 2L; np <= max_parents.get (node_id); np++) {
+          _NTupleStorage * family_scores = new _NTupleStorage (num_nodes-1, np);
+          if (family_scores->get_K() != np) {
+            DeleteObject (family_scores);
+            throw _String("Failed to initialize _NTupleStorage object in Bgm::CacheNodeScores().\n");
+          }
+          this_list->AppendNewInstance (family_scores);
+        }
+        score_count += 1L + num_nodes * (max_parents.get (node_id) > 0L);
+        for (long np = 2L; np <= max_parents.get (node_id); np++) {
+          score_count += ((_Matrix *) this_list->GetItem (np))->GetSize();
+        }
+      }
 
-        MPI_Status      status; // contains source, tag, and error code
+      // imputing missing data draws random numbers, so those scores are computed in order
+      long    threads = 1L,
+              units   = 1L;
 
+#ifdef _OPENMP
+      if (! has_missing.Any ([] (long value, unsigned long) -> bool {return value > 0L;})) {
+          threads = omp_get_max_threads();
+      }
+      units = threads;
+#endif
 
+#if defined __HYPHYMPI__
+      int             size = 1,
+                      rank = 0;
+
+      if (hy_env::EnvVariableTrue(kHYBgm_MPI_CACHING)) {
         MPI_Comm_size (MPI_COMM_WORLD, &size);  // number of processes
         MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+        if (rank != 0) {
+          size = 1; // a compute node running its own HBL does not farm out
+        } else {
+          units = size;
+        }
+      }
+#endif
 
+      long const chunk_size = Maximum (1L, score_count / (units * kBGMScoreChunksPerUnit));
 
-        if (rank == 0) {
-            _String  const   bgmSwitch ("_BGM_SWITCH_");
-            _StringBuffer    bgmStr (2048UL);
-
-            _List       * this_list;
-
-            _Matrix     * mpi_node_status = new _Matrix ((long)size, 2, false, true);   // semaphore
+      for (long node_id = 0L; node_id < num_nodes; node_id++) {
+        _List * this_list = (_List *) node_score_cache.GetItem (node_id);
+        for (long np = 0L; np <= max_parents.get (node_id); np++) {
+          long const count = np == 0L ? 1L : ((_Matrix *) this_list->GetItem (np))->GetSize();
+          for (long from = 0L; from < count; from += chunk_size) {
+            chunks << node_id << np << from << Minimum (count, from + chunk_size);
+          }
+        }
+      }
 
+      long const chunk_count = chunks.countitems() >> 2;
 
-            // prepare message exporting _BayesianGraphicalModel object to compute nodes
-            SerializeBGMtoMPI (bgmStr);
-            ReportWarning (_String("Serialized _BayesianGraphicalModel object as:\n") & bgmStr);
+      auto chunk_scores = [this, &orphan_scores] (long const * chunk) -> hyFloat * {
+        if (chunk[1] == 0L) {
+          return orphan_scores.theData + chunk[0];
+        }
+        return ((_Matrix *) ((_List *) node_score_cache.GetItem (chunk[0]))->GetItem (chunk[1]))->theData + chunk[2];
+      };
 
+      auto chunk_indexer = [this] (long const * chunk) -> _NTupleStorage * {
+        return chunk[1] > 1L ? (_NTupleStorage *) ((_List *) node_score_cache.GetItem (chunk[0]))->GetItem (chunk[1]) : nil;
+      };
 
-            // switch compute nodes from mpiNormal to bgm loop context
-            for (long ni = 1L; ni < size; ni++) {
-                MPISendString (bgmSwitch, ni);
-            }
+      ReportWarning (_String ("Caching ") & score_count & " node scores in " & chunk_count & " chunks");
 
+#if defined __HYPHYMPI__
+    if (size > 1) {
+        ReportWarning (_String ("Using MPI to cache node scores."));
 
-            // receive confirmation of successful switch
-            for (long ni = 1L; ni < size; ni++) {
-                long fromNode = ni;
+        // MPI_Init() is called in main()
 
-                _String t (MPIRecvString (ni,fromNode));
-              
-                if (t != bgmSwitch) {
-                    throw _String ("Failed to confirm MPI mode switch at node ") & ni;
-                    return;
-                } else {
-                    ReportWarning (_String("Successful mode switch to Bgm MPI confirmed from node ") & ni);
-                    MPISendString (bgmStr, ni);
-                }
-            }
+        MPI_Status      status; // contains source, tag, and error code
 
+        _String  const   bgmSwitch ("_BGM_SWITCH_");
+        _StringBuffer    bgmStr (2048UL);
 
-            // farm out jobs to idle compute nodes until none are left
-            for (long node_id = 0; node_id < num_nodes; node_id++) { // node_id iterates over network nodes
-                long        maxp            = max_parents.get(node_id);
+        // prepare message exporting _BayesianGraphicalModel object to compute nodes
+        SerializeBGMtoMPI (bgmStr);
+        ReportWarning (_String("Serialized _BayesianGraphicalModel object as:\n") & bgmStr);
 
-                _String     mxString,
-                            mxName;
-              
-                hyFloat     score = compute_singleton_scores (node_id);
+        _String const * bgm_name =(_String *) bgmNamesList (bgmList._SimpleList::Find((long)this));
+        long            data_dimensions [2] = {theData.GetHDim(), theData.GetVDim()};
 
+        // switch compute nodes from mpiNormal to bgm loop context
+        for (long ni = 1L; ni < size; ni++) {
+            MPISendString (bgmSwitch, ni);
+        }
 
 
-                //_Constant   orphan_score (score);
+        // receive confirmation of successful switch, then send the network and its data
+        for (long ni = 1L; ni < size; ni++) {
+            long fromNode = ni;
 
+            _String t (MPIRecvString (ni,fromNode));
 
-                this_list   = (_List *) node_score_cache.GetItem(node_id);
-                this_list->Clear();
-                 // handle orphan score locally
-              
-              
+            if (t != bgmSwitch) {
+                throw _String ("Failed to confirm MPI mode switch at node ") & ni;
+            } else {
+                ReportWarning (_String("Successful mode switch to Bgm MPI confirmed from node ") & ni);
+                MPISendString (bgmStr, ni);
+                MPISendString (*bgm_name, ni);
+                ReportMPIError (MPI_Send (data_dimensions, 2, MPI_LONG, ni, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD), true);
+                ReportMPIError (MPI_Send (theData.theData, theData.GetSize(), MPI_DOUBLE, ni, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD), true);
+            }
+        }
 
-                if (maxp > 0L) { // don't bother to farm out trivial cases
-                    // look for idle nodes
-                    mpi_node = 1;
-                    do {
-                        if ((*mpi_node_status)(mpi_node, 0) == 0) {
-                            ReportMPIError(MPI_Send(&node_id, 1, MPI_LONG, mpi_node, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD), true);
-                            ReportWarning (_String ("Sent child ") & node_id & " to node " & mpi_node);
+        /* compute nodes pull chunks from the head of the queue, and always have one more chunk
+           queued while the last one travels back; while no results are waiting, the master
+           takes chunks from the tail of the queue */
 
-                            mpi_node_status->Store (mpi_node, 0, 1);    // set busy signal
-                            mpi_node_status->Store (mpi_node, 1, node_id);
+        long    next        = 0L,
+                last        = chunk_count,
+                outstanding = 0L;
 
-                            break;
-                        }
-                     } while (++mpi_node < size);
-                }
+        auto    send_chunk = [&] (long node) -> void {
+            ReportMPIError (MPI_Send (chunks.list_data + (next << 2), 4, MPI_LONG, node, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD), true);
+            next ++;
+            outstanding ++;
+        };
 
-                if (mpi_node == size) { // all nodes are busy, wait for one to send results
-                    MPIReceiveScores (mpi_node_status, true, node_id);
-                }
+        for (long queued = 0L; queued < 2L; queued++) {
+            for (long ni = 1L; ni < size && next < last; ni++) {
+                send_chunk (ni);
             }
-            // end loop over child nodes
-
+        }
 
-            // collect remaining jobs
-            mpi_node = 0L;
-            mpi_node_status->ForEachCellNumeric([&mpi_node] (hyFloat value, long, long, long column)-> void {
-              if (column == 0L) {
-                mpi_node += value > 0.0 ? 1 : 0;
-              }
-            });
-          
-            while (mpi_node > 0L) {
-              MPIReceiveScores (mpi_node_status, false, 0);
-              mpi_node --;
+        while (outstanding > 0L || next < last) {
+            if (next < last) {
+                int  ready = 0;
+                ReportMPIError (MPI_Iprobe (MPI_ANY_SOURCE, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &ready, &status), false);
+                if (!ready) {
+                    last --;
+                    ComputeScoreChunk (chunks.list_data + (last << 2), chunk_scores (chunks.list_data + (last << 2)), chunk_indexer (chunks.list_data + (last << 2)), threads);
+                    continue;
+                }
             }
-          
 
-            // shut down compute nodes
-            for (long shutdown = -1, mpi_node = 1L; mpi_node < size; mpi_node++) {
-                ReportMPIError(MPI_Send(&shutdown, 1, MPI_LONG, mpi_node, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD), true);
-                ReportWarning (_String ("Node 0 sending shutdown signal to node ") & mpi_node);
-            }
-        } else {  // compute node
- 
-            while (1) { // wait for the next message from the master
-                _String     mxString,
-                            mxName;
+            long    chunk [4];
+            ReportMPIError (MPI_Recv (chunk, 4, MPI_LONG, MPI_ANY_SOURCE, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &status), false);
 
-                long        node_id;  // update in while loop
-              
-                // wait for master node to issue node ID to compute
-                ReportMPIError (MPI_Recv (&node_id, 1, MPI_LONG, 0, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD, &status), false);
-                ReportWarning (_String("Node") & (long)rank & " received child " & (long)node_id & " from node " & (long)status.MPI_SOURCE);
+            int     sender = status.MPI_SOURCE;
+            ReportMPIError (MPI_Recv (chunk_scores (chunk), chunk[3] - chunk[2], MPI_DOUBLE, sender, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &status), false);
+            outstanding --;
 
-                if (node_id < 0) {
-                    ReportWarning (_String("Node") & (long)rank & " recognizes BGM loop shutdown signal.\n");
-                    break;  // received shutdown message (-1)
-                }
-              
-              
-                _List * list_of_matrices = handle_node_score (node_id);
-                _List   memory_cleanup;
-                memory_cleanup.AppendNewInstance (list_of_matrices);
-                ReportMPIError (MPI_Send (single_parent_scores.theData, num_nodes, MPI_DOUBLE, 0, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD), true);
-                list_of_matrices->ForEach ([&] (BaseRef mx, unsigned long idx) -> void {
-                    _Matrix * storedMx = (_Matrix *) mx;
-                    ReportMPIError (MPI_Send (storedMx->theData, storedMx->GetHDim(), MPI_DOUBLE, 0, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD), true);
-                });
-              
+            if (next < last) {
+                send_chunk (sender);
             }
-            // end while, received shutdown from master node
         }
-        // end else if compute node
-    } else {  // perform single-threaded
-#else
-
-    for (long node_id = 0L; node_id < num_nodes; node_id++) {
-         _List   *   this_list   = (_List *) node_score_cache.GetItem (node_id);    // retrieve pointer to list of scores for this child node
-
-        this_list->Clear();     // reset the list
-
-        // prepare some containers
-        hyFloat  score = compute_singleton_scores (node_id);
-        this_list->AppendNewInstance(new _Constant (score));
-      
-      
-      
 
-        if (max_parents.get(node_id) > 0) {
-            _List *     scores = handle_node_score (node_id); // this will also populate single_parent_scores
-            (*this_list) && & single_parent_scores;
-            (*this_list) << *scores;
-            delete scores;
+        // shut down compute nodes
+        for (long shutdown [4] = {-1L, 0L, 0L, 0L}, mpi_node = 1L; mpi_node < size; mpi_node++) {
+            ReportMPIError(MPI_Send(shutdown, 4, MPI_LONG, mpi_node, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD), true);
+            ReportWarning (_String ("Node 0 sending shutdown signal to node ") & mpi_node);
         }
+    } else {
+#endif
 
-
-    }
+#ifdef _OPENMP
+    long const nt = Minimum (threads, chunk_count);
+#pragma omp parallel for default(shared) schedule(dynamic) if (nt > 1) num_threads(nt)
 #endif
+    for (long c = 0L; c < chunk_count; c++) {
+        long const * chunk = chunks.list_data + (c << 2);
+        ComputeScoreChunk (chunk, chunk_scores (chunk), chunk_indexer (chunk), 1L);
+    }
 
 #if defined __HYPHYMPI__
     }   // completes else statement
 #endif
 
+      for (long node_id = 0L; node_id < num_nodes; node_id++) {
+        ((_List *) node_score_cache.GetItem (node_id))->Replace (0L, new _Constant (orphan_scores (node_id, 0L)), false);
+      }
+
     } catch (const _String & e) {
       HandleApplicationError(e);
       return;
     }
-      
-      
-    scores_cached = TRUE;
-    ReportWarning (_String ("Cached node scores."));
-      
-}
-
 
 
-//________________________________________________________________________________________________________
-#if defined __HYPHYMPI__
-/*
-	Head node processes results from compute node.
- */
-void _BayesianGraphicalModel::MPIReceiveScores (_Matrix * mpi_node_status, bool sendNextJob, long node_id)
-{
-    _Matrix     single_parent_scores (num_nodes, 1, false, true);
-    MPI_Status  status;
-
-    ReportMPIError (MPI_Recv (single_parent_scores.theData, num_nodes, MPI_DOUBLE, MPI_ANY_SOURCE,
-                              HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &status), false);
-
-
-    long        senderID    = (long) status.MPI_SOURCE,
-                this_node    = (long) (*mpi_node_status) (senderID, 1),
-                maxp       = max_parents.list_data[this_node];
+    scores_cached = TRUE;
+    ReportWarning (_String ("Cached node scores."));
 
-    _List   *   this_list   = (_List *) node_score_cache.list_data[this_node];
+}
 
+//___________________________________________________________________________________________
+void    _BayesianGraphicalModel::ComputeScoreChunk (long const * chunk, hyFloat * scores, _NTupleStorage * indexer, long threads) {
+    /*  -----------------------------------------------------------------------------------
+        ComputeScoreChunk() scores the families of child node chunk[0] with chunk[1] parents,
+        whose cache indices are in [chunk[2], chunk[3]), and writes them to [scores].
 
-    _String     mxString,
-                mxName;
+        Single parents are indexed by node; larger parent sets are indexed by combinadics
+        over all nodes but the child ([indexer] maps indices to tuples).
+        Discrete children are scored on their discrete parents only.
+        ----------------------------------------------------------------------------------- */
 
+    long const node_id = chunk[0],
+               np      = chunk[1],
+               from    = chunk[2],
+               to      = chunk[3];
 
-    mpi_node_status->Store (senderID, 0, 0);    // set node status to idle
-    ReportWarning (_String("Received scores for child ") & this_node & " from node " & senderID);
+#ifdef _OPENMP
+#pragma omp parallel for default(shared) schedule(dynamic) if (threads > 1) num_threads(threads)
+#endif
+    for (long index = from; index < to; index++) {
+        _SimpleList parents;
 
-    (*this_list) && (&single_parent_scores);
+        if (np == 1L) {
+            if (index == node_id) {   // child cannot be its own parent
+                scores[index - from] = 0.;
+                continue;
+            }
+            parents << index;
+        } else if (np > 1L) {
+            indexer->IndexToTuple (index, parents);
+            for (unsigned long par_idx = 0UL; par_idx < parents.countitems(); par_idx++) {
+                if (parents.list_data[par_idx] >= node_id) {
+                    parents.list_data[par_idx] ++;
+                }
+            }
+        }
 
+        if (is_node_discrete (node_id)) {
+            // discrete-valued child node cannot have continuous parent
+            scores[index - from] = ComputeDiscreteScore (node_id, parents.Filter ([this] (long par, unsigned long) -> bool {
+                return is_node_discrete (par);
+            }));
+        } else {
+            // continuous child can have discrete or continuous parents
+            scores[index - from] = ComputeContinuousScore (node_id, parents);
+        }
+    }
+}
 
-    _SimpleList     parents,
-                    all_but_one (num_nodes-1, 0, 1),
-                    aux_list,
-                    nk_tuple;
 
-    hyFloat      score;
 
-    // parse nk-tuple results
-    for (long np = 2; np <= maxp; np++) {
-        _NTupleStorage  family_scores (num_nodes-1, np);
-        bool            remaining;
+//________________________________________________________________________________________________________
+#if defined __HYPHYMPI__
+/*
+	Compute node scores chunks sent by the head node until it sends a shutdown signal.
+ */
+void _BayesianGraphicalModel::MPIServeScoreChunks (void) {
+    MPI_Status  status;
+    _List       indexers;   // (num_nodes-1, k)-tuple maps, by k
+    long        capacity    = 0L,
+                threads     = 1L;
+    hyFloat *   scores      = nil;
+
+#ifdef _OPENMP
+    if (! has_missing.Any ([] (long value, unsigned long) -> bool {return value > 0L;})) {
+        threads = omp_get_max_threads();
+    }
+#endif
 
+    while (1) { // wait for the next chunk from the master
+        long        chunk [4];
 
-        if (all_but_one.NChooseKInit (aux_list, nk_tuple, np, false)) {
-            long        score_index     = 0,
-                        num_ktuples      = exp(_ln_gamma(num_nodes) - _ln_gamma(num_nodes - np) - _ln_gamma(np+1)),
-                        ntuple_receipt;
+        ReportMPIError (MPI_Recv (chunk, 4, MPI_LONG, 0, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD, &status), false);
 
-            _Matrix     scores_to_store (num_ktuples, 1, false, true);
+        if (chunk[0] < 0L) {
+            ReportWarning ("Compute node recognizes BGM loop shutdown signal.\n");
+            break;  // received shutdown message (-1)
+        }
 
-            // receive nk-tuple indexed node scores from same compute node
-            ReportMPIError (MPI_Recv (scores_to_store.theData, num_ktuples, MPI_DOUBLE, senderID,
-                                      HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &status), false);
+        long const count = chunk[3] - chunk[2];
 
-            do {
-                remaining = all_but_one.NChooseK (aux_list, nk_tuple);  // update nk-tuple in aux_list
-                ntuple_receipt = family_scores.Store (scores_to_store(score_index, 0), nk_tuple);
-                score_index++;
-            } while (remaining);
-        } else {
-            HandleApplicationError("Failed to initialize _NTupleStorage object in Bgm::CacheNodeScores().\n");
+        if (count > capacity) {
+            delete [] scores;
+            scores = new hyFloat [capacity = count];
         }
 
-        (*this_list) && (&family_scores);
-    }
+        while (indexers.countitems() <= chunk[1]) {
+            indexers.AppendNewInstance (indexers.countitems() > 1UL ? new _NTupleStorage (num_nodes-1, indexers.countitems()) : new _NTupleStorage);
+        }
 
+        ComputeScoreChunk (chunk, scores, (_NTupleStorage *) indexers.GetItem (chunk[1]), threads);
 
-    // send next job
-    if (sendNextJob) {
-        ReportMPIError(MPI_Send(&node_id, 1, MPI_LONG, senderID, HYPHY_MPI_VARS_TAG, MPI_COMM_WORLD), true);
-        mpi_node_status->Store (senderID, 0, 1);    // reset busy signal
-        mpi_node_status->Store (senderID, 1, node_id);
-        ReportWarning (_String ("Sent child ") & node_id & " to node " & senderID);
+        ReportMPIError (MPI_Send (chunk, 4, MPI_LONG, 0, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD), true);
+        ReportMPIError (MPI_Send (scores, count, MPI_DOUBLE, 0, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD), true);
     }
+
+    delete [] scores;
 }
 
 
 //___________________________________________________________________________________________
 
 /* ------------------------------------------------------------------------------------
-	Pass current network structure, data, constraint graph, and other analysis settings
-	to compute node as HBL.
+	Pass network settings and constraint graph to compute node as HBL; the data matrix
+	follows as raw doubles (see CacheNodeScores).
    ------------------------------------------------------------------------------------ */
 void _BayesianGraphicalModel::SerializeBGMtoMPI (_StringBuffer & rec) {
-  
+
     const static _String           kHYBgm_IMPUTE_MAXSTEPS    ("BGM_IMPUTE_MAXSTEPS"),
                                    kHYBgm_IMPUTE_BURNIN  ("BGM_IMPUTE_BURNIN"),
-                                   kHYBgm_IMPUTE_SAMPLES ("BGM_IMPUTE_SAMPLES");
+                                   kHYBgm_IMPUTE_SAMPLES ("BGM_IMPUTE_SAMPLES"),
+                                   kHYBgm_CONTINUOUS_MISSING_VALUE ("BGM_CONTINUOUS_MISSING_VALUE");
 
-  
-    rec << "\
-USE_MPI_CACHING=1;\
-PRINT_DIGITS=-1;\
-function add_discrete_node (id,maxp,size,nlev) {\
-  return {\
-    'NodeID' : id,\
-    'NodeType' : 0,\
-    'MaxParents' : maxp.\
-    'PriorSize'  : size,\
-    'NumLevels' : nlev\
-  };\
-}\
-function add_gaussian_node (id,maxp,size,mean,prec,scale) {\
-  return {\
-  'NodeID' : id,\
-  'NodeType' : 1,\
-  'MaxParents' : maxp.\
-  'PriorVar'  : prec,\
-  'NumLevels' : nlev,\
-  'PriorScale' : scale\
-  };\
-}\
-nodes = {};";
+
+    rec << "USE_MPI_CACHING=1;\n_bgm_nodes={};\n";
 
     for (long node_id = 0L; node_id < num_nodes; node_id++) {
-        if (is_node_discrete (node_id)) {
-            rec << "nodes + add_discrete_node("
-                << *(_String*)node_names.GetItem (node_id) << max_parents.get (node_id) << ',' << prior_sample_size (node_id, 0) << ',' << num_levels.get (node_id) << ")'\n";
-            // I can't figure out how to write the _String object from [node_names] to file :-P
-         } else {
-            rec << "nodes + add_gaussian_node("
-              << *(_String*)node_names.GetItem (node_id) << max_parents.get (node_id) << ',' << prior_sample_size (node_id, 0) << ',' << prior_mean (node_id, 0) << ',' << prior_precision (node_id, 0) << ',' << prior_scale (node_id, 0) << ")'\n";
-         }
+        rec << "_bgm_nodes+{\"NodeID\":" << ((_String*)node_names.GetItem (node_id))->Enquote('"')
+            << ",\"NodeType\":" << _String (node_type.get (node_id))
+            << ",\"MaxParents\":" << _String (max_parents.get (node_id))
+            << ",\"NumLevels\":" << _String (num_levels.get (node_id))
+            << ",\"PriorSize\":" << _String (prior_sample_size (node_id, 0));
+
+        if (is_node_continuous (node_id)) {
+            rec << ",\"PriorMean\":" << _String (prior_mean (node_id, 0))
+                << ",\"PriorPrecision\":" << _String (prior_precision (node_id, 0))
+                << ",\"PriorScale\":" << _String (prior_scale (node_id, 0));
+        }
+        rec << "};\n";
     }
 
     // write BGM constructor
-  
+
     _String const * bgm_name =(_String *) bgmNamesList (bgmList._SimpleList::Find((long)this));
-  
-    rec << "BayesianGraphicalModel " << *bgm_name << "(nodes);\n"
-        << kHYBgm_IMPUTE_MAXSTEPS << '=' << hy_env :: EnvVariableGetNumber (kHYBgm_IMPUTE_MAXSTEPS,10000.) << ";\n"
-        << kHYBgm_IMPUTE_BURNIN << '=' << hy_env :: EnvVariableGetNumber (kHYBgm_IMPUTE_BURNIN,1000.) << ";\n"
-        << kHYBgm_IMPUTE_SAMPLES << '=' << hy_env :: EnvVariableGetNumber (kHYBgm_IMPUTE_SAMPLES,1000.) << ";\n";
 
+    rec << "BayesianGraphicalModel " << *bgm_name << "=(_bgm_nodes);\n"
+        << kHYBgm_IMPUTE_MAXSTEPS << '=' << _String (hy_env :: EnvVariableGetNumber (kHYBgm_IMPUTE_MAXSTEPS,10000.)) << ";\n"
+        << kHYBgm_IMPUTE_BURNIN << '=' << _String (hy_env :: EnvVariableGetNumber (kHYBgm_IMPUTE_BURNIN,1000.)) << ";\n"
+        << kHYBgm_IMPUTE_SAMPLES << '=' << _String (hy_env :: EnvVariableGetNumber (kHYBgm_IMPUTE_SAMPLES,1000.)) << ";\n"
+        << kHYBgm_CONTINUOUS_MISSING_VALUE << '=' << _String (continuous_missing_value) << ";\n";
 
-  
-    // serialize constraint matrix
-    rec << "bgmConstraints = " << (_String *)constraint_graph.toStr() << ";\n";
-    rec << "SetParameter(" << *bgm_name << ',' << kBGMContraintMatrix << ",bgmConstraints);\n";
 
-    // serialize data matrix and assign to BGM
-    rec << kBGMData << '=' << (_String *)theData.toStr() << ";\n";
-    rec << "SetParameter(" << *bgm_name << ',' << kBGMData << ',' << kBGMData << ");\n";
+
+    // serialize constraint matrix
+    rec << "_bgm_constraints=";
+    rec.AppendNewInstance ((_String *)constraint_graph.toStr()) << ";\n";
+    rec << "SetParameter(" << *bgm_name << ',' << kBGMContraintMatrix << ",_bgm_constraints);\n";
 
 }
 #endif
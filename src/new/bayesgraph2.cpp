@@ -434,7 +434,7 @@ hyFloat _BayesianGraphicalModel::ComputeContinuousScore (long node_id, _SimpleLi
             }
         }
 
-        if (theData.is_empty() == 0) {
+        if (theData.is_empty()) {
             throw _String("Uh-oh, there's no node score cache nor is there any data matrix to compute scores from!");
         }
 
@@ -58,6 +58,14 @@
 #define   kBGMDirichletFlattening  0.5
 #define		kBGMMinSize       				5
 
+/*
+	Target number of score chunks per thread (or per MPI node)
+	when caching node scores; more chunks balance better.
+*/
+#define   kBGMScoreChunksPerUnit   16
+
+class _NTupleStorage;
+
 
 class _BayesianGraphicalModel : public _LikelihoodFunction {
 public:
@@ -70,7 +78,7 @@ public:
 
 
     /* network initialization */
-    bool            SetDataMatrix   (_Matrix const *),    // via SetParameter HBL
+    bool            SetDataMatrix   (_Matrix const *, bool = true),    // via SetParameter HBL; false defers caching node scores
                     SetWeightMatrix (_Matrix const *),
                     SetConstraints    (_Matrix const *),    //  "       "
                     SetStructure  (_Matrix const *),
@@ -93,7 +101,8 @@ public:
 
 
     void            CacheNodeScores (void);	// MPI enabled
-    void            MPIReceiveScores (_Matrix *, bool, long);
+    void            ComputeScoreChunk (long const *, hyFloat *, _NTupleStorage *, long);	// (node, # parents, from, to) -> scores
+    void            MPIServeScoreChunks (void);	// compute node side of CacheNodeScores
     void            ReleaseCache (void);
 
     hyFloat         ComputeDiscreteScore (long node_id),
@@ -48,15 +48,13 @@
 #include "likefunc.h"
 #include "hy_string_buffer.h"
 #include "hbl_env.h"
+#include "local_workers.h"
+#include "bayesgraph.h"
 
 using    namespace hy_global;
 
 
 #ifdef          __HYPHYMPI__
-_String         preserveSlaveNodeState ("PRESERVE_SLAVE_NODE_STATE"),
-                MPI_NEXUS_FILE_RETURN  ("MPI_NEXUS_FILE_RETURN");
-
-
 void            mpiNormalLoop    (int, int, _String &);
 void            mpiOptimizerLoop (int, int);
 
@@ -231,7 +229,7 @@ void mpiNormalLoop    (int  rank, int size, _String & baseDir)
     ReportWarning ("[MPI] Entered mpiNormalLoop");
 
     _String* theMessage     = MPIRecvString (-1,senderID);   // listen for messages from any node
-    _StringBuffer * resStr        = nil;
+    _String * resStr        = nil;
     
     //int loop_count = 0;
 
@@ -256,73 +254,12 @@ void mpiNormalLoop    (int  rank, int size, _String & baseDir)
             mpiBgmLoop          (rank, size);
             ReportWarning       ("[MPI] Returned from mpiBgmLoop");
         } else {
-            if (theMessage->BeginsWith ("#NEXUS")) {
-                _String             msgCopy (*theMessage);
-                //printf ("\n\nMPI Node %d; message \n %s\n", rank, theMessage->get_str());
-                ReportWarning       ("[MPI] Received a likelihood function");
-                //ReportWarning       (msgCopy);
-                ReadDataSetFile     (nil,true,theMessage);
-                ReportWarning       ("[MPI] Read/optimized the likelihood function");
-                _Variable*          lfName = FetchVar(LocateVarByName(MPI_NEXUS_FILE_RETURN));
-
-                if (lfName) {
-                    resStr = new _StringBuffer ((_String*)lfName->Compute()->toStr());
-                 } else {
-                    _FString        *lfID = (_FString*)FetchObjectFromVariableByType (&lf2SendBack, STRING);
-
-                    if (!lfID) {
-                        HandleApplicationError (_String("[MPI] Malformed MPI likelihood function optimization request - did not specify the LF name to return in variable ") & lf2SendBack & ".\n\n\n" );
-                        break;
-                    }
-
-                    long type = HY_BL_LIKELIHOOD_FUNCTION, index;
-                    
-                    _LikelihoodFunction *lf = (_LikelihoodFunction *)hyphy_global_objects::_HYRetrieveBLObjectByName    (lfID->get_str(), type, &index, false, false);
-
-                    if (lf == nil) {
-                        HandleApplicationError (_String("[MPI] Malformed MPI likelihood function optimization request - '") & lfID->get_str() &"' did not refer to a well-defined likelihood function.\n\n\n");
-                        break;
-                    }
-                  
-                    resStr       = new _StringBuffer (1024UL);
-                    lf->SerializeLF(*resStr,hy_env::EnvVariableTrue (hy_env::short_mpi_return) ? _hyphyLFSerializeModeShortMPI:_hyphyLFSerializeModeLongMPI);
-                }
-            } else {
-                //ReportWarning(_String ("[MPI] Received commands\n") & *theMessage & "\n");
-                //printf ("\n\nMPI Node %d; message \n %s\n", rank, theMessage->get_str());
-                //printf ("\n\nMPI Node %d; likefuncs \n %s\n", rank, ((_String*)likeFuncNamesList.toStr())->get_str());
-                _ExecutionList exL (*theMessage);
-                
-                 
-                //ReportWarning (_String ((_String*)batchLanguageFunctionNames.toStr()));
-                HBLObjectRef res = exL.Execute();
-                //printf ("\n==>%d\n", hy_env::EnvVariableTrue (preserveSlaveNodeState));
-                if (res) {
-                  resStr = new _StringBuffer ((_String*)res->toStr());
-                } else {
-                  resStr = new _StringBuffer ("0");
-                }
-            }
-
-            MPISendString(*resStr,senderID);
-            
-            /*loop_count++;
-            printf ("\n\nMPI Node %d; variable array length %d\n", rank, variableNames.countitems());
-            if (loop_count == 20) {
-                printf ("%s\n", ((_String*)variableNames.toStr())->get_str());
-                abort();
-            }*/
-            
-            
-            if (hy_env::EnvVariableTrue (preserveSlaveNodeState) == false) {
-                printf ("\n\nMPI Node %d; PURGING\n", rank);
-                PurgeAll (true);
-                InitializeGlobals ();
-                PushFilePath(baseDir, false, false);
-                ReportWarning("Reset node state");
-            } else {
-                ReportWarning("Preserved node state");
+            resStr = ExecuteWorkerJob (*theMessage);
+            if (!resStr) {
+                break;
             }
+            MPISendString    (*resStr,senderID);
+            ResetWorkerState (baseDir);
         }
         DeleteObject (theMessage);
         theMessage = MPIRecvString (-1,senderID);
@@ -396,26 +333,35 @@ void mpiOptimizerLoop (int rank, int size)
 void mpiBgmLoop (int rank, int size)
 {
     long        senderID    = 0;
-    _String *   resStr      = nil;
 
     ReportWarning (_String ("MPI Node:") & (long)rank & " is ready for MPIBgmCacheNodeScores tasks");
 
-    // receive serialized Bgm
-    _String* theMessage = MPIRecvString (-1, senderID);
+    // receive serialized Bgm and its name, followed by the data matrix as raw doubles
+    _String* theMessage = MPIRecvString (-1, senderID),
+           * bgmName    = MPIRecvString (-1, senderID);
 
-    while (theMessage->nonempty()) {
-        _ExecutionList  exL (*theMessage);
-        HBLObjectRef       res = exL.Execute();    // should send this process into CacheNodeScores()
+    long        dimensions [2];
+    MPI_Status  status;
 
-        resStr = res ? (_String*)res->toStr() : new _String ("0");
-        ReportWarning (_String ("MPI Node: ") & (long)rank & " executed HBL with result:\n" & resStr);
+    ReportMPIError (MPI_Recv (dimensions, 2, MPI_LONG, 0, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &status), false);
+    _Matrix     data (dimensions[0], dimensions[1], false, true);
+    ReportMPIError (MPI_Recv (data.theData, data.GetSize(), MPI_DOUBLE, 0, HYPHY_MPI_DATA_TAG, MPI_COMM_WORLD, &status), false);
 
-        if (bgmNamesList.lLength < 1) {
-            HandleApplicationError ("Malformed HBL. No valid BGM has been defined.\n");
-            break;
+    _ExecutionList  exL (*theMessage);
+    exL.Execute();
+
+    long bgmIndex = bgmNamesList.FindObject (bgmName);
+
+    if (bgmIndex < 0) {
+        HandleApplicationError ("Malformed HBL. No valid BGM has been defined.\n");
+    } else {
+        _BayesianGraphicalModel * bgm = (_BayesianGraphicalModel *) bgmList.GetItem (bgmIndex);
+        if (bgm->SetDataMatrix (&data, false)) {
+            bgm->MPIServeScoreChunks ();    // until the master sends a shutdown signal
         }
     }
 
     DeleteObject (theMessage);
+    DeleteObject (bgmName);
 }
 #endif
@@ -29,6 +29,34 @@ function runTest () {
   fscanf (tempFilePathBGM, String, bgmPrintOut);
   assert(bgmPrintOut == "Log Likelihood =               0;", "Failed to initialize a bgm with a log likelihood of 0");
   
+  // setting data caches a score for every child and parent set
+  bgm_data = {50, num_nodes}["(_MATRIX_ELEMENT_ROW_$(_MATRIX_ELEMENT_COLUMN_+1))%2"];
+  SetParameter (gen_bgm, BGM_DATA_MATRIX, bgm_data);
+  GetString (bgm_cache, gen_bgm, 0);
+  assert (Abs (bgm_cache) == num_nodes * (max_parents + 1), "Failed to cache scores for every node and number of parents");
+  assert (Type (bgm_cache["Node3NumParents0"]) == "Number" && bgm_cache["Node3NumParents0"] < 0, "Failed to cache the score of a node without parents");
+  assert (Rows (bgm_cache["Node3NumParents1"]) == num_nodes && (bgm_cache["Node3NumParents1"])[3] == 0 && (bgm_cache["Node3NumParents1"])[4] < 0, "Failed to cache single parent scores");
+  assert (Columns (bgm_cache["Node3NumParents2"]) == (num_nodes-1)*(num_nodes-2)/2 && +((bgm_cache["Node3NumParents2"])["_MATRIX_ELEMENT_VALUE_>=0"]) == 0, "Failed to cache a score for every pair of parents");
+
+  // cached scores (computed in chunks, possibly by several threads) must match the K2 score of each family;
+  // parent pairs (a,b), a < b, are stored at a + b(b-1)/2 after the child is removed from the numbering
+  for (child = 0; child < num_nodes; child += 1) {
+    assert (Abs (bgm_cache["Node" + child + "NumParents0"] - bgm_k2_score (bgm_data, child, {}, 0)) < 1e-10, "Incorrect cached score for node " + child + " without parents");
+    for (a = 0; a < num_nodes; a += 1) {
+      if (a != child) {
+        assert (Abs ((bgm_cache["Node" + child + "NumParents1"])[a] - bgm_k2_score (bgm_data, child, {{a}}, 1)) < 1e-10, "Incorrect cached score for node " + child + " with parent " + a);
+        for (b = a + 1; b < num_nodes; b += 1) {
+          if (b != child) {
+            a_index = a - (a > child);
+            b_index = b - (b > child);
+            assert (Abs ((bgm_cache["Node" + child + "NumParents2"])[a_index + b_index * (b_index - 1) / 2] - bgm_k2_score (bgm_data, child, {{a, b}}, 2)) < 1e-10,
+                    "Incorrect cached score for node " + child + " with parents " + a + " and " + b);
+          }
+        }
+      }
+    }
+  }
+
   //---------------------------------------------------------------------------------------------------------
   // ERROR HANDLING
   //---------------------------------------------------------------------------------------------------------
@@ -51,3 +79,21 @@ function runTest () {
 
   return testResult;
 }
+
+
+function bgm_k2_score (data, child, parents, parent_count) {
+  // K2 score of a binary node: the sum over parent configurations j of ln (n_j0! n_j1! / (n_j0 + n_j1 + 1)!)
+  counts = {2^parent_count, 2};
+  for (obs = 0; obs < Rows (data); obs += 1) {
+    configuration = 0;
+    for (p = 0; p < parent_count; p += 1) {
+      configuration = configuration * 2 + data[obs][parents[p]];
+    }
+    counts[configuration][data[obs][child]] += 1;
+  }
+  score = 0;
+  for (configuration = 0; configuration < Rows (counts); configuration += 1) {
+    score += LnGamma (counts[configuration][0] + 1) + LnGamma (counts[configuration][1] + 1) - LnGamma (counts[configuration][0] + counts[configuration][1] + 2);
+  }
+  return score;
+}
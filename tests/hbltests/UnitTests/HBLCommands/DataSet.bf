@@ -7,6 +7,12 @@ function getTestName () {
 }		
 
 
+lfunction _read_data_in_namespace (path) {
+  DataSet namespace_ds = ReadDataFile (path);
+  return {"species" : namespace_ds.species, "tree" : IS_TREE_PRESENT_IN_DATA};
+}
+
+
 function runTest () {
 	ASSERTION_BEHAVIOR = 1; /* print warning to console and go to the end of the execution list */
 	testResult = TRUE;
@@ -19,7 +25,75 @@ function runTest () {
   DataSet cd2nex = ReadDataFile (PATH_TO_CURRENT_BF + '/../../data/CD2.nex');
   DataSet 2fas = ReadDataFile (PATH_TO_CURRENT_BF  + '/../../data/2.fas');
   DataSet cd2Phylip = ReadDataFile(PATH_TO_CURRENT_BF  + '/../../data/CD2.phylip');
-  
+
+  // Identical columns are collapsed into site patterns numbered in the order of first occurrence
+  DataSet dup_ds = ReadFromString (">a\nACACGTAC\n>b\nAGAGTTAG\n>c\nACACGTAC\n");
+  DataSetFilter dup_filter = CreateFilter (dup_ds, 1);
+  GetDataInfo (dup_map, dup_filter);
+  assert (dup_ds.unique_sites == 4, "Failed to find the correct number of unique site patterns");
+  assert (dup_map == {{0,1,0,1,2,3,0,1}}, "Failed to map sites to the correct site patterns");
+
+  // NEXUS TREES blocks: translated taxon names, duplicate tree IDs are made unique
+  DataSet nexus_trees = ReadFromString ("#NEXUS\nBEGIN DATA;\nDIMENSIONS NTAX=3 NCHAR=4;\nFORMAT DATATYPE=DNA;\nMATRIX\na ACGT\nb ACGA\nc ACGG\n;\nEND;\nBEGIN TREES;\nTRANSLATE 1 a, 2 b, 3 c;\nTREE t1 = ((1,2),3);\nTREE t1 = (1,(2:0.1,3));\nEND;\n");
+  assert (Rows (NEXUS_FILE_TREE_MATRIX) == 2 && NEXUS_FILE_TREE_MATRIX[1][0] == "T1_2" && NEXUS_FILE_TREE_MATRIX[1][1] == "(A,(B:0.1,C))", "Failed to correctly read a NEXUS TREES block");
+
+  // Write a subset of sequences and sites in the binary data set format (DATA_FILE_PRINT_FORMAT = 13) and read it back
+  DataSetFilter binary_filter = CreateFilter (cd2nex, 1, siteIndex < 30 || siteIndex > 500, speciesIndex != 1);
+  tempFilePathBinary = PATH_TO_CURRENT_BF + '/../../data/tempFileTesting-binary' + Random(0,1);
+  _saved_format = DATA_FILE_PRINT_FORMAT;
+  DATA_FILE_PRINT_FORMAT = 13;
+  fprintf (tempFilePathBinary, CLEAR_FILE, binary_filter);
+  DATA_FILE_PRINT_FORMAT = _saved_format;
+  DataSet binary_ds = ReadDataFile (tempFilePathBinary);
+  DataSetFilter binary_read_filter = CreateFilter (binary_ds, 1);
+  GetDataInfo (_binary_seq, binary_read_filter, 2);
+  GetDataInfo (_text_seq, binary_filter, 2);
+  GetString (_binary_name, binary_ds, 2);
+  GetString (_text_name, cd2nex, 3);
+  assert (binary_ds.species == binary_filter.species && binary_ds.sites == binary_filter.sites
+          && _binary_name == _text_name && _binary_seq == _text_seq, "Failed to write and read back a data set in the binary format");
+
+  // like the text reader, the binary reader reports the data file tree in the namespace of the caller
+  _binary_in_namespace = _read_data_in_namespace (tempFilePathBinary);
+  _text_in_namespace   = _read_data_in_namespace (PATH_TO_CURRENT_BF + '../../data/CD2.nex');
+  assert (_binary_in_namespace ["species"] == binary_filter.species && _binary_in_namespace ["tree"] == 1 && _text_in_namespace ["tree"] == 1,
+          "Failed to report the tree of a binary data set read in a namespace");
+
+  // only the tree read with the data set itself is written, not the tree from the most recently read file
+  DataSet no_tree_ds = ReadDataFile (PATH_TO_CURRENT_BF + '/../../data/CD2_noTree.nex');
+  DataSet tree_ds    = ReadDataFile (PATH_TO_CURRENT_BF + '/../../data/CD2.nex');
+  DataSetFilter no_tree_filter = CreateFilter (no_tree_ds, 1);
+  DATA_FILE_PRINT_FORMAT = 13;
+  fprintf (tempFilePathBinary, CLEAR_FILE, no_tree_filter);
+  DATA_FILE_PRINT_FORMAT = _saved_format;
+  DataSet no_tree_binary_ds = ReadDataFile (tempFilePathBinary);
+  assert (no_tree_binary_ds.species == no_tree_ds.species && IS_TREE_PRESENT_IN_DATA == 0, "Wrote the tree from another data file into a binary data set");
+
+  // the header of a binary data set file is checked against the size of the file before allocating memory
+  assert (runCommandWithSoftErrors ("DataSet truncated_ds = ReadDataFile (PATH_TO_CURRENT_BF + '/../../data/truncated.hbd');", "Unexpected end of file in a binary data set file"),
+          "Failed error checking for reading a truncated binary data set file");
+
+  // ReadDataFile decompresses gzip-compressed files as they are read, including for the readers which seek back
+  // in the file (PHYLIP and NEXUS); other file reads (e.g. fscanf) return the compressed bytes as they are.
+  // Skipped in builds without zlib
+  GetString (_gzip_version, HYPHY_VERSION, 1);
+  fscanf (PATH_TO_CURRENT_BF + '../../data/CD2_reduced.fasta.gz', "Raw", _gzip_probe);
+  assert ((_gzip_probe[0]) != ">", "fscanf should not decompress gzip-compressed files");
+  if ((_gzip_version $ "\\(zlib\\)")[0] >= 0) {
+    _gzip_files = {{"CD2_reduced.fasta", "CD2.phylip", "CD2.nex"}};
+    for (_k = 0; _k < 3; _k += 1) {
+      DataSet plain_ds = ReadDataFile (PATH_TO_CURRENT_BF + '../../data/' + _gzip_files[_k]);
+      DataSet gzip_ds  = ReadDataFile (PATH_TO_CURRENT_BF + '../../data/' + _gzip_files[_k] + '.gz');
+      DataSetFilter plain_filter = CreateFilter (plain_ds, 1);
+      DataSetFilter gzip_filter  = CreateFilter (gzip_ds, 1);
+      GetDataInfo (_plain_seq, plain_filter, plain_ds.species - 1);
+      GetDataInfo (_gzip_seq, gzip_filter, gzip_ds.species - 1);
+      GetString (_plain_name, plain_ds, plain_ds.species - 1);
+      GetString (_gzip_name, gzip_ds, gzip_ds.species - 1);
+      assert (gzip_ds.species == plain_ds.species && gzip_ds.sites == plain_ds.sites && gzip_ds.unique_sites == plain_ds.unique_sites
+              && _gzip_name == _plain_name && _gzip_seq == _plain_seq, "Failed to read a gzip-compressed " + _gzip_files[_k]);
+    }
+  }
 
   //---------------------------------------------------------------------------------------------------------
   // ERROR HANDLING
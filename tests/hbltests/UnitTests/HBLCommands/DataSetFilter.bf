@@ -35,6 +35,64 @@ function runTest () {
   assert(Abs((freqsUnChanged[0] - freqsOnlyFiveThroughTen[0]) + 0.0145053) < 0.001, "Failed to filter based on site index with DataSetFilter");
   assert(Abs((freqsUnChanged[0] - freqsOnlyLiveStock[0]) - 0.00130718) < 0.001 , "Failed to filter based on sequence index with DataSetFilter");
 
+  //---------------------------------------------------------------------------------------------------------
+  // SHIFTING THE SITES OF A FILTER IN PLACE
+  //---------------------------------------------------------------------------------------------------------
+  // SetParameter (filter, SITES, "partition") replaces the sites of an existing filter (in data set coordinates);
+  // likelihood functions which use the filter must give the same values as those built on a new filter
+
+  HarvestFrequencies (nucFreqs, cd2nex, 1, 1, 1);
+  F81 = {{*,t,t,t}{t,*,t,t}{t,t,*,t}{t,t,t,*}};
+  Model F81Model = (F81, nucFreqs, 1);
+  Tree windowTree = ((((Pig,Cow),Horse,Cat),((RhMonkey,Baboon),(Human,Chimp))),Rat,Mouse);
+  ReplicateConstraint ("this1.?.t:=0.1", windowTree);
+
+  DataSetFilter window = CreateFilter (cd2nex,1,"0-99");
+  LikelihoodFunction windowLF = (window, windowTree);
+
+  for (shift = 10; shift <= 250; shift += 60) {
+    window_spec = "" + shift + "-" + (shift + 99 + shift % 7);
+    SetParameter (window, SITES, window_spec);
+
+    DataSetFilter reference = CreateFilter (cd2nex,1,window_spec);
+    LikelihoodFunction referenceLF = (reference, windowTree);
+
+    LFCompute (windowLF, LF_START_COMPUTE);
+    LFCompute (windowLF, windowLogL);
+    LFCompute (windowLF, LF_DONE_COMPUTE);
+    LFCompute (referenceLF, LF_START_COMPUTE);
+    LFCompute (referenceLF, referenceLogL);
+    LFCompute (referenceLF, LF_DONE_COMPUTE);
+
+    assert (window.sites == reference.sites && Columns (window.site_freqs) == Columns (reference.site_freqs), "Incorrect sites or site patterns after shifting the sites of a filter to " + window_spec);
+    assert (Abs (windowLogL - referenceLogL) < 1e-8, "Incorrect log-likelihood after shifting the sites of a filter to " + window_spec);
+  }
+
+  DataSetFilter codons = CreateFilter (cd2nex,3,"0-89","","TAA,TAG,TGA");
+  DataSetFilter codonReference = CreateFilter (cd2nex,3,"45-209","","TAA,TAG,TGA");
+  SetParameter (codons, SITES, "45-209");
+  assert (codons.sites == codonReference.sites && Columns (codons.site_freqs) == Columns (codonReference.site_freqs), "Incorrect sites after shifting the sites of a codon filter with exclusions");
+
+  //---------------------------------------------------------------------------------------------------------
+  // CACHED PATTERN CLASSES
+  //---------------------------------------------------------------------------------------------------------
+  // Site patterns of a filter are compressed using classes cached by the data set for each set of sequences;
+  // a filter built from the cache must be the same as one built from a freshly read copy of the data
+
+  DataSet cd2fresh = ReadDataFile (PATH_TO_CURRENT_BF + '/../../data/CD2.nex');
+  species_sets = {{"0,2,4,6", "1-3", "5-9", "0,2,4,6", "1-3"}};
+
+  for (k = 0; k < Columns (species_sets); k += 1) {
+    DataSetFilter cached = CreateFilter (cd2nex,1,"",species_sets[k]);
+    DataSetFilter fresh  = CreateFilter (cd2fresh,1,"",species_sets[k]);
+    assert (cached.site_map == fresh.site_map && cached.site_freqs == fresh.site_freqs, "Incorrect site patterns for a cached set of sequences " + species_sets[k]);
+    for (s = 0; s < cached.species; s += 1) {
+      GetDataInfo (cached_seq, cached, s);
+      GetDataInfo (fresh_seq, fresh, s);
+      assert (cached_seq == fresh_seq, "Incorrect sequence " + s + " for a cached set of sequences " + species_sets[k]);
+    }
+  }
+
   //---------------------------------------------------------------------------------------------------------
   // ERROR HANDLING
   //---------------------------------------------------------------------------------------------------------
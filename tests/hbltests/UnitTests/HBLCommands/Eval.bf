@@ -19,6 +19,47 @@ function runTest () {
   assert(Eval("3+3*13") == 42, "Failed to evaluate a standard function");
   assert(Eval("3^3+2") == 29, "Failed to evaluate a function with exponents");
   assert(Eval("(3+3)*13") == 78, "Failed to evaluate a function with parentheses");
+
+  // Repeated evaluation of identical text reuses the parsed expression
+  eval_sum = 0;
+  for (k = 0; k < 5; k += 1) {
+    eval_sum += Eval ("k*k");
+  }
+  assert(eval_sum == 30, "Failed to correctly re-evaluate the same expression");
+  DeleteObject (k);
+  k = 7;
+  assert(Eval ("k*k") == 49, "Failed to re-bind a re-created variable in a repeated Eval");
+
+  // A repeated Eval in a namespace must bind its identifiers like a fresh parse would,
+  // when a variable with the same name is declared in another scope after the first parse
+  namespace eval_scope {
+    shadowed = 3;
+    first_read = Eval ("shadowed*2");
+  }
+  global shadowed = 5;
+  namespace eval_scope {
+    second_read = Eval ("shadowed*2");
+    fresh_read  = Eval ("2*shadowed");
+  }
+  assert(eval_scope.first_read == 6 && eval_scope.second_read == eval_scope.fresh_read && eval_scope.second_read == 10, "Failed to re-bind a repeated Eval to a global declared after the first parse");
+
+  // lfunctions have their own namespaces; the same text evaluated in each of them binds to the local variables
+  eval_lf_sum = 0;
+  for (k = 0; k < 3; k += 1) {
+    eval_lf_sum += _eval_in_lfunction_1 (k) + _eval_in_lfunction_2 (k);
+  }
+  assert(eval_lf_sum == 3*(0+1+2) + 2*(0+1+2) + 3*7, "Failed to re-bind a repeated Eval to the variables of different lfunctions");
+  
+  global shadowing = 4;
+  namespace eval_scope {
+    first_read = Eval ("shadowing+1");
+  }
+  eval_scope.shadowing = 10;
+  namespace eval_scope {
+    second_read = Eval ("shadowing+1");
+    fresh_read  = Eval ("1+shadowing");
+  }
+  assert(eval_scope.first_read == 5 && eval_scope.second_read == eval_scope.fresh_read, "A repeated Eval did not bind like a fresh parse after a local variable shadowed a global");
   assert(Eval("1+1+string") == 2, "Failed to evaluate a function with string as one of the arguments");
   
   // Other accepted types
@@ -43,3 +84,16 @@ function runTest () {
 
   return testResult;
 }
+
+lfunction _eval_in_lfunction_1 (x) {
+  y = 3;
+  r = Eval ("x*y");
+  return r;
+}
+
+lfunction _eval_in_lfunction_2 (x) {
+  y = 2;
+  z = 7;
+  r = Eval ("x*y") + Eval ("z");
+  return r;
+}
@@ -25,6 +25,24 @@ function runTest () {
   ExecuteCommands("tempStringOne = 'testString'; tempStringTwo = 'Two'; b = tempStringOne+tempStringTwo;");
   assert(a==b, "failed to execute three commands in series inside ExecuteCommands");
 
+  // Repeated execution of identical text reuses the parsed code; make sure it still sees current state
+  counter = 0;
+  for (k = 0; k < 5; k += 1) {
+    ExecuteCommands ("counter = counter + k;");
+  }
+  assert(counter==10, "failed to correctly re-execute identical code with ExecuteCommands");
+
+  ExecuteCommands ("z = 2;", {}, "ns1");
+  ExecuteCommands ("z = 2;", {}, "ns2");
+  ExecuteCommands ("z += 1;", {}, "ns2");
+  assert(ns1.z==2 && ns2.z==3, "failed to keep namespaces separate for repeated ExecuteCommands");
+
+  ExecuteCommands ("z = counter * 2;");
+  DeleteObject (counter);
+  counter = 1;
+  ExecuteCommands ("z = counter * 2;");
+  assert(z==2, "failed to re-bind a deleted and re-created variable in repeated ExecuteCommands");
+
   //---------------------------------------------------------------------------------------------------------
   // ERROR HANDLING
   //---------------------------------------------------------------------------------------------------------
@@ -30,6 +30,67 @@ function runTest () {
 	GetDataInfo 		(seqInfo, dinucF, -2);
 	assert (seqInfo["UNIQUE_SEQUENCES"] == 5, "Expected 5 unique sequences with strict+gap filtering (dinuc)");
 
+	/* all pairwise distances must agree with those computed from pairwise difference counts */
+	DataSet 			ambigSeqs = ReadFromString (">a\nACGTACGTAACCGGTTRYN-ACGT\n>b\nACGAACGTTACCAGTTACGTACGT\n>c\nRCGTWCGTAACCGGTT--GTACGN\n");
+	DataSetFilter		ambigF	  = CreateFilter (ambigSeqs,1);
+
+	GetDataInfo 		(pDistances, ambigF, "PAIRWISE_DISTANCES", {"metric" : "P_DISTANCE", "ambigs" : "RESOLVE_AMBIGUITIES"});
+	GetDataInfo 		(tn93Distances, ambigF, "PAIRWISE_DISTANCES", {"metric" : "TN93", "frequencies" : {{0.25,0.25,0.25,0.25}}});
+	GetDataInfo 		(counts, ambigF, 1, 2, RESOLVE_AMBIGUITIES);
+
+	total = +counts;
+	AG    = (counts[0][2] + counts[2][0]) / total;
+	CT    = (counts[1][3] + counts[3][1]) / total;
+	tv    = 1 - AG - CT - (counts[0][0] + counts[1][1] + counts[2][2] + counts[3][3]) / total;
+
+	assert (Abs (pDistances[1][2] - (1 - (counts[0][0] + counts[1][1] + counts[2][2] + counts[3][3]) / total)) < 1e-10 && pDistances[1][2] == pDistances[2][1], "Incorrect pairwise p-distances");
+	assert (Abs (tn93Distances[1][2] + 0.25*Log(1-4*AG-tv) + 0.25*Log(1-4*CT-tv) + 0.25*Log(1-2*tv)) < 1e-10, "Incorrect pairwise TN93 distances");
+
+	/* the same must hold for every ambiguity mode (any other flag resolves ambiguities in proportion to the base frequencies),
+	   and for more than 32 sequences, which are compared in 32 x 32 tiles */
+	nucleotides = {{"A","C","G","T"}};
+	ambiguous   = {{"R","Y","W","S","K","M","N","-"}};
+	root        = {1,150};
+	for (site = 0; site < 150; site += 1) {
+		root[site] = Random (0,4)$1;
+	}
+	manySeqsText = "";
+	manySeqsText * 8192;
+	for (seq = 0; seq < 40; seq += 1) {
+		manySeqsText * (">s" + seq + "\n");
+		for (site = 0; site < 150; site += 1) {
+			draw = Random (0,1);
+			if (draw < 0.04) {
+				manySeqsText * ambiguous[Random (0,8)$1];
+			} else {
+				if (draw < 0.15) {
+					manySeqsText * nucleotides[Random (0,4)$1];
+				} else {
+					manySeqsText * nucleotides[root[site]];
+				}
+			}
+		}
+		manySeqsText * "\n";
+	}
+	manySeqsText * 0;
+	DataSet 			manySeqs = ReadFromString (manySeqsText);
+	DataSetFilter		manyF	 = CreateFilter (manySeqs,1);
+
+	ambiguityModes = {{"RESOLVE_AMBIGUITIES", "AVERAGE_AMBIGUITIES", "SKIP_AMBIGUITIES", "FREQUENCY_AWARE"}};
+	for (mode = 0; mode < 4; mode += 1) {
+		GetDataInfo (pDistances, manyF, "PAIRWISE_DISTANCES", {"metric" : "P_DISTANCE", "ambigs" : ambiguityModes[mode]});
+		maxError = 0;
+		for (s1 = 0; s1 < 40; s1 += 1) {
+			for (s2 = s1 + 1; s2 < 40; s2 += 1) {
+				ExecuteCommands ("GetDataInfo (counts, manyF, s1, s2, " + ambiguityModes[mode] + ")");
+				total    = +counts;
+				maxError = Max (maxError, Abs (pDistances[s1][s2] - (1 - (counts[0][0] + counts[1][1] + counts[2][2] + counts[3][3]) / total)));
+				maxError = Max (maxError, Abs (pDistances[s1][s2] - pDistances[s2][s1]));
+			}
+		}
+		assert (maxError < 1e-10, "Incorrect pairwise p-distances for 40 sequences with " + ambiguityModes[mode]);
+	}
+
 	testResult = 1;
 	return testResult;
 }
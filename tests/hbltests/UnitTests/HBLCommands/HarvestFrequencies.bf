@@ -85,6 +85,55 @@ function runTest () {
     
     HarvestFrequencies (count3, simpleTest, 4, 1, 1); // check the case when the number of sites is not a multiple of the unit
 
+    // codon (unit 3) counts must match counts tabulated directly from the sequences,
+    // both over all sites and over a segmented list of sites
+    codonText = ">1\nACGTTAACCGGGATGAAA\n>2\nACGTTGACCGGAATGAAA\n>3\nTTTTTAACCGGGCCCAAG\n>4\nACGTTAACAGGGATGTAA\n";
+    DataSet codonData = ReadFromString (codonText);
+    nucleotideIndex = {"A" : 0, "C" : 1, "G" : 2, "T" : 3};
+    codonSegments   = {{0,1,1,0,1,1}}; // "3-8,12-17" in codon units
+    expectedCodons  = {64,1};
+    expectedSegment = {64,1};
+    expectedByPosition = {4,3};
+    for (species = 0; species < 4; species += 1) {
+        GetDataInfo (sequence, codonData, species);
+        for (codon = 0; codon < 6; codon += 1) {
+            codonIndex = 0;
+            for (position = 0; position < 3; position += 1) {
+                nucleotide = nucleotideIndex[sequence[3*codon+position]];
+                codonIndex = codonIndex * 4 + nucleotide;
+                expectedByPosition [nucleotide][position] += 1;
+            }
+            expectedCodons [codonIndex] += 1;
+            expectedSegment [codonIndex] += codonSegments[codon];
+        }
+    }
+
+    HarvestFrequencies (codonCounts, codonData, 3, 3, 1);
+    assert (Abs (codonCounts - expectedCodons * (1/24)) < 1e-8, "Checking codon frequency counts");
+    HarvestFrequencies (codonCountsAnyPosition, codonData, 3, 3, 0);
+    assert (Abs (codonCountsAnyPosition - expectedCodons * (1/24)) < 1e-8, "Checking codon frequency counts which ignore position");
+    HarvestFrequencies (codonPositionCounts, codonData, 3, 1, 1);
+    assert (Abs (codonPositionCounts - expectedByPosition * (1/24)) < 1e-8, "Checking position-specific nucleotide frequencies in codons");
+    HarvestFrequencies (codonSegmentCounts, codonData, 3, 3, 1, "3-8,12-17");
+    assert (Abs (codonSegmentCounts - expectedSegment * (1/16)) < 1e-8, "Checking codon frequency counts over a segmented list of sites");
+    DataSetFilter codonSegmentFilter = CreateFilter (codonData, 3, "3-8,12-17");
+    HarvestFrequencies (codonSegmentFilterCounts, codonSegmentFilter, 3, 3, 1);
+    assert (Abs (codonSegmentFilterCounts - expectedSegment * (1/16)) < 1e-8, "Checking codon frequency counts from a filter over a segmented list of sites");
+
+    // codons with gaps are either ignored, or counted as ambiguities which resolve over the missing positions
+    DataSet gappedCodons = ReadFromString (">1\nACGACG---\n>2\nACGAC-ACG\n");
+    COUNT_GAPS_IN_FREQUENCIES = 0;
+    HarvestFrequencies (gappedCodonCounts, gappedCodons, 3, 3, 1);
+    expectedGapped = {64,1};
+    expectedGapped [6] = 1; // ACG
+    assert (Abs (gappedCodonCounts - expectedGapped) < 1e-8, "Checking codon frequency counts with gaps ignored");
+    COUNT_GAPS_IN_FREQUENCIES = 1;
+    HarvestFrequencies (gappedCodonCounts, gappedCodons, 3, 3, 1);
+    expectedGapped [6] = 4.25; // 4 x ACG and 1/4 of AC-
+    expectedGapped [4] = 0.25; expectedGapped [5] = 0.25; expectedGapped [7] = 0.25;
+    assert (Abs (gappedCodonCounts - (expectedGapped + {64,1}["1/64"]) * (1/6)) < 1e-8, "Checking codon frequency counts with gaps counted as ambiguities");
+    COUNT_GAPS_IN_FREQUENCIES = 0;
+
 	testResult = 1;
 		
 	return testResult;
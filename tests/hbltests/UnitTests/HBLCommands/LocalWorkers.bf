@@ -0,0 +1,61 @@
+ExecuteAFile (PATH_TO_CURRENT_BF + "TestTools.ibf");
+runATest ();
+
+
+function getTestName () {
+  return "LocalWorkers";
+}
+
+
+function runTest () {
+  ASSERTION_BEHAVIOR = 1; /* print warning to console and go to the end of the execution list */
+  testResult = 0;
+
+  //---------------------------------------------------------------------------------------------------------
+  // SIMPLE FUNCTIONALITY
+  //---------------------------------------------------------------------------------------------------------
+  // With ENV="LOCAL_WORKER_COUNT=N;" jobs are run by N forked copies of the master (as if they were MPI nodes);
+  // without it (or with a single CPU) there are no workers, and the jobs below are not sent
+
+  worker_count = MPI_NODE_COUNT - 1;
+
+  if (worker_count > 0) {
+    // a worker is forked after the master has defined this; it must not see it
+    master_only_global = 42;
+
+    for (node = 1; node <= worker_count; node += 1) {
+      MPISend (node, "return {'global' : master_only_global, 'node' : MPI_NODE_ID};");
+    }
+    for (node = 1; node <= worker_count; node += 1) {
+      MPIReceive (-1, from_node, reply);
+      ExecuteCommands ("reply = " + reply);
+      assert (reply["global"] != 42, "A global defined by the master before the worker started was visible in a job on node " + from_node);
+      assert (reply["node"] == from_node, "A worker reported the wrong MPI_NODE_ID");
+    }
+
+    // jobs sent to the same node are run and answered in the order they were sent
+    job_count = 5;
+    for (job = 0; job < job_count; job += 1) {
+      for (node = 1; node <= worker_count; node += 1) {
+        MPISend (node, "return " + (job * worker_count + node) + ";");
+      }
+    }
+    for (node = 1; node <= worker_count; node += 1) {
+      for (job = 0; job < job_count; job += 1) {
+        MPIReceive (node, from_node, reply);
+        assert (from_node == node && 0 + reply == job * worker_count + node, "Job results from node " + node + " were returned out of order");
+      }
+    }
+
+    // state left by one job is discarded before the next
+    MPISend (1, "worker_state = 42; return 1;");
+    MPIReceive (1, from_node, reply);
+    MPISend (1, "return worker_state;");
+    MPIReceive (1, from_node, reply);
+    assert (0 + reply != 42, "A global defined by a job was visible in the next job");
+  }
+
+  testResult = 1;
+
+  return testResult;
+}
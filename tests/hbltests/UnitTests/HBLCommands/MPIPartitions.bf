@@ -0,0 +1,149 @@
+ExecuteAFile (PATH_TO_CURRENT_BF + "TestTools.ibf");
+runATest ();
+
+
+function getTestName () {
+  return "MPIPartitions";
+}
+
+
+function runTest () {
+  ASSERTION_BEHAVIOR = 1; /* print warning to console and go to the end of the execution list */
+  testResult = 0;
+
+  //---------------------------------------------------------------------------------------------------------
+  // SIMPLE FUNCTIONALITY
+  //---------------------------------------------------------------------------------------------------------
+  // With AUTO_PARALLELIZE_OPTIMIZE = 1, HYPHYMPI optimizes a likelihood function with several partitions by
+  // sending the partitions to computational nodes; MPI_PARTITION_ASSIGNMENT records the node for each partition.
+  // The expected assignments below are for two computational nodes (mpirun -np 3 HYPHYMPI MPIPartitions.bf);
+  // other builds and node counts skip these checks
+
+  GetString (version, HYPHY_VERSION, 1);
+
+  if ((version $ "\\(MPI\\)")[0] >= 0 && MPI_NODE_COUNT == 3) {
+    DataSet cd2 = ReadDataFile (PATH_TO_CURRENT_BF + '/../../data/CD2.nex');
+    tree_string = "((((Pig,Cow),Horse,Cat),((RhMonkey,Baboon),(Human,Chimp))),Rat,Mouse)";
+
+    global r_nuc = 1;
+    HarvestFrequencies (nuc_freqs, cd2, 1, 1, 1);
+    F81 = {{*,r_nuc*t,r_nuc*t,r_nuc*t}{r_nuc*t,*,r_nuc*t,r_nuc*t}{r_nuc*t,r_nuc*t,*,r_nuc*t}{r_nuc*t,r_nuc*t,r_nuc*t,*}};
+    Model F81_model = (F81, nuc_freqs, 1);
+
+    // partitions go to nodes from the most to the least expensive, each to the node with the smallest total cost;
+    // with the same model and tree, the cost of a partition is proportional to its number of site patterns
+    DataSetFilter lpt_0 = CreateFilter (cd2,1,"0-239");   // 160 patterns -> node 1 (160)
+    DataSetFilter lpt_1 = CreateFilter (cd2,1,"300-419"); //  70 patterns -> node 1 (230)
+    DataSetFilter lpt_2 = CreateFilter (cd2,1,"510-560"); //  39 patterns -> node 2 (210)
+    DataSetFilter lpt_3 = CreateFilter (cd2,1,"0-119");   //  80 patterns -> node 2 (171)
+    DataSetFilter lpt_4 = CreateFilter (cd2,1,"120-239"); //  91 patterns -> node 2 (91)
+
+    assert (Columns (lpt_0.site_freqs) == 160 && Columns (lpt_1.site_freqs) == 70 && Columns (lpt_2.site_freqs) == 39 &&
+            Columns (lpt_3.site_freqs) == 80 && Columns (lpt_4.site_freqs) == 91, "Unexpected site pattern counts for the partition assignment test");
+
+    for (k = 0; k < 5; k += 1) {
+      ExecuteCommands ("Tree lpt_tree_" + k + " = tree_string; ReplicateConstraint (\"this1.?.t:=0.1\", lpt_tree_" + k + ");");
+    }
+    LikelihoodFunction lpt_lf = (lpt_0, lpt_tree_0, lpt_1, lpt_tree_1, lpt_2, lpt_tree_2, lpt_3, lpt_tree_3, lpt_4, lpt_tree_4);
+
+    AUTO_PARALLELIZE_OPTIMIZE = 1;
+    MPI_PARTITION_REBALANCE_INTERVAL = 0;
+    Optimize (lpt_mles, lpt_lf);
+
+    assert (Type (MPI_PARTITION_ASSIGNMENT) == "Matrix", "Failed to optimize a likelihood function in the MPI partition mode");
+    assert (MPI_PARTITION_ASSIGNMENT == {{1,1,2,2,2}}, "Incorrect assignment of partitions to MPI nodes " + MPI_PARTITION_ASSIGNMENT);
+
+    LFCompute (lpt_lf, LF_START_COMPUTE);
+    LFCompute (lpt_lf, lpt_logl);
+    LFCompute (lpt_lf, LF_DONE_COMPUTE);
+    assert (Abs (lpt_logl - lpt_mles[1][0]) < 1e-8, "Incorrect log-likelihood from the MPI partition mode");
+
+    //---------------------------------------------------------------------------------------------------------
+    // REBALANCING PARTITIONS
+    //---------------------------------------------------------------------------------------------------------
+    // Every MPI_PARTITION_REBALANCE_INTERVAL evaluations, partitions are reassigned based on measured times.
+    // The cost of a codon partition does not account for exponentiating 61x61 rate matrices: both
+    // single pattern codon partitions start on the same node (1 x 61^2 each vs 308 x 4^2 for all the nucleotides),
+    // but take much longer to evaluate, so one of them is moved; this must not change the log-likelihood
+
+    global r_codon = 1;
+    sense_codons = {61,1};
+    k = 0;
+    for (c = 0; c < 64; c += 1) {
+      if (c != 48 && c != 50 && c != 56) { // TAA, TAG, TGA
+        sense_codons[k] = c;
+        k += 1;
+      }
+    }
+
+    codon_rates = "CodonRates = {61,61};";
+    for (i = 0; i < 61; i += 1) {
+      for (j = 0; j < 61; j += 1) {
+        from = sense_codons[i];
+        to   = sense_codons[j];
+        differences = 0;
+        for (position = 0; position < 3; position += 1) {
+          differences += (from % 4) != (to % 4);
+          from = from $ 4;
+          to   = to $ 4;
+        }
+        if (differences == 1) {
+          codon_rates += "CodonRates[" + i + "][" + j + "] := r_codon*t;";
+        }
+      }
+    }
+    ExecuteCommands (codon_rates);
+    codon_freqs = {61,1}["1/61"];
+    Model codon_model = (CodonRates, codon_freqs, 1);
+
+    DataSetFilter codon_1 = CreateFilter (cd2,3,"0-2","","TAA,TAG,TGA");
+    DataSetFilter codon_2 = CreateFilter (cd2,3,"3-5","","TAA,TAG,TGA");
+    Tree codon_tree_1 = tree_string;
+    Tree codon_tree_2 = tree_string;
+    ReplicateConstraint ("this1.?.t:=0.1", codon_tree_1);
+    ReplicateConstraint ("this1.?.t:=0.1", codon_tree_2);
+
+    UseModel (F81_model);
+    DataSetFilter nuc_all = CreateFilter (cd2,1);
+    Tree nuc_tree = tree_string;
+    ReplicateConstraint ("this1.?.t:=0.1", nuc_tree);
+
+    assert (Columns (nuc_all.site_freqs) == 308 && Columns (codon_1.site_freqs) == 1 && Columns (codon_2.site_freqs) == 1,
+            "Unexpected site pattern counts for the partition rebalancing test");
+
+    LikelihoodFunction rebalance_lf = (nuc_all, nuc_tree, codon_1, codon_tree_1, codon_2, codon_tree_2);
+
+    r_nuc = 1; r_codon = 1;
+    MPI_PARTITION_REBALANCE_INTERVAL = 0;
+    Optimize (fixed_mles, rebalance_lf);
+    assert (MPI_PARTITION_ASSIGNMENT == {{1,2,2}}, "Incorrect initial assignment of partitions to MPI nodes " + MPI_PARTITION_ASSIGNMENT);
+
+    // only r_nuc changes between the points of the starting grid, so after the codon partitions have been split,
+    // the node with a codon partition alone is not sent any grid evaluations: the result it returned for the
+    // partitions it had before must not be used
+    start_grid = {};
+    for (k = 0; k < 10; k += 1) {
+      start_grid + {"r_nuc" : 0.5 + 0.1 * k};
+    }
+
+    r_nuc = 1; r_codon = 1;
+    MPI_PARTITION_REBALANCE_INTERVAL = 5;
+    Optimize (rebalanced_mles, rebalance_lf, {"OPTIMIZATION_START_GRID" : start_grid});
+    assert (MPI_PARTITION_ASSIGNMENT[1] != MPI_PARTITION_ASSIGNMENT[2], "Failed to move a codon partition to another MPI node " + MPI_PARTITION_ASSIGNMENT);
+
+    LFCompute (rebalance_lf, LF_START_COMPUTE);
+    LFCompute (rebalance_lf, rebalanced_logl);
+    r_nuc = LF_INITIAL_GRID_MAXIMUM_VALUE["r_nuc"]; r_codon = 1;
+    LFCompute (rebalance_lf, grid_logl);
+    LFCompute (rebalance_lf, LF_DONE_COMPUTE);
+    assert (Abs (grid_logl - LF_INITIAL_GRID_MAXIMUM) < 1e-8, "Incorrect log-likelihood on the starting grid after rebalancing partitions");
+    assert (Abs (rebalanced_logl - rebalanced_mles[1][0]) < 1e-8, "Incorrect log-likelihood after rebalancing partitions");
+    assert (Abs (fixed_mles[1][0] - rebalanced_mles[1][0]) < 1e-3, "Rebalancing partitions changed the maximum log-likelihood");
+
+    AUTO_PARALLELIZE_OPTIMIZE = 0;
+  }
+
+  testResult = 1;
+
+  return testResult;
+}
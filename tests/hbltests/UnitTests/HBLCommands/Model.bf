@@ -27,6 +27,34 @@ function runTest () {
   freqs = {{0.4}{0.3}{0.2}{0.1}};
   Model HKYd85 = (Q_HKY85, freqs, 1);
 
+  // Rate matrix cells that differ only in the order of operands ('kappa*t' and 't*kappa')
+  // share one compiled formula; the likelihood must be the same as with uniformly written cells
+  Q_HKY85_uniform = {{*,t,kappa*t,t}
+                   {t,*,t,kappa*t}
+                   {kappa*t,t,*,t}
+                   {t,kappa*t,t,*}};
+  Model HKY85_uniform = (Q_HKY85_uniform, freqs, 1);
+
+  DataSet model_test_data = ReadFromString (">a\nACGTACGTAAGT\n>b\nACGTTCGAAAGT\n>c\nAGGTACCTAACT\n");
+  DataSetFilter model_test_filter = CreateFilter (model_test_data, 1);
+
+  UseModel (HKYd85);
+  Tree model_test_tree = (a,b,c);
+  UseModel (HKY85_uniform);
+  Tree model_test_tree_uniform = (a,b,c);
+  model_test_tree.a.t = 0.1; model_test_tree.b.t = 0.2; model_test_tree.c.t = 0.3;
+  model_test_tree_uniform.a.t = 0.1; model_test_tree_uniform.b.t = 0.2; model_test_tree_uniform.c.t = 0.3;
+
+  LikelihoodFunction model_test_lf = (model_test_filter, model_test_tree);
+  LikelihoodFunction model_test_lf_uniform = (model_test_filter, model_test_tree_uniform);
+  LFCompute (model_test_lf, LF_START_COMPUTE);
+  LFCompute (model_test_lf, model_test_logl);
+  LFCompute (model_test_lf, LF_DONE_COMPUTE);
+  LFCompute (model_test_lf_uniform, LF_START_COMPUTE);
+  LFCompute (model_test_lf_uniform, model_test_logl_uniform);
+  LFCompute (model_test_lf_uniform, LF_DONE_COMPUTE);
+  assert (model_test_logl < 0 && model_test_logl == model_test_logl_uniform, "Reordering commutative operands in rate matrix cells changed the likelihood");
+
 
   //---------------------------------------------------------------------------------------------------------
   // ERROR HANDLING
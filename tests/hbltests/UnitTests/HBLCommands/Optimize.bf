@@ -0,0 +1,61 @@
+ExecuteAFile (PATH_TO_CURRENT_BF + "TestTools.ibf");
+runATest ();
+
+
+function getTestName () {
+  return "Optimize";
+}
+
+
+function runTest () {
+  ASSERTION_BEHAVIOR = 1; /* print warning to console and go to the end of the execution list */
+  testResult = 0;
+
+  DataSet         cd2 = ReadDataFile (PATH_TO_CURRENT_BF + "../../data/CD2.phylip");
+  DataSetFilter   cd2_filter = CreateFilter (cd2,1);
+  HarvestFrequencies (cd2_freqs, cd2_filter, 1, 1, 1);
+  cd2_tree_string = "((((Pig,Cow),Horse,Cat),((RhMonkey,Baboon),(Human,Chimp))),Rat,Mouse)";
+
+  //---------------------------------------------------------------------------------------------------------
+  // SIMPLE FUNCTIONALITY
+  //---------------------------------------------------------------------------------------------------------
+  // Constrained variables are only refreshed when a parameter they depend on has changed;
+  // a chain of constraints must give the same optimum as the same model written without them
+  global kappa_chain = 2;
+  global transitions_chain := 2*kappa_chain;
+  global kappa_scaled := transitions_chain/2;
+  HKY_chain = {{*,t,kappa_scaled*t,t}
+               {t,*,t,kappa_scaled*t}
+               {kappa_scaled*t,t,*,t}
+               {t,kappa_scaled*t,t,*}};
+  Model HKY_chain_model = (HKY_chain, cd2_freqs);
+  Tree  chain_tree = cd2_tree_string;
+  chain_tree.Human.t := chain_tree.Chimp.t;
+  LikelihoodFunction chain_lf = (cd2_filter, chain_tree);
+  Optimize (chain_mles, chain_lf);
+
+  global kappa_direct = 2;
+  HKY_direct = {{*,t,kappa_direct*t,t}
+                {t,*,t,kappa_direct*t}
+                {kappa_direct*t,t,*,t}
+                {t,kappa_direct*t,t,*}};
+  Model HKY_direct_model = (HKY_direct, cd2_freqs);
+  Tree  direct_tree = cd2_tree_string;
+  direct_tree.Human.t := direct_tree.Chimp.t;
+  LikelihoodFunction direct_lf = (cd2_filter, direct_tree);
+  Optimize (direct_mles, direct_lf);
+
+  assert (Abs (chain_mles[1][0] - direct_mles[1][0]) < 1e-4, "Failed to reach the same maximum with a chain of constrained variables");
+  assert (Abs (kappa_chain - kappa_direct) < 1e-2 && Abs (kappa_scaled - kappa_chain) < 1e-10, "Failed to reach the same MLE with a chain of constrained variables");
+  assert (Abs (chain_tree.Human.t - chain_tree.Chimp.t) < 1e-10, "Failed to keep a constrained branch length up to date");
+
+  // a complete re-evaluation (which refreshes every constrained variable) must match the optimizer's value
+  LFCompute (chain_lf, LF_START_COMPUTE);
+  LFCompute (chain_lf, chain_logl);
+  LFCompute (chain_lf, LF_DONE_COMPUTE);
+  assert (Abs (chain_logl - chain_mles[1][0]) < 1e-8, "Failed to report the log-likelihood of the MLEs with a chain of constrained variables");
+
+  testResult = 1;
+
+  return testResult;
+}
@@ -0,0 +1,200 @@
+LoadFunctionLibrary("libv3/tasks/mpi.bf");
+
+lfunction _test_mpi.affine (x, slope, offset) {
+    return x * slope + offset;
+}
+
+lfunction _test_mpi.square (x) {
+    return x * x;
+}
+
+// map over a dictionary of argument lists; results are keyed and ordered like the input
+_mapped = mpi.ParallelMap ("_test_mpi.affine", {"second" : {"0" : 2, "1" : 3, "2" : 1},
+                                                "first"  : {"0" : 1, "1" : 2, "2" : 0},
+                                                "third"  : {"0" : 3, "1" : 0, "2" : 5}}, None);
+
+assert (Abs (_mapped) == 3, "ParallelMap returned the wrong number of results");
+assert (_mapped ["second"] == 7 && _mapped ["first"] == 2 && _mapped ["third"] == 5, "ParallelMap returned incorrect results for a dictionary of arguments");
+assert ((utility.Keys (_mapped))[0] == "second" && (utility.Keys (_mapped))[2] == "third", "ParallelMap did not preserve the order of the arguments");
+
+// map over a matrix of single arguments; keys are element indices
+_node_setup = {"Functions" : {{"_test_mpi.affine"}}};
+_mapped = mpi.ParallelMap ("_test_mpi.square", {{1,2,3,4}}, _node_setup);
+
+assert (Abs (_mapped) == 4, "ParallelMap returned the wrong number of results for a matrix argument");
+assert (_mapped [0] == 1 && _mapped [3] == 16, "ParallelMap returned incorrect results for a matrix of arguments");
+assert (Abs (_node_setup) == 1 && Columns (_node_setup["Functions"]) == 1, "ParallelMap modified the caller's node setup");
+
+lfunction _test_mpi.describe (value) {
+    return {"value" : value, "type" : Type (value)};
+}
+
+// values must survive the trip to a node and back (binary messages under MPI) unchanged
+_matrix = {{0.1,1e-300,3}{-2.5e10,0.3333333333333333,6}};
+_values = {"0" : {"0" : 1.25e-300},
+           "1" : {"0" : "a \"quoted\"\nstring"},
+           "2" : {"0" : _matrix},
+           "3" : {"0" : {"nested" : {"x" : {{-1}}, "y" : "z"}}},
+           "4" : {"0" : {{"a","b"}}}};
+
+_mapped = mpi.ParallelMap ("_test_mpi.describe", _values, None);
+
+assert ((_mapped[0])["type"] == "Number" && (_mapped[0])["value"] == 1.25e-300, "A number did not survive ParallelMap");
+assert ((_mapped[1])["type"] == "String" && (_mapped[1])["value"] == "a \"quoted\"\nstring", "A string did not survive ParallelMap");
+assert ((_mapped[2])["type"] == "Matrix" && +(((_mapped[2])["value"] - _matrix)["Abs(_MATRIX_ELEMENT_VALUE_)"]) == 0, "A numeric matrix did not survive ParallelMap");
+assert ((((_mapped[3])["value"])["nested"])["y"] == "z" && ((((_mapped[3])["value"])["nested"])["x"])[0] == -1, "A nested dictionary did not survive ParallelMap");
+assert ((_mapped[4])["type"] == "Matrix" && ((_mapped[4])["value"])[1] == "b", "A string matrix did not survive ParallelMap");
+
+lfunction _test_mpi.record_square (node, result, arguments) {
+    (^"_squares")[arguments[0]] = result;
+}
+
+// with several jobs in flight per node, each result must be passed to the callback together with the arguments of its own job
+_squares = {};
+_queue = mpi.CreateQueue ({"Functions" : {{"_test_mpi.square"}}, "JobsPerNode" : 3});
+for (_k = 0; _k < 20; _k += 1) {
+    mpi.QueueJob (_queue, "_test_mpi.square", {"0" : _k}, "_test_mpi.record_square");
+}
+mpi.QueueComplete (_queue);
+assert (Abs (_squares) == 20, "QueueJob lost or duplicated jobs with several jobs in flight per node");
+for (_k = 0; _k < 20; _k += 1) {
+    assert (_squares [_k] == _k * _k, "A job result was passed to the callback with the arguments of another job");
+}
+
+lfunction _test_mpi.consume (shared, index) {
+    total = +shared;
+    shared [index] = -1e10;
+    return total + index;
+}
+
+// jobs which share an argument receive it once per node; a job modifying its copy must not affect later jobs
+_shared = {1,1000}["_MATRIX_ELEMENT_COLUMN_"];
+_values = {};
+for (_k = 0; _k < 12; _k += 1) {
+    _values + {"0" : _shared, "1" : _k};
+}
+
+_mapped = mpi.ParallelMap ("_test_mpi.consume", _values, None);
+for (_k = 0; _k < 12; _k += 1) {
+    assert (_mapped [_k] == 499500 + _k, "Jobs sharing an argument returned incorrect results");
+}
+assert (_shared[5] == 5, "ParallelMap modified a shared argument");
+
+lfunction _test_mpi.fragile (x) {
+    assert (utility.GetEnvVariable ("MPI_NODE_ID") != 1, "A deliberate failure on node 1");
+    return x + 1;
+}
+
+// jobs which fail on a node are run elsewhere; every job reports exactly once
+_mapped = mpi.ParallelMap ("_test_mpi.fragile", {1,10}["_MATRIX_ELEMENT_COLUMN_"], None);
+assert (Abs (_mapped) == 10, "ParallelMap lost or duplicated jobs which failed on a node");
+for (_k = 0; _k < 10; _k += 1) {
+    assert (_mapped [_k] == _k + 1, "Jobs which failed on a node returned incorrect results");
+}
+
+// site blocks stored on nodes must reduce to the same values as the whole matrix
+_conditionals = {7,23}["Exp(-((_MATRIX_ELEMENT_ROW_+1)*(_MATRIX_ELEMENT_COLUMN_+3))%11)"];
+_weights      = {7,1}["(_MATRIX_ELEMENT_ROW_+1)/28"];
+_joint        = _weights $ _conditionals;
+_site_sums    = {1,7}["1"] * _joint;
+_ones         = {23,1}["1"];
+_posteriors   = (_joint / _site_sums) * _ones;
+
+lfunction _test_mpi.node_state () {
+    _states = {};
+    for (_node = 1; _node < utility.GetEnvVariable ("MPI_NODE_COUNT"); _node += 1) {
+        MPISend (_node, "return PRESERVE_SLAVE_NODE_STATE;");
+        MPIReceive (_node, _from, _state);
+        _states [_node] = 0 + _state;
+    }
+    return _states;
+}
+
+// a matrix this small is kept on the master, unless the minimum block size is lowered;
+// blocks are only sent to MPI nodes, not to local workers
+_blocks = mpi.DistributeSiteBlocks (_conditionals);
+assert (Rows (_blocks["blocks"]) == 1, "DistributeSiteBlocks distributed a small matrix");
+mpi.ReleaseSiteBlocks (_blocks);
+
+GetString (_version, HYPHY_VERSION, 1);
+_expected_blocks = 1;
+if ((_version $ "\\(MPI\\)")[0] >= 0) {
+    _expected_blocks = Min (23, MPI_NODE_COUNT);
+}
+
+_node_state = _test_mpi.node_state ();
+mpi.site_block_min_size = 1;
+_blocks    = mpi.DistributeSiteBlocks (_conditionals);
+mpi.site_block_min_size = 1e6;
+assert (Rows (_blocks["blocks"]) == _expected_blocks, "DistributeSiteBlocks made an incorrect number of blocks");
+_reduction = mpi.ReduceSiteBlocks (_blocks, _weights);
+assert (Columns (_reduction[terms.mpi.site_sums]) == 23 && Rows (_reduction[terms.mpi.class_posteriors]) == 7, "ReduceSiteBlocks returned reductions of the wrong dimension");
+assert (+((_reduction[terms.mpi.site_sums] - _site_sums)["Abs(_MATRIX_ELEMENT_VALUE_)"]) < 1e-12, "ReduceSiteBlocks returned incorrect site sums");
+assert (+((_reduction[terms.mpi.class_posteriors] - _posteriors)["Abs(_MATRIX_ELEMENT_VALUE_)"]) < 1e-12, "ReduceSiteBlocks returned incorrect class posteriors");
+_reduction = mpi.ReduceSiteBlocks (_blocks, _weights["1/7"]);
+assert (+((_reduction[terms.mpi.site_sums] - {1,7}["1/7"] * _conditionals)["Abs(_MATRIX_ELEMENT_VALUE_)"]) < 1e-12, "ReduceSiteBlocks returned incorrect site sums for new weights");
+mpi.ReleaseSiteBlocks (_blocks);
+assert ("" + _test_mpi.node_state () == "" + _node_state, "ReleaseSiteBlocks did not restore the node state setting");
+
+lfunction _test_mpi.stall (x) {
+    if (utility.GetEnvVariable ("MPI_NODE_ID") == 1 && x == 0) {
+        started = Time (1);
+        while (Time (1) - started < 4) {
+        }
+    }
+    return x;
+}
+
+lfunction _test_mpi.record_node (node, result, arguments) {
+    (^"_nodes_used")[node] = TRUE;
+}
+
+// a node which times out on a job is retired (and the job is run elsewhere); mpi.ReinstateNodes puts it back
+if (utility.GetEnvVariable ("MPI_NODE_COUNT") > 2) {
+    _mapped = mpi.ParallelMap ("_test_mpi.stall", {1,3}["_MATRIX_ELEMENT_COLUMN_"], {"JobTimeout" : 1, "JobsPerNode" : 1, "SpeculativeJobs" : FALSE});
+    assert (_mapped[0] == 0 && _mapped[2] == 2, "Jobs which timed out on a node returned incorrect results");
+    assert (mpi.retired_nodes[1] && Abs (mpi.retired_nodes) == 1, "A node which timed out on a job was not retired");
+
+    _reinstated = mpi.ReinstateNodes (None);
+    assert (_reinstated == 1 && Abs (mpi.retired_nodes) == 0, "ReinstateNodes did not put a retired node back");
+    _nodes_used = {};
+    _queue = mpi.CreateQueue ({"Functions" : {{"_test_mpi.square"}}, "JobsPerNode" : 1});
+    for (_k = 0; _k < 10; _k += 1) {
+        mpi.QueueJob (_queue, "_test_mpi.square", {"0" : _k}, "_test_mpi.record_node");
+    }
+    mpi.QueueComplete (_queue);
+    assert (_nodes_used[1], "A reinstated node was not sent jobs");
+}
+
+lfunction _test_mpi.read_data (text, species) {
+    DataSet data = ReadFromString (text);
+    DataSetFilter data_filter = CreateFilter (data, 1);
+    GetDataInfo (characters, data_filter, species);
+    GetString (name, data, species);
+    return {"sites" : data.sites, "patterns" : data.unique_sites, "name" : "" + name, "characters" : characters};
+}
+
+// large data sets read by several nodes on the same host are shared by them (under MPI); they must read the same as a private copy.
+// The replies are too long to travel in a single message; replies to abandoned copies of speculative jobs must not hold up shutdown
+_nucleotides = {{"A","C","G","T"}};
+_text = "";
+_text * 100000;
+for (_k = 0; _k < 16; _k += 1) {
+    _text * (">s" + _k + "\n");
+    for (_site = 0; _site < 20000; _site += 1) {
+        _text * _nucleotides[Random(0,4)$1];
+    }
+    _text * "\n";
+}
+_text * 0;
+
+_values = {};
+for (_k = 0; _k < 8; _k += 1) {
+    _values + {"0" : _text, "1" : _k};
+}
+_mapped = mpi.ParallelMap ("_test_mpi.read_data", _values, None);
+for (_k = 0; _k < 8; _k += 1) {
+    _local = _test_mpi.read_data (_text, _k);
+    assert ((_mapped[_k])["sites"] == 20000 && (_mapped[_k])["patterns"] == _local["patterns"], "A data set read on a node has the wrong dimensions");
+    assert ((_mapped[_k])["name"] == _local["name"] && (_mapped[_k])["characters"] == _local["characters"], "A data set read on a node has the wrong contents");
+}